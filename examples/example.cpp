@@ -13,7 +13,7 @@ int main() {
   for (int i = 0; i < 50; i++) {
     pool.submit(fun1, i * 100);
   }
-  std::vector<std::future<int>> results;
+  std::vector<threadpool::TaskFuture<int>> results;
   for (int i = 0; i < 50; i++) {
     results.emplace_back(pool.submit(expensive_task, i, i + 1));
   }
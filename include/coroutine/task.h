@@ -0,0 +1,280 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <future>
+#include <type_traits>
+#include <utility>
+
+#include "future/task_future.h"
+#include "thread/threadpool.h"
+
+namespace threadpool {
+
+template <class T = void>
+class Task;
+
+namespace detail {
+/**
+ * @brief Task 的 promise 中和返回值无关的部分
+ * 协程结束时对称转移到等待它的协程，没有等待者时停在 final_suspend，由 Task 负责销毁
+ */
+class CoroPromiseBase {
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+
+    template <class Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+      std::coroutine_handle<> continuation = handle.promise().continuation_;
+      return continuation ? continuation : std::noop_coroutine();
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  public:
+  // 惰性启动，co_await 时才开始执行
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+
+  void unhandled_exception() noexcept { error_ = std::current_exception(); }
+
+  void setContinuation(std::coroutine_handle<> continuation) { continuation_ = continuation; }
+
+  protected:
+  std::coroutine_handle<> continuation_;
+  std::exception_ptr error_;
+};
+
+template <class T>
+class CoroPromise : public CoroPromiseBase {
+  public:
+  Task<T> get_return_object() noexcept;
+
+  template <class U = T>
+  void return_value(U&& value) {
+    storage_.set(std::forward<U>(value));
+  }
+
+  T result() {
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+    return storage_.take();
+  }
+
+  private:
+  ValueStorage<T> storage_;
+};
+
+template <>
+class CoroPromise<void> : public CoroPromiseBase {
+  public:
+  Task<void> get_return_object() noexcept;
+
+  void return_void() noexcept {}
+
+  void result() {
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+  }
+};
+
+// 启动之后不再被等待的协程，执行完自动销毁
+struct DetachedTask {
+  struct promise_type {
+    DetachedTask get_return_object() noexcept { return {}; }
+
+    std::suspend_never initial_suspend() const noexcept { return {}; }
+
+    std::suspend_never final_suspend() const noexcept { return {}; }
+
+    void return_void() noexcept {}
+
+    // 调用方把所有异常都交给了 promise，这里不会有异常
+    void unhandled_exception() noexcept { std::terminate(); }
+  };
+};
+
+// 执行 task，结果或者异常写入 promise；pool 不为空时先切换到线程池
+template <class T>
+DetachedTask runToPromise(ThreadPool* pool, Task<T> task, TaskPromise<T> promise) {
+  try {
+    if (pool != nullptr) {
+      co_await pool->schedule();
+    }
+    if constexpr (std::is_void_v<T>) {
+      co_await std::move(task);
+      promise.set_value();
+    } else {
+      promise.set_value(co_await std::move(task));
+    }
+  } catch (...) {
+    promise.set_exception(std::current_exception());
+  }
+}
+
+/**
+ * @brief co_await TaskFuture 的等待体
+ * 没有完成时在共享状态上注册回调，等待期间不占用任何线程。完成时回调只提交恢复协程的任务，
+ * 协程不会嵌套在写入结果的任务中执行：优先提交到写入结果的线程所属的线程池，其次是挂起时所在的线程池，
+ * 都不是工作线程时(例如外部线程写入 promise)没有线程池可用，才在写入结果的线程上直接恢复。
+ * 恢复任务和 post 一样提交，队列满时等待空位，不会改为在当前线程上执行
+ */
+template <class T>
+class FutureAwaiter {
+  public:
+  explicit FutureAwaiter(TaskFuture<T>&& future)
+      : future_(std::move(future)) {}
+
+  bool await_ready() const { return future_.is_ready(); }
+
+  bool await_suspend(std::coroutine_handle<> handle) {
+    handle_ = handle;
+    pool_ = ThreadPool::current();
+    callback_.arg = this;
+    return FutureAccess::state(future_)->setCallback(&callback_);
+  }
+
+  T await_resume() { return future_.get(); }
+
+  private:
+  static void resume(void* arg) {
+    auto* awaiter = static_cast<FutureAwaiter*>(arg);
+    ThreadPool* pool = ThreadPool::current();
+    if (pool == nullptr) {
+      pool = awaiter->pool_;
+    }
+    if (pool == nullptr) {
+      awaiter->handle_.resume();
+      return;
+    }
+    pool->post([handle = awaiter->handle_]() { handle.resume(); });
+  }
+
+  private:
+  TaskFuture<T> future_;
+  std::coroutine_handle<> handle_;
+  ThreadPool* pool_ = nullptr;
+  FutureCallback callback_{&FutureAwaiter::resume, nullptr};
+};
+}  // namespace detail
+
+/**
+ * @brief 协程任务，co_await 时才开始执行，结束时直接恢复等待它的协程
+ * 在哪个线程上执行由协程自己决定：co_await pool.schedule() 切换到线程池，
+ * co_await 一个 TaskFuture 之后回到线程池上继续执行
+ */
+template <class T>
+class [[nodiscard]] Task {
+  public:
+  using promise_type = detail::CoroPromise<T>;
+
+  Task() = default;
+
+  Task(Task&& other) noexcept
+      : handle_(std::exchange(other.handle_, nullptr)) {}
+
+  Task& operator=(Task&& other) noexcept {
+    if (this == &other) return *this;
+    reset();
+    handle_ = std::exchange(other.handle_, nullptr);
+    return *this;
+  }
+
+  // non-copy
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+
+  ~Task() { reset(); }
+
+  bool valid() const noexcept { return static_cast<bool>(handle_); }
+
+  // 默认构造或者被移走的 Task 没有协程可以等待，和 TaskFuture 一样抛出 no_state
+  auto operator co_await() {
+    if (!handle_) {
+      throw std::future_error(std::future_errc::no_state);
+    }
+    struct Awaiter {
+      std::coroutine_handle<promise_type> handle;
+
+      bool await_ready() const noexcept { return handle.done(); }
+
+      // 对称转移，嵌套的 co_await 不会让调用栈增长
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+        handle.promise().setContinuation(caller);
+        return handle;
+      }
+
+      T await_resume() { return handle.promise().result(); }
+    };
+    return Awaiter{handle_};
+  }
+
+  private:
+  friend class detail::CoroPromise<T>;
+
+  explicit Task(std::coroutine_handle<promise_type> handle)
+      : handle_(handle) {}
+
+  void reset() {
+    if (handle_) {
+      handle_.destroy();
+      handle_ = nullptr;
+    }
+  }
+
+  private:
+  std::coroutine_handle<promise_type> handle_;
+};
+
+namespace detail {
+template <class T>
+Task<T> CoroPromise<T>::get_return_object() noexcept {
+  return Task<T>(std::coroutine_handle<CoroPromise>::from_promise(*this));
+}
+
+inline Task<void> CoroPromise<void>::get_return_object() noexcept {
+  return Task<void>(std::coroutine_handle<CoroPromise>::from_promise(*this));
+}
+}  // namespace detail
+
+/**
+ * @brief co_await 线程池的 future，和 get 一样等待之后 future 不再有效
+ */
+template <class T>
+detail::FutureAwaiter<T> operator co_await(TaskFuture<T>&& future) {
+  return detail::FutureAwaiter<T>(std::move(future));
+}
+
+template <class T>
+detail::FutureAwaiter<T> operator co_await(TaskFuture<T>& future) {
+  return detail::FutureAwaiter<T>(std::move(future));
+}
+
+/**
+ * @brief 在线程池上启动 task，返回的 future 可以 get、then 或者在另一个协程中 co_await
+ */
+template <class T>
+TaskFuture<T> spawn(ThreadPool& pool, Task<T> task) {
+  TaskPromise<T> promise;
+  TaskFuture<T> future = promise.get_future();
+  detail::runToPromise(&pool, std::move(task), std::move(promise));
+  return future;
+}
+
+/**
+ * @brief 在当前线程上启动 task 并阻塞等待结果，task 抛出的异常在这里重新抛出
+ * 用于在普通函数中进入协程，不能在协程需要的线程池的工作线程上调用
+ */
+template <class T>
+T sync_wait(Task<T> task) {
+  TaskPromise<T> promise;
+  TaskFuture<T> future = promise.get_future();
+  detail::runToPromise<T>(nullptr, std::move(task), std::move(promise));
+  return future.get();
+}
+
+}  // namespace threadpool
@@ -0,0 +1,616 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+#include "optional/optional.h"
+#include "thread/threadpool.h"
+
+/**
+ * 仿照 P2300(std::execution) 的 sender/receiver，只实现线程池需要的部分：
+ * 每个 sender 至多完成一个值(value_type 为 void 时没有值)，只有 set_value 和 set_error 两个通道；
+ * receiver 是提供 set_value(...) 和 set_error(std::exception_ptr) 成员函数的对象；
+ * sender 提供 connect(receiver) &&，返回不可移动的操作状态，start() 之后开始执行。
+ * 操作状态整个嵌套在调用方的栈帧(例如 sync_wait)里，组合的每一层都不在堆上分配内存。
+ */
+namespace threadpool {
+namespace config {
+static constexpr const int SENDER_BULK_CHUNKS_PER_THREAD = 2;  // bulk 切分的块数
+}  // namespace config
+
+namespace execution {
+
+template <class S>
+concept Sender = std::move_constructible<S> && requires(const S& sender) {
+  typename S::value_type;
+  // 完成时所在的线程池，不确定时为 nullptr
+  { sender.completionPool() } -> std::same_as<ThreadPool*>;
+};
+
+namespace detail {
+// 以 T 为参数调用 f，T 为 void 时不传参数
+template <class F, class T>
+struct InvokeWith {
+  using type = std::invoke_result_t<F, T>;
+};
+
+template <class F>
+struct InvokeWith<F, void> {
+  using type = std::invoke_result_t<F>;
+};
+
+template <class F, class T>
+using invoke_with_t = typename InvokeWith<F, T>::type;
+
+// 在 Optional 中原地构造不可移动的操作状态
+template <class Fn>
+struct Emplacer {
+  Fn fn;
+  operator std::invoke_result_t<Fn&>() { return fn(); }
+};
+
+template <class Fn>
+Emplacer(Fn) -> Emplacer<Fn>;
+
+// 管道写法 sender | then(f) 中的 then(f)
+struct SenderClosure {};
+
+template <class C>
+concept Closure = std::derived_from<C, SenderClosure>;
+}  // namespace detail
+
+/**
+ * @brief 直接完成的 sender，在 start() 的线程上给出 value
+ */
+template <class T>
+class JustSender {
+  public:
+  using value_type = T;
+
+  explicit JustSender(T value)
+      : value_(std::move(value)) {}
+
+  ThreadPool* completionPool() const { return nullptr; }
+
+  template <class R>
+  class Operation {
+    public:
+    Operation(T value, R receiver)
+        : value_(std::move(value)),
+          receiver_(std::move(receiver)) {}
+    Operation(const Operation&) = delete;
+    Operation& operator=(const Operation&) = delete;
+
+    void start() noexcept { receiver_.set_value(std::move(value_)); }
+
+    private:
+    T value_;
+    R receiver_;
+  };
+
+  template <class R>
+  Operation<R> connect(R receiver) && {
+    return Operation<R>(std::move(value_), std::move(receiver));
+  }
+
+  private:
+  T value_;
+};
+
+template <>
+class JustSender<void> {
+  public:
+  using value_type = void;
+
+  ThreadPool* completionPool() const { return nullptr; }
+
+  template <class R>
+  class Operation {
+    public:
+    explicit Operation(R receiver)
+        : receiver_(std::move(receiver)) {}
+    Operation(const Operation&) = delete;
+    Operation& operator=(const Operation&) = delete;
+
+    void start() noexcept { receiver_.set_value(); }
+
+    private:
+    R receiver_;
+  };
+
+  template <class R>
+  Operation<R> connect(R receiver) && {
+    return Operation<R>(std::move(receiver));
+  }
+};
+
+inline JustSender<void> just() { return {}; }
+
+template <class T>
+JustSender<std::decay_t<T>> just(T&& value) {
+  return JustSender<std::decay_t<T>>(std::forward<T>(value));
+}
+
+/**
+ * @brief pool.schedule() 的 sender 版本，在工作线程上完成
+ * 提交的任务只捕获操作状态的指针，放在 Task 的内部缓冲区中；
+ * 入队不分配内存；STEALING 模式的本地队列保存的是任务指针，装箱的内存由工作线程回收复用
+ */
+class ScheduleSender {
+  public:
+  using value_type = void;
+
+  ScheduleSender(ThreadPool* pool, Priority priority)
+      : pool_(pool),
+        priority_(priority) {}
+
+  ThreadPool* completionPool() const { return pool_; }
+
+  template <class R>
+  class Operation {
+    public:
+    Operation(ThreadPool* pool, Priority priority, R receiver)
+        : pool_(pool),
+          priority_(priority),
+          receiver_(std::move(receiver)) {}
+    Operation(const Operation&) = delete;
+    Operation& operator=(const Operation&) = delete;
+
+    void start() noexcept {
+      try {
+        pool_->post([this]() { receiver_.set_value(); }, priority_);
+      } catch (...) {
+        receiver_.set_error(std::current_exception());
+      }
+    }
+
+    private:
+    ThreadPool* pool_;
+    Priority priority_;
+    R receiver_;
+  };
+
+  template <class R>
+  Operation<R> connect(R receiver) && {
+    return Operation<R>(pool_, priority_, std::move(receiver));
+  }
+
+  private:
+  ThreadPool* pool_;
+  Priority priority_;
+};
+
+/**
+ * @brief 把 ThreadPool 包装成 scheduler，只保存指针，可以随意拷贝
+ */
+class PoolScheduler {
+  public:
+  explicit PoolScheduler(ThreadPool& pool, Priority priority = Priority::PRIORITY_NORMAL)
+      : pool_(&pool),
+        priority_(priority) {}
+
+  ScheduleSender schedule() const { return ScheduleSender(pool_, priority_); }
+
+  ThreadPool& pool() const { return *pool_; }
+
+  bool operator==(const PoolScheduler& other) const = default;
+
+  private:
+  ThreadPool* pool_;
+  Priority priority_;
+};
+
+/**
+ * @brief then(sender, f)：前一个 sender 的值(右值)交给 f，f 的返回值作为新的值，异常走 set_error
+ */
+template <Sender S, class F>
+class ThenSender {
+  using Input = typename S::value_type;
+
+  template <class R>
+  struct Receiver {
+    R receiver;
+    F f;
+
+    template <class... V>
+    void set_value(V&&... value) noexcept {
+      try {
+        if constexpr (std::is_void_v<value_type>) {
+          std::invoke(f, std::forward<V>(value)...);
+          receiver.set_value();
+        } else {
+          receiver.set_value(std::invoke(f, std::forward<V>(value)...));
+        }
+      } catch (...) {
+        receiver.set_error(std::current_exception());
+      }
+    }
+
+    void set_error(std::exception_ptr error) noexcept { receiver.set_error(std::move(error)); }
+  };
+
+  public:
+  using value_type = detail::invoke_with_t<F&, std::add_rvalue_reference_t<Input>>;
+
+  ThenSender(S sender, F f)
+      : sender_(std::move(sender)),
+        f_(std::move(f)) {}
+
+  ThreadPool* completionPool() const { return sender_.completionPool(); }
+
+  template <class R>
+  auto connect(R receiver) && {
+    return std::move(sender_).connect(Receiver<R>{std::move(receiver), std::move(f_)});
+  }
+
+  private:
+  S sender_;
+  F f_;
+};
+
+/**
+ * @brief bulk(sender, shape, f)：对 [0, shape) 中的每个 i 调用 f(i, value&)，之后原样传出 value
+ * 前一个 sender 在线程池上完成时，切成若干块并行执行，完成的线程自己执行第一块，
+ * 最后完成的一块负责继续；否则在当前线程上顺序执行。任意一次调用抛出异常时走 set_error
+ */
+template <Sender S, class F>
+class BulkSender {
+  using Value = typename S::value_type;
+
+  public:
+  using value_type = Value;
+
+  BulkSender(S sender, std::size_t shape, F f)
+      : sender_(std::move(sender)),
+        shape_(shape),
+        f_(std::move(f)) {}
+
+  ThreadPool* completionPool() const { return sender_.completionPool(); }
+
+  template <class R>
+  class Operation {
+    struct Receiver {
+      Operation* op;
+
+      template <class... V>
+      void set_value(V&&... value) noexcept {
+        op->run(std::forward<V>(value)...);
+      }
+
+      void set_error(std::exception_ptr error) noexcept { op->receiver_.set_error(std::move(error)); }
+    };
+
+    public:
+    Operation(S&& sender, ThreadPool* pool, std::size_t shape, F f, R receiver)
+        : pool_(pool),
+          shape_(shape),
+          f_(std::move(f)),
+          receiver_(std::move(receiver)),
+          inner_(std::move(sender).connect(Receiver{this})) {}
+    Operation(const Operation&) = delete;
+    Operation& operator=(const Operation&) = delete;
+
+    void start() noexcept { inner_.start(); }
+
+    private:
+    template <class... V>
+    void run(V&&... value) {
+      if constexpr (!std::is_void_v<Value>) {
+        value_.emplace(std::forward<V>(value)...);
+      }
+      std::size_t chunks = 1;
+      if (pool_ != nullptr) {
+        auto threads = static_cast<std::size_t>(std::max(pool_->threadSize(), 1));
+        chunks = std::min(shape_, threads * config::SENDER_BULK_CHUNKS_PER_THREAD);
+      }
+      if (chunks <= 1) {
+        // 没有线程池或者只有一块，直接在当前线程上执行
+        chunks_ = 1;
+        pending_.store(1, std::memory_order_relaxed);
+        runChunk(0);
+        return;
+      }
+      chunks_ = chunks;
+      pending_.store(chunks, std::memory_order_relaxed);
+      for (std::size_t i = 1; i < chunks; i++) {
+        try {
+          pool_->post([this, i]() { runChunk(i); });
+        } catch (...) {
+          runChunk(i);
+        }
+      }
+      runChunk(0);
+    }
+
+    void runChunk(std::size_t chunk) {
+      std::size_t lo = shape_ * chunk / chunks_;
+      std::size_t hi = shape_ * (chunk + 1) / chunks_;
+      try {
+        for (std::size_t i = lo; i < hi && !failed_.load(std::memory_order_relaxed); i++) {
+          if constexpr (std::is_void_v<Value>) {
+            std::invoke(f_, i);
+          } else {
+            std::invoke(f_, i, *value_);
+          }
+        }
+      } catch (...) {
+        if (!failed_.exchange(true, std::memory_order_relaxed)) {
+          error_ = std::current_exception();
+        }
+      }
+      // 最后一块完成之后操作状态可能马上被销毁，之后不能再访问成员
+      if (pending_.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+      }
+      if (error_) {
+        receiver_.set_error(std::move(error_));
+      } else if constexpr (std::is_void_v<Value>) {
+        receiver_.set_value();
+      } else {
+        receiver_.set_value(std::move(*value_));
+      }
+    }
+
+    private:
+    using InnerOperation = decltype(std::declval<S>().connect(std::declval<Receiver>()));
+
+    ThreadPool* pool_;
+    std::size_t shape_;
+    std::size_t chunks_ = 1;
+    F f_;
+    R receiver_;
+    std::conditional_t<std::is_void_v<Value>, char, Optional<Value>> value_;
+    std::atomic<std::size_t> pending_ = {0};
+    std::atomic<bool> failed_ = {false};
+    std::exception_ptr error_;
+    InnerOperation inner_;
+  };
+
+  template <class R>
+  Operation<R> connect(R receiver) && {
+    ThreadPool* pool = sender_.completionPool();
+    return Operation<R>(std::move(sender_), pool, shape_, std::move(f_), std::move(receiver));
+  }
+
+  private:
+  S sender_;
+  std::size_t shape_;
+  F f_;
+};
+
+/**
+ * @brief let_value(sender, f)：f(value&) 返回一个新的 sender，新的 sender 的结果作为最终结果
+ * 值和第二个操作状态都保存在本操作状态内部，值在第二个 sender 完成之前一直有效
+ */
+template <Sender S, class F>
+class LetValueSender {
+  using Input = typename S::value_type;
+  using Next = detail::invoke_with_t<F&, std::add_lvalue_reference_t<Input>>;
+  static_assert(Sender<Next>, "let_value function must return a sender");
+
+  public:
+  using value_type = typename Next::value_type;
+
+  LetValueSender(S sender, F f)
+      : sender_(std::move(sender)),
+        f_(std::move(f)) {}
+
+  // 第二个 sender 在运行时才知道，不能确定在哪里完成
+  ThreadPool* completionPool() const { return nullptr; }
+
+  template <class R>
+  class Operation {
+    // 接收第一个 sender 的值
+    struct FirstReceiver {
+      Operation* op;
+
+      template <class... V>
+      void set_value(V&&... value) noexcept {
+        op->startNext(std::forward<V>(value)...);
+      }
+
+      void set_error(std::exception_ptr error) noexcept { op->receiver_.set_error(std::move(error)); }
+    };
+
+    // 把第二个 sender 的结果转给最终的 receiver
+    struct NextReceiver {
+      Operation* op;
+
+      template <class... V>
+      void set_value(V&&... value) noexcept {
+        op->receiver_.set_value(std::forward<V>(value)...);
+      }
+
+      void set_error(std::exception_ptr error) noexcept { op->receiver_.set_error(std::move(error)); }
+    };
+
+    public:
+    Operation(S&& sender, F f, R receiver)
+        : f_(std::move(f)),
+          receiver_(std::move(receiver)),
+          first_(std::move(sender).connect(FirstReceiver{this})) {}
+    Operation(const Operation&) = delete;
+    Operation& operator=(const Operation&) = delete;
+
+    void start() noexcept { first_.start(); }
+
+    private:
+    template <class... V>
+    void startNext(V&&... value) {
+      try {
+        if constexpr (std::is_void_v<Input>) {
+          next_.emplace(detail::Emplacer{
+              [this]() { return std::invoke(f_).connect(NextReceiver{this}); }});
+        } else {
+          value_.emplace(std::forward<V>(value)...);
+          next_.emplace(detail::Emplacer{
+              [this]() { return std::invoke(f_, *value_).connect(NextReceiver{this}); }});
+        }
+      } catch (...) {
+        receiver_.set_error(std::current_exception());
+        return;
+      }
+      next_->start();
+    }
+
+    private:
+    using FirstOperation = decltype(std::declval<S>().connect(std::declval<FirstReceiver>()));
+    using NextOperation = decltype(std::declval<Next>().connect(std::declval<NextReceiver>()));
+
+    F f_;
+    R receiver_;
+    std::conditional_t<std::is_void_v<Input>, char, Optional<Input>> value_;
+    FirstOperation first_;
+    Optional<NextOperation> next_;
+  };
+
+  template <class R>
+  Operation<R> connect(R receiver) && {
+    return Operation<R>(std::move(sender_), std::move(f_), std::move(receiver));
+  }
+
+  private:
+  S sender_;
+  F f_;
+};
+
+template <Sender S, class F>
+ThenSender<S, F> then(S sender, F f) {
+  return ThenSender<S, F>(std::move(sender), std::move(f));
+}
+
+template <Sender S, class F>
+BulkSender<S, F> bulk(S sender, std::size_t shape, F f) {
+  return BulkSender<S, F>(std::move(sender), shape, std::move(f));
+}
+
+template <Sender S, class F>
+LetValueSender<S, F> let_value(S sender, F f) {
+  return LetValueSender<S, F>(std::move(sender), std::move(f));
+}
+
+namespace detail {
+template <class F>
+struct ThenClosure : SenderClosure {
+  F f;
+
+  template <Sender S>
+  auto operator()(S sender) && {
+    return execution::then(std::move(sender), std::move(f));
+  }
+};
+
+template <class F>
+struct BulkClosure : SenderClosure {
+  std::size_t shape;
+  F f;
+
+  template <Sender S>
+  auto operator()(S sender) && {
+    return execution::bulk(std::move(sender), shape, std::move(f));
+  }
+};
+
+template <class F>
+struct LetValueClosure : SenderClosure {
+  F f;
+
+  template <Sender S>
+  auto operator()(S sender) && {
+    return execution::let_value(std::move(sender), std::move(f));
+  }
+};
+}  // namespace detail
+
+template <class F>
+detail::ThenClosure<F> then(F f) {
+  return {{}, std::move(f)};
+}
+
+template <class F>
+detail::BulkClosure<F> bulk(std::size_t shape, F f) {
+  return {{}, shape, std::move(f)};
+}
+
+template <class F>
+detail::LetValueClosure<F> let_value(F f) {
+  return {{}, std::move(f)};
+}
+
+template <Sender S, detail::Closure C>
+auto operator|(S sender, C closure) {
+  return std::move(closure)(std::move(sender));
+}
+
+namespace detail {
+template <class T>
+struct SyncWaitState {
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool done = false;
+  std::conditional_t<std::is_void_v<T>, char, Optional<T>> value;
+  std::exception_ptr error;
+
+  // 在锁内通知，等待方拿到锁时通知方已经不再访问这里的成员
+  void finish() {
+    std::lock_guard<std::mutex> lock(mtx);
+    done = true;
+    cv.notify_one();
+  }
+};
+
+template <class T>
+struct SyncWaitReceiver {
+  SyncWaitState<T>* state;
+
+  template <class... V>
+  void set_value(V&&... value) noexcept {
+    try {
+      if constexpr (!std::is_void_v<T>) {
+        state->value.emplace(std::forward<V>(value)...);
+      }
+    } catch (...) {
+      state->error = std::current_exception();
+    }
+    state->finish();
+  }
+
+  void set_error(std::exception_ptr error) noexcept {
+    state->error = std::move(error);
+    state->finish();
+  }
+};
+}  // namespace detail
+
+/**
+ * @brief 启动 sender 并阻塞等待结果，set_error 传来的异常在这里重新抛出
+ * 操作状态放在当前栈帧上；不能在 sender 所需的线程池的工作线程上调用
+ */
+template <Sender S>
+auto sync_wait(S sender) -> typename S::value_type {
+  using T = typename S::value_type;
+  detail::SyncWaitState<T> state;
+  auto op = std::move(sender).connect(detail::SyncWaitReceiver<T>{&state});
+  op.start();
+  {
+    std::unique_lock<std::mutex> lock(state.mtx);
+    state.cv.wait(lock, [&state]() { return state.done; });
+  }
+  if (state.error) {
+    std::rethrow_exception(state.error);
+  }
+  if constexpr (!std::is_void_v<T>) {
+    return std::move(*state.value);
+  }
+}
+
+}  // namespace execution
+}  // namespace threadpool
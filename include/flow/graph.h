@@ -0,0 +1,560 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "function/unique_function.h"
+#include "queue/lockfree_queue.h"
+#include "queue/wait_strategy.h"
+#include "thread/parallel.h"
+#include "thread/threadpool.h"
+
+namespace threadpool {
+namespace config {
+static constexpr const int FLOW_BUFFER_CAPACITY = 64;  // 每条边默认的缓冲区容量
+static constexpr const int FLOW_NODE_BATCH = 32;       // 节点一次激活最多处理的消息数，之后重新排队
+}  // namespace config
+
+/**
+ * @brief 在线程池上执行的数据流图，类似 TBB flow graph
+ * 节点的每个输入端口是一个 BoundedQueue，上游先在所有下游端口上预留位置，预留成功才取出输入执行，
+ * 所以输出总能放进下游的缓冲区；下游已满时上游停下来，等下游取走消息后再被唤醒，
+ * 背压一直传到源节点，整个图中的消息数不超过各缓冲区容量之和，工作线程也不会阻塞在满的队列上。
+ * 节点没有消息时不占用线程池，有消息到达才提交执行，同时执行的数量不超过节点的并发上限。
+ * 消息在各级之间移动而不是复制，只有广播到多个后继时才复制(最后一个后继仍然是移动)。
+ * 消息类型需要可以默认构造，并且移动构造不抛出异常。
+ */
+namespace flow {
+
+inline constexpr std::size_t serial = 1;
+inline constexpr std::size_t unlimited = SIZE_MAX;
+
+class Graph;
+
+namespace detail {
+
+// 节点的调度：并发计数和激活，具体的处理由派生类的 step 完成
+class NodeBase {
+  public:
+  NodeBase(Graph& graph, std::size_t concurrency)
+      : graph_(graph),
+        concurrency_(concurrency == 0 ? 1 : concurrency) {}
+  virtual ~NodeBase() = default;
+  // non-copy
+  NodeBase(const NodeBase&) = delete;
+  NodeBase& operator=(const NodeBase&) = delete;
+
+  // 有新的输入或者下游腾出了位置，并发没有达到上限时提交一次激活
+  void schedule() {
+    // 和 run 中释放名额之后的检查配对，二者至少有一方能看到对方的修改
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (tryAcquire()) {
+      post();
+    }
+  }
+
+  protected:
+  enum class Step : std::uint8_t {
+    STEP_DONE,     // 处理了一条消息
+    STEP_IDLE,     // 没有输入
+    STEP_BLOCKED,  // 下游没有位置
+  };
+
+  // 处理一条消息
+  virtual Step step() = 0;
+  // 是否有可以处理的消息，释放名额之后再检查一次，避免丢失唤醒
+  virtual bool ready() = 0;
+
+  threadpool::detail::ParallelContext& context();
+
+  private:
+  bool tryAcquire() {
+    std::size_t active = active_.load(std::memory_order_relaxed);
+    while (active < concurrency_) {
+      if (active_.compare_exchange_weak(active, active + 1, std::memory_order_acq_rel,
+                                        std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void post();
+
+  void run() {
+    for (int n = 0; n < config::FLOW_NODE_BATCH; n++) {
+      if (step() == Step::STEP_DONE) {
+        continue;
+      }
+      active_.fetch_sub(1, std::memory_order_seq_cst);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (!ready() || !tryAcquire()) {
+        return;
+      }
+    }
+    // 仍然持有名额，重新排队让其他节点有机会执行
+    post();
+  }
+
+  private:
+  Graph& graph_;
+  std::size_t concurrency_;
+  std::atomic<std::size_t> active_ = {0};
+};
+
+}  // namespace detail
+
+/**
+ * @brief 图本身只跟踪正在执行的激活和第一个异常，节点需要在 wait_for_all 返回之后才能析构
+ */
+class Graph {
+  public:
+  explicit Graph(ThreadPool& pool, Priority priority = Priority::PRIORITY_NORMAL)
+      : pool_(pool),
+        priority_(priority),
+        ctx_(std::make_shared<threadpool::detail::ParallelContext>()) {}
+
+  ~Graph() {
+    try {
+      wait_for_all();
+    } catch (...) {
+    }
+  }
+
+  // non-copy
+  Graph(const Graph&) = delete;
+  Graph& operator=(const Graph&) = delete;
+
+  /**
+   * @brief 等待图中所有的消息处理完，等待时帮忙执行线程池中排队的任务
+   * 节点抛出异常之后，之后的消息不再执行而是直接丢弃，源节点停止产生消息，这里重新抛出第一个异常，
+   * 图随后可以再次使用
+   */
+  void wait_for_all() {
+    try {
+      ctx_->wait(pool_, true);
+    } catch (...) {
+      ctx_ = std::make_shared<threadpool::detail::ParallelContext>();
+      throw;
+    }
+  }
+
+  // 是否有节点抛出了异常
+  bool is_canceling() const { return ctx_->failed(); }
+
+  ThreadPool& pool() { return pool_; }
+
+  private:
+  friend class detail::NodeBase;
+
+  ThreadPool& pool_;
+  Priority priority_;
+  std::shared_ptr<threadpool::detail::ParallelContext> ctx_;
+};
+
+namespace detail {
+
+inline threadpool::detail::ParallelContext& NodeBase::context() { return *graph_.ctx_; }
+
+inline void NodeBase::post() {
+  // 激活计入图的计数，wait_for_all 等到所有激活结束
+  auto ctx = graph_.ctx_;
+  ctx->add(1);
+  graph_.pool_.post(
+      [this, ctx]() {
+        run();
+        ctx->done();
+      },
+      graph_.priority_);
+}
+
+/**
+ * @brief 节点的输入端口，消息先预留位置再放入，取出之后归还位置并唤醒因为没有位置而停下的上游
+ */
+template <class T>
+class InputPort {
+  static_assert(std::is_default_constructible_v<T>, "flow graph requires default constructible messages");
+
+  public:
+  InputPort(NodeBase* owner, std::size_t capacity)
+      : owner_(owner),
+        capacity_(capacity == 0 ? 1 : capacity) {
+    // 端口的队列从不等待，预留保证入队时一定有位置
+    queue_.Init(capacity_, new wait_strategy::YieldWaitStrategy());
+  }
+
+  // non-copy
+  InputPort(const InputPort&) = delete;
+  InputPort& operator=(const InputPort&) = delete;
+
+  /**
+   * @brief 从图外放入一条消息，缓冲区满时返回 false，消息不会被移走
+   */
+  bool try_put(T&& item) {
+    if (!reserve()) {
+      return false;
+    }
+    put(std::move(item));
+    return true;
+  }
+
+  bool try_put(const T& item) {
+    T copy(item);
+    return try_put(std::move(copy));
+  }
+
+  std::size_t capacity() const { return capacity_; }
+
+  // 近似值
+  std::size_t size() { return queue_.size(); }
+
+  bool reserve() {
+    std::size_t reserved = reserved_.load(std::memory_order_relaxed);
+    while (reserved < capacity_) {
+      if (reserved_.compare_exchange_weak(reserved, reserved + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // 预留失败之后登记，再尝试一次，和 release 中的检查配对
+  bool reserveOrWait() {
+    full_.store(true, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return reserve();
+  }
+
+  bool hasRoom() const { return reserved_.load(std::memory_order_seq_cst) < capacity_; }
+
+  // 归还一个预留的位置
+  void release() {
+    reserved_.fetch_sub(1, std::memory_order_seq_cst);
+    if (full_.load(std::memory_order_seq_cst) && full_.exchange(false, std::memory_order_seq_cst)) {
+      for (NodeBase* pred : predecessors_) {
+        pred->schedule();
+      }
+    }
+  }
+
+  // 放入已经预留位置的消息
+  void put(T&& item) {
+    // 位置已经预留，失败只是因为其他消费者还在移出这个槽位之前的元素
+    while (!queue_.enqueue(std::move(item))) {
+      wait_strategy::CpuRelax();
+    }
+    owner_->schedule();
+  }
+
+  bool empty() { return queue_.empty(); }
+
+  bool take(T* item) {
+    if (!queue_.dequeue(item)) {
+      return false;
+    }
+    release();
+    return true;
+  }
+
+  void addPredecessor(NodeBase* pred) { predecessors_.push_back(pred); }
+
+  private:
+  NodeBase* owner_;
+  std::size_t capacity_;
+  BoundedQueue<T> queue_;
+  std::atomic<std::size_t> reserved_ = {0};  // 已经预留和还在队列中的消息数
+  std::atomic<bool> full_ = {false};         // 有上游因为没有位置而停下
+  std::vector<NodeBase*> predecessors_;
+};
+
+/**
+ * @brief 节点的输出：一次在所有后继上预留位置，然后把消息移动(或者复制)过去
+ */
+template <class T>
+class OutputPort {
+  public:
+  explicit OutputPort(NodeBase* owner)
+      : owner_(owner) {}
+
+  // non-copy
+  OutputPort(const OutputPort&) = delete;
+  OutputPort& operator=(const OutputPort&) = delete;
+
+  void addSuccessor(InputPort<T>* succ) {
+    if constexpr (!std::is_copy_constructible_v<T>) {
+      if (!successors_.empty()) {
+        throw std::logic_error("flow graph: move-only message can not have more than one successor");
+      }
+    }
+    successors_.push_back(succ);
+  }
+
+  NodeBase* owner() const { return owner_; }
+
+  // 在所有后继上预留一个位置，失败时归还已经预留的位置
+  bool reserve() {
+    for (std::size_t i = 0; i < successors_.size(); i++) {
+      if (successors_[i]->reserve() || successors_[i]->reserveOrWait()) {
+        continue;
+      }
+      for (std::size_t j = 0; j < i; j++) {
+        successors_[j]->release();
+      }
+      return false;
+    }
+    return true;
+  }
+
+  bool hasRoom() const {
+    for (auto* succ : successors_) {
+      if (!succ->hasRoom()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void release() {
+    for (auto* succ : successors_) {
+      succ->release();
+    }
+  }
+
+  // 没有后继时消息被丢弃
+  void emit(T&& item) {
+    if (successors_.empty()) {
+      return;
+    }
+    if constexpr (std::is_copy_constructible_v<T>) {
+      for (std::size_t i = 0; i + 1 < successors_.size(); i++) {
+        T copy(item);
+        successors_[i]->put(std::move(copy));
+      }
+    }
+    successors_.back()->put(std::move(item));
+  }
+
+  private:
+  NodeBase* owner_;
+  std::vector<InputPort<T>*> successors_;
+};
+
+}  // namespace detail
+
+/**
+ * @brief 源节点：串行地调用 body(token)，返回 false 表示没有更多的消息
+ * 只在下游有位置时才调用 body，activate 之后开始产生消息
+ */
+template <class T>
+class SourceNode : public detail::NodeBase, public detail::OutputPort<T> {
+  public:
+  using Body = UniqueFunction<bool(T&)>;
+
+  SourceNode(Graph& graph, Body body)
+      : detail::NodeBase(graph, serial),
+        detail::OutputPort<T>(this),
+        body_(std::move(body)) {}
+
+  // 开始(或者在结束之后重新开始)产生消息
+  void activate() {
+    running_.store(true, std::memory_order_seq_cst);
+    schedule();
+  }
+
+  protected:
+  Step step() override {
+    if (!running_.load(std::memory_order_seq_cst)) {
+      return Step::STEP_IDLE;
+    }
+    if (!this->reserve()) {
+      return Step::STEP_BLOCKED;
+    }
+    T token;
+    bool more = false;
+    context().run([&]() { more = body_(token); });
+    if (!more) {
+      // 没有更多的消息，或者图中出现了异常
+      this->release();
+      running_.store(false, std::memory_order_seq_cst);
+      return Step::STEP_IDLE;
+    }
+    this->emit(std::move(token));
+    return Step::STEP_DONE;
+  }
+
+  bool ready() override { return running_.load(std::memory_order_seq_cst) && this->hasRoom(); }
+
+  private:
+  Body body_;
+  std::atomic<bool> running_ = {false};
+};
+
+/**
+ * @brief 函数节点：对每条输入调用 body(std::move(input))，结果发给所有后继
+ * 最多 concurrency 个线程同时执行 body，concurrency 为 serial 时按输入的顺序处理
+ */
+template <class In, class Out>
+class FunctionNode : public detail::NodeBase, public detail::InputPort<In>, public detail::OutputPort<Out> {
+  public:
+  using Body = UniqueFunction<Out(In)>;
+
+  FunctionNode(Graph& graph, std::size_t concurrency, Body body,
+               std::size_t capacity = config::FLOW_BUFFER_CAPACITY)
+      : detail::NodeBase(graph, concurrency),
+        detail::InputPort<In>(this, capacity),
+        detail::OutputPort<Out>(this),
+        body_(std::move(body)) {}
+
+  protected:
+  Step step() override {
+    if (this->empty()) {
+      return Step::STEP_IDLE;
+    }
+    if (!this->detail::OutputPort<Out>::reserve()) {
+      return Step::STEP_BLOCKED;
+    }
+    In input;
+    if (!this->take(&input)) {
+      // 被同一节点的其他激活取走了
+      this->detail::OutputPort<Out>::release();
+      return Step::STEP_IDLE;
+    }
+    Out output;
+    bool ok = false;
+    context().run([&]() {
+      output = body_(std::move(input));
+      ok = true;
+    });
+    if (!ok) {
+      this->detail::OutputPort<Out>::release();
+      return Step::STEP_DONE;
+    }
+    this->emit(std::move(output));
+    return Step::STEP_DONE;
+  }
+
+  bool ready() override { return !this->empty() && this->detail::OutputPort<Out>::hasRoom(); }
+
+  private:
+  Body body_;
+};
+
+/**
+ * @brief 广播节点：按顺序把每条输入发给所有后继
+ */
+template <class T>
+class BroadcastNode : public FunctionNode<T, T> {
+  public:
+  explicit BroadcastNode(Graph& graph, std::size_t capacity = config::FLOW_BUFFER_CAPACITY)
+      : FunctionNode<T, T>(
+            graph, serial, [](T item) { return item; }, capacity) {}
+};
+
+/**
+ * @brief 汇节点：对每条输入调用 body(std::move(input))，没有输出
+ */
+template <class In>
+class SinkNode : public detail::NodeBase, public detail::InputPort<In> {
+  public:
+  using Body = UniqueFunction<void(In)>;
+
+  SinkNode(Graph& graph, std::size_t concurrency, Body body,
+           std::size_t capacity = config::FLOW_BUFFER_CAPACITY)
+      : detail::NodeBase(graph, concurrency),
+        detail::InputPort<In>(this, capacity),
+        body_(std::move(body)) {}
+
+  protected:
+  Step step() override {
+    In input;
+    if (!this->take(&input)) {
+      return Step::STEP_IDLE;
+    }
+    context().run([&]() { body_(std::move(input)); });
+    return Step::STEP_DONE;
+  }
+
+  bool ready() override { return !this->empty(); }
+
+  private:
+  Body body_;
+};
+
+/**
+ * @brief 连接节点：每个输入端口各取一条消息，组成 std::tuple 发给后继
+ * 串行执行，各端口的消息按到达的顺序配对
+ */
+template <class... Ts>
+class JoinNode : public detail::NodeBase, public detail::OutputPort<std::tuple<Ts...>> {
+  using Output = detail::OutputPort<std::tuple<Ts...>>;
+
+  public:
+  explicit JoinNode(Graph& graph, std::size_t capacity = config::FLOW_BUFFER_CAPACITY)
+      : detail::NodeBase(graph, serial),
+        Output(this),
+        ports_(std::make_tuple(std::make_unique<detail::InputPort<Ts>>(this, capacity)...)) {}
+
+  template <std::size_t I>
+  auto& input() {
+    return *std::get<I>(ports_);
+  }
+
+  protected:
+  Step step() override {
+    if (!allReady(std::index_sequence_for<Ts...>{})) {
+      return Step::STEP_IDLE;
+    }
+    if (!Output::reserve()) {
+      return Step::STEP_BLOCKED;
+    }
+    std::tuple<Ts...> output;
+    takeAll(output, std::index_sequence_for<Ts...>{});
+    this->emit(std::move(output));
+    return Step::STEP_DONE;
+  }
+
+  bool ready() override { return allReady(std::index_sequence_for<Ts...>{}) && Output::hasRoom(); }
+
+  private:
+  template <std::size_t... I>
+  bool allReady(std::index_sequence<I...>) {
+    return (!std::get<I>(ports_)->empty() && ...);
+  }
+
+  template <std::size_t... I>
+  void takeAll(std::tuple<Ts...>& output, std::index_sequence<I...>) {
+    // 只有这一个消费者，端口非空时取出失败只是因为生产者还没有写完
+    (takeOne(*std::get<I>(ports_), &std::get<I>(output)), ...);
+  }
+
+  template <class T>
+  static void takeOne(detail::InputPort<T>& port, T* item) {
+    while (!port.take(item)) {
+      wait_strategy::CpuRelax();
+    }
+  }
+
+  private:
+  std::tuple<std::unique_ptr<detail::InputPort<Ts>>...> ports_;
+};
+
+/**
+ * @brief 连接两个节点，需要在图开始执行之前完成
+ */
+template <class T>
+void make_edge(detail::OutputPort<T>& from, detail::InputPort<T>& to) {
+  from.addSuccessor(&to);
+  to.addPredecessor(from.owner());
+}
+
+}  // namespace flow
+}  // namespace threadpool
@@ -0,0 +1,158 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+template <class Fnsig, std::size_t InlineSize = 48>  // 如果模板参数仅为一个没有传入参数，则报错
+struct UniqueFunction {
+  static_assert(!std::is_same_v<Fnsig, Fnsig>, "not a valid function signature");
+};
+
+/**
+ * @brief 只能移动的 Function
+ * 小于 InlineSize 的仿函数直接构造在对象内部的缓冲区中，不需要堆分配；
+ * 使用手写的虚表代替虚函数，也没有 shared_ptr 的原子引用计数开销。
+ */
+template <class Ret, class... Args, std::size_t InlineSize>
+struct UniqueFunction<Ret(Args...), InlineSize> {
+  private:
+  // 类型擦除后的统一接口
+  struct VTable {
+    Ret (*call)(void* storage, Args&&... args);
+    void (*move)(void* dst, void* src) noexcept;  // 移动构造到dst并析构src
+    void (*destroy)(void* storage) noexcept;
+  };
+
+  // 能否放入内部缓冲区，移动时不能抛异常，否则移动操作无法保证 noexcept
+  // Ret 为 void 时丢弃仿函数的返回值，和 std::function 的行为一致
+  template <class F>
+  static Ret invoke(F& f, Args&&... args) {
+    if constexpr (std::is_void_v<Ret>) {
+      std::invoke(f, std::forward<Args>(args)...);
+    } else {
+      return std::invoke(f, std::forward<Args>(args)...);
+    }
+  }
+
+  template <class F>
+  static constexpr bool kInline = sizeof(F) <= InlineSize &&
+                                  alignof(F) <= alignof(std::max_align_t) &&
+                                  std::is_nothrow_move_constructible_v<F>;
+
+  template <class F>
+  struct InlineImpl {
+    static F* get(void* storage) { return std::launder(reinterpret_cast<F*>(storage)); }
+
+    static Ret call(void* storage, Args&&... args) {
+      return invoke(*get(storage), std::forward<Args>(args)...);
+    }
+
+    static void move(void* dst, void* src) noexcept {
+      ::new (dst) F(std::move(*get(src)));
+      get(src)->~F();
+    }
+
+    static void destroy(void* storage) noexcept { get(storage)->~F(); }
+
+    static constexpr VTable vtable = {&call, &move, &destroy};
+  };
+
+  // 放不下的仿函数在堆上分配，缓冲区里只存指针
+  template <class F>
+  struct HeapImpl {
+    static F*& get(void* storage) { return *std::launder(reinterpret_cast<F**>(storage)); }
+
+    static Ret call(void* storage, Args&&... args) {
+      return invoke(*get(storage), std::forward<Args>(args)...);
+    }
+
+    static void move(void* dst, void* src) noexcept {
+      ::new (dst) F*(get(src));
+      get(src) = nullptr;
+    }
+
+    static void destroy(void* storage) noexcept { delete get(storage); }
+
+    static constexpr VTable vtable = {&call, &move, &destroy};
+  };
+
+  template <class F>
+  using DecayIsSelf = std::is_same<std::decay_t<F>, UniqueFunction>;
+
+  public:
+  UniqueFunction() = default;
+
+  UniqueFunction(std::nullptr_t) noexcept {}
+
+  // 阻止 UniqueFunction 从不可调用的对象中初始化
+  template <class F,
+            class = std::enable_if_t<!DecayIsSelf<F>::value &&
+                                     std::is_invocable_r_v<Ret, std::decay_t<F>&, Args...>>>
+  UniqueFunction(F&& f) {  // 没有 explicit，允许 lambda 表达式隐式转换
+    using Fn = std::decay_t<F>;
+    if constexpr (kInline<Fn>) {
+      ::new (static_cast<void*>(storage_)) Fn(std::forward<F>(f));
+      vtable_ = &InlineImpl<Fn>::vtable;
+    } else {
+      ::new (static_cast<void*>(storage_)) Fn*(new Fn(std::forward<F>(f)));
+      vtable_ = &HeapImpl<Fn>::vtable;
+    }
+  }
+
+  // non-copy
+  UniqueFunction(const UniqueFunction&) = delete;
+  UniqueFunction& operator=(const UniqueFunction&) = delete;
+
+  UniqueFunction(UniqueFunction&& other) noexcept
+      : vtable_(other.vtable_) {
+    if (vtable_) {
+      vtable_->move(storage_, other.storage_);
+      other.vtable_ = nullptr;
+    }
+  }
+
+  UniqueFunction& operator=(UniqueFunction&& other) noexcept {
+    if (this == &other) return *this;
+    reset();
+    if (other.vtable_) {
+      other.vtable_->move(storage_, other.storage_);
+      vtable_ = other.vtable_;
+      other.vtable_ = nullptr;
+    }
+    return *this;
+  }
+
+  UniqueFunction& operator=(std::nullptr_t) noexcept {
+    reset();
+    return *this;
+  }
+
+  ~UniqueFunction() { reset(); }
+
+  Ret operator()(Args... args) const {
+    if (!vtable_) [[unlikely]]
+      throw std::runtime_error("function pointer not initialized");
+    return vtable_->call(storage_, std::forward<Args>(args)...);
+  }
+
+  void reset() noexcept {
+    if (vtable_) {
+      vtable_->destroy(storage_);
+      vtable_ = nullptr;
+    }
+  }
+
+  explicit operator bool() const noexcept { return vtable_ != nullptr; }
+
+  bool operator==(std::nullptr_t) const noexcept { return vtable_ == nullptr; }
+
+  bool operator!=(std::nullptr_t) const noexcept { return vtable_ != nullptr; }
+
+  private:
+  // 和Function一样，operator()是const的，被调用的仿函数本身允许修改自身状态
+  alignas(std::max_align_t) mutable unsigned char storage_[InlineSize];
+  const VTable* vtable_ = nullptr;
+};
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+
+namespace threadpool {
+
+/**
+ * @brief 定长内存块的无锁slab
+ * 内存按chunk申请，每个chunk切分成 kBlockCount 个 kBlockSize 大小的内存块，
+ * 空闲块用带版本号的下标串成无锁栈(避免ABA)，申请和释放都只需要一次CAS。
+ * chunk只增不减，slab本身采用引用计数：持有者和每个未归还的内存块各占一个引用，
+ * 因此即使线程池先析构，尚未get的future也能安全地归还内存。
+ */
+class SlabAllocator {
+  public:
+  static constexpr std::size_t kBlockSize = 128;
+  static constexpr std::uint32_t kBlockCount = 1024;  // 每个chunk的内存块数量
+  static constexpr std::uint32_t kMaxChunks = 4096;
+  static constexpr std::uint32_t kInvalidIndex = UINT32_MAX;
+
+  SlabAllocator()
+      : chunks_(new std::atomic<Chunk*>[kMaxChunks]) {
+    for (std::uint32_t i = 0; i < kMaxChunks; i++) {
+      chunks_[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  SlabAllocator(const SlabAllocator&) = delete;
+  SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+  /**
+   * @brief 申请一个内存块
+   *
+   * @param index 内存块下标，释放时使用
+   * @return void* 内存耗尽时返回nullptr，由调用方自行回退到堆分配
+   */
+  void* allocate(std::uint32_t* index) {
+    std::uint64_t head = head_.load(std::memory_order_acquire);
+    while (true) {
+      std::uint32_t top = static_cast<std::uint32_t>(head);
+      if (top == kInvalidIndex) {
+        if (!grow()) {
+          return nullptr;
+        }
+        head = head_.load(std::memory_order_acquire);
+        continue;
+      }
+      std::uint32_t next = chunk(top)->next[top % kBlockCount].load(std::memory_order_relaxed);
+      if (head_.compare_exchange_weak(head, pack(head, next), std::memory_order_acq_rel,
+                                      std::memory_order_acquire)) {
+        refs_.fetch_add(1, std::memory_order_relaxed);
+        *index = top;
+        return chunk(top)->blocks[top % kBlockCount].data;
+      }
+    }
+  }
+
+  void deallocate(std::uint32_t index) {
+    push(index, index);
+    release();
+  }
+
+  /**
+   * @brief 在内存块中构造对象，对象放不进内存块或者内存耗尽时退化为堆分配
+   * T 需要一个 std::uint32_t index 成员，记录内存块的下标(堆分配时为 kInvalidIndex)，用 destroy 释放
+   */
+  template <class T, class... Args>
+  T* create(Args&&... args) {
+    T* object = nullptr;
+    std::uint32_t index = kInvalidIndex;
+    if constexpr (sizeof(T) <= kBlockSize && alignof(T) <= alignof(Block)) {
+      if (void* mem = allocate(&index)) {
+        try {
+          object = ::new (mem) T(std::forward<Args>(args)...);
+        } catch (...) {
+          deallocate(index);
+          throw;
+        }
+      }
+    }
+    if (object == nullptr) {
+      object = new T(std::forward<Args>(args)...);
+    }
+    object->index = index;
+    return object;
+  }
+
+  template <class T>
+  void destroy(T* object) {
+    std::uint32_t index = object->index;
+    if (index == kInvalidIndex) {
+      delete object;
+      return;
+    }
+    object->~T();
+    deallocate(index);
+  }
+
+  // 持有者放弃引用，最后一个引用负责释放slab
+  void release() {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  private:
+  // 只能通过 release() 释放
+  ~SlabAllocator() {
+    for (std::uint32_t i = 0; i < chunkSize_; i++) {
+      delete chunks_[i].load(std::memory_order_relaxed);
+    }
+  }
+
+  struct alignas(64) Block {
+    unsigned char data[kBlockSize];
+  };
+
+  struct Chunk {
+    std::atomic<std::uint32_t> next[kBlockCount];
+    Block blocks[kBlockCount];
+  };
+
+  Chunk* chunk(std::uint32_t index) {
+    return chunks_[index / kBlockCount].load(std::memory_order_acquire);
+  }
+
+  // 高32位是版本号，每次修改栈顶都加一
+  static std::uint64_t pack(std::uint64_t old, std::uint32_t top) {
+    return (((old >> 32) + 1) << 32) | top;
+  }
+
+  // 把 first..last 这一串已经链好的内存块压入空闲栈
+  void push(std::uint32_t first, std::uint32_t last) {
+    std::uint64_t head = head_.load(std::memory_order_acquire);
+    do {
+      chunk(last)->next[last % kBlockCount].store(static_cast<std::uint32_t>(head),
+                                                   std::memory_order_relaxed);
+    } while (!head_.compare_exchange_weak(head, pack(head, first), std::memory_order_acq_rel,
+                                          std::memory_order_acquire));
+  }
+
+  bool grow() {
+    std::lock_guard<std::mutex> lock(growMtx_);
+    if (static_cast<std::uint32_t>(head_.load(std::memory_order_acquire)) != kInvalidIndex) {
+      return true;  // 其他线程已经扩容
+    }
+    if (chunkSize_ == kMaxChunks) {
+      return false;
+    }
+    std::uint32_t base = chunkSize_ * kBlockCount;
+    auto* c = new Chunk;
+    for (std::uint32_t i = 0; i + 1 < kBlockCount; i++) {
+      c->next[i].store(base + i + 1, std::memory_order_relaxed);
+    }
+    chunks_[chunkSize_].store(c, std::memory_order_release);
+    chunkSize_++;
+    push(base, base + kBlockCount - 1);
+    return true;
+  }
+
+  private:
+#define CACHELINE_SIZE 64
+  alignas(CACHELINE_SIZE) std::atomic<std::uint64_t> head_ = {kInvalidIndex};
+  alignas(CACHELINE_SIZE) std::atomic<std::int64_t> refs_ = {1};
+#undef CACHELINE_SIZE
+  std::unique_ptr<std::atomic<Chunk*>[]> chunks_;
+  std::uint32_t chunkSize_ = 0;
+  std::mutex growMtx_;
+};
+
+}  // namespace threadpool
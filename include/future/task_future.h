@@ -0,0 +1,631 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "future/slab_allocator.h"
+#include "optional/optional.h"
+#include "queue/wait_strategy.h"
+
+namespace threadpool {
+
+// 任务过了截止时间才轮到执行，没有运行就被丢弃
+class TaskExpiredError : public std::runtime_error {
+  public:
+  TaskExpiredError()
+      : std::runtime_error("task expired before execution") {}
+};
+
+// 任务在开始执行之前就被取消，没有运行
+class TaskCancelledError : public std::runtime_error {
+  public:
+  TaskCancelledError()
+      : std::runtime_error("task cancelled before execution") {}
+};
+
+namespace detail {
+enum FutureStatus : std::uint32_t {
+  kPending = 0,
+  kReady = 1,
+  kWaiting = 2,  // 有线程阻塞在 atomic::wait 上，完成时需要唤醒
+};
+
+/**
+ * @brief 完成回调，存储由注册方提供(then 的节点、when_all 的槽位、协程的等待体)，回调执行之前一直有效
+ * 同一个共享状态上的回调串成无锁链表，完成时依次调用
+ */
+struct FutureCallback {
+  void (*fn)(void*) = nullptr;
+  void* arg = nullptr;
+  FutureCallback* next = nullptr;
+};
+
+// 回调链表的头被替换成它之后说明已经完成，不能再注册
+inline FutureCallback kCallbacksDone;
+
+template <class T>
+struct ValueStorage {
+  template <class... U>
+  void set(U&&... value) {
+    value_.emplace(std::forward<U>(value)...);
+  }
+
+  T take() { return std::move(*value_); }
+
+  Optional<T> value_;
+};
+
+template <>
+struct ValueStorage<void> {
+  void set() {}
+
+  void take() {}
+};
+
+/**
+ * @brief future 和 promise 共享的状态
+ * 优先从线程池的slab中分配，完成时只需要一次原子交换，
+ * 没有等待者时不会产生任何系统调用。
+ */
+template <class T>
+class SharedState {
+  public:
+  static SharedState* create(SlabAllocator* slab) {
+    if constexpr (sizeof(SharedState) <= SlabAllocator::kBlockSize && alignof(SharedState) <= 64) {
+      std::uint32_t index = SlabAllocator::kInvalidIndex;
+      if (slab != nullptr) {
+        if (void* mem = slab->allocate(&index)) {
+          return ::new (mem) SharedState(slab, index);
+        }
+      }
+    }
+    return new SharedState(nullptr, SlabAllocator::kInvalidIndex);
+  }
+
+  // future 和 promise 各持有一个引用
+  void release() {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+      return;
+    }
+    if (slab_ == nullptr) {
+      delete this;
+      return;
+    }
+    SlabAllocator* slab = slab_;
+    std::uint32_t index = index_;
+    this->~SharedState();
+    slab->deallocate(index);
+  }
+
+  bool ready() const { return (status_.load(std::memory_order_acquire) & kReady) != 0; }
+
+  // 先自旋，再让出cpu，最后阻塞在 atomic::wait(linux下即futex) 上
+  void wait() {
+    for (int i = 0; i < kSpinCount; i++) {
+      if (ready()) return;
+      wait_strategy::CpuRelax();
+    }
+    for (int i = 0; i < kYieldCount; i++) {
+      if (ready()) return;
+      std::this_thread::yield();
+    }
+    std::uint32_t status = status_.load(std::memory_order_acquire);
+    while ((status & kReady) == 0) {
+      if ((status & kWaiting) == 0 &&
+          !status_.compare_exchange_weak(status, status | kWaiting, std::memory_order_acq_rel,
+                                         std::memory_order_acquire)) {
+        continue;
+      }
+      status_.wait(status | kWaiting, std::memory_order_acquire);
+      status = status_.load(std::memory_order_acquire);
+    }
+  }
+
+  /**
+   * @brief 注册完成回调，可以注册多个(例如 when_any 之后还可以对其余的输入调用 then)；
+   * 回调在写入结果的线程上执行，应该尽快返回(例如只是提交任务)
+   *
+   * @return false 已经完成，回调没有被保存，由调用方自己执行
+   */
+  bool setCallback(FutureCallback* callback) {
+    FutureCallback* head = callbacks_.load(std::memory_order_acquire);
+    do {
+      if (head == &kCallbacksDone) {
+        return false;
+      }
+      callback->next = head;
+    } while (!callbacks_.compare_exchange_weak(head, callback, std::memory_order_acq_rel,
+                                               std::memory_order_acquire));
+    return true;
+  }
+
+  SlabAllocator* slab() const { return slab_; }
+
+  template <class... U>
+  void setValue(U&&... value) {
+    storage_.set(std::forward<U>(value)...);
+    complete();
+  }
+
+  void setException(std::exception_ptr error) {
+    error_ = std::move(error);
+    complete();
+  }
+
+  T take() {
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+    return storage_.take();
+  }
+
+  private:
+  SharedState(SlabAllocator* slab, std::uint32_t index)
+      : slab_(slab),
+        index_(index) {}
+
+  ~SharedState() = default;
+
+  void complete() {
+    std::uint32_t status = status_.exchange(kReady, std::memory_order_acq_rel);
+    if (status & kWaiting) {
+      status_.notify_all();
+    }
+    // promise 在回调返回之后才释放引用，回调中共享状态一直有效
+    FutureCallback* callback = callbacks_.exchange(&kCallbacksDone, std::memory_order_acq_rel);
+    while (callback != nullptr) {
+      // 回调执行之后注册方可能已经释放了存储，先取出下一个
+      FutureCallback* next = callback->next;
+      callback->fn(callback->arg);
+      callback = next;
+    }
+  }
+
+  private:
+  static constexpr int kSpinCount = 64;
+  static constexpr int kYieldCount = 16;
+
+  std::atomic<std::uint32_t> status_ = {kPending};
+  std::atomic<std::uint32_t> refs_ = {2};
+  SlabAllocator* slab_;
+  std::uint32_t index_;
+  std::atomic<FutureCallback*> callbacks_ = {nullptr};
+  std::exception_ptr error_;
+  ValueStorage<T> storage_;
+};
+
+struct FutureAccess;
+template <class Executor, class T, class F>
+class ThenNode;
+}  // namespace detail
+
+template <class T>
+class TaskPromise;
+
+/**
+ * @brief 线程池专用的 future，接口和 std::future 保持一致
+ */
+template <class T>
+class TaskFuture {
+  static_assert(!std::is_reference_v<T>, "TaskFuture does not support reference results");
+
+  public:
+  TaskFuture() = default;
+
+  TaskFuture(TaskFuture&& other) noexcept
+      : state_(std::exchange(other.state_, nullptr)) {}
+
+  TaskFuture& operator=(TaskFuture&& other) noexcept {
+    if (this == &other) return *this;
+    reset();
+    state_ = std::exchange(other.state_, nullptr);
+    return *this;
+  }
+
+  // non-copy
+  TaskFuture(const TaskFuture&) = delete;
+  TaskFuture& operator=(const TaskFuture&) = delete;
+
+  ~TaskFuture() { reset(); }
+
+  bool valid() const noexcept { return state_ != nullptr; }
+
+  bool is_ready() const {
+    checkState();
+    return state_->ready();
+  }
+
+  void wait() const {
+    checkState();
+    state_->wait();
+  }
+
+  // 和 std::future 一样，get 之后 future 不再有效
+  T get() {
+    checkState();
+    state_->wait();
+    struct Guard {
+      detail::SharedState<T>* state;
+      ~Guard() { state->release(); }
+    } guard{std::exchange(state_, nullptr)};
+    return guard.state->take();
+  }
+
+  /**
+   * @brief 前一个任务完成时把 f 提交到 executor(例如 ThreadPool)，等待期间不占用任何线程
+   * f 可以接收前一个任务的结果(前一个任务抛出异常时 f 不执行，异常直接传给返回的 future)，
+   * 也可以接收已经完成的 TaskFuture<T> 自行处理异常(需要据此区分，f 的参数不能是 auto)；
+   * 和 get 一样，调用之后 future 不再有效
+   *
+   * @param executor 需要提供 post(UniqueFunction<void()>)，在 f 执行之前必须一直有效
+   */
+  template <class Executor, class F>
+  auto then(Executor& executor, F&& f)
+      -> TaskFuture<typename detail::ThenNode<Executor, T, std::decay_t<F>>::result_type> {
+    checkState();
+    using Node = detail::ThenNode<Executor, T, std::decay_t<F>>;
+    auto* node = new Node(executor, std::move(*this), std::forward<F>(f));
+    auto result = node->get_future();
+    Node::attach(node);
+    return result;
+  }
+
+  private:
+  friend class TaskPromise<T>;
+  friend struct detail::FutureAccess;
+
+  explicit TaskFuture(detail::SharedState<T>* state)
+      : state_(state) {}
+
+  void checkState() const {
+    if (state_ == nullptr) [[unlikely]]
+      throw std::future_error(std::future_errc::no_state);
+  }
+
+  void reset() {
+    if (state_ != nullptr) {
+      state_->release();
+      state_ = nullptr;
+    }
+  }
+
+  private:
+  detail::SharedState<T>* state_ = nullptr;
+};
+
+/**
+ * @brief 由任务持有，任务执行完毕后写入结果；
+ * 任务没有执行就被销毁时，future 会得到 broken_promise 异常
+ */
+template <class T>
+class TaskPromise {
+  public:
+  explicit TaskPromise(SlabAllocator* slab = nullptr)
+      : state_(detail::SharedState<T>::create(slab)) {}
+
+  TaskPromise(TaskPromise&& other) noexcept
+      : state_(std::exchange(other.state_, nullptr)),
+        retrieved_(other.retrieved_) {}
+
+  TaskPromise& operator=(TaskPromise&& other) noexcept {
+    if (this == &other) return *this;
+    abandon();
+    state_ = std::exchange(other.state_, nullptr);
+    retrieved_ = other.retrieved_;
+    return *this;
+  }
+
+  // non-copy
+  TaskPromise(const TaskPromise&) = delete;
+  TaskPromise& operator=(const TaskPromise&) = delete;
+
+  ~TaskPromise() { abandon(); }
+
+  TaskFuture<T> get_future() {
+    if (state_ == nullptr) [[unlikely]]
+      throw std::future_error(std::future_errc::no_state);
+    if (retrieved_) [[unlikely]]
+      throw std::future_error(std::future_errc::future_already_retrieved);
+    retrieved_ = true;
+    return TaskFuture<T>(state_);
+  }
+
+  template <class... U>
+  void set_value(U&&... value) {
+    checkState();
+    state_->setValue(std::forward<U>(value)...);
+    std::exchange(state_, nullptr)->release();
+  }
+
+  void set_exception(std::exception_ptr error) {
+    checkState();
+    state_->setException(std::move(error));
+    std::exchange(state_, nullptr)->release();
+  }
+
+  // 执行 f 并把返回值或者异常写入共享状态
+  template <class F, class... Args>
+  void run(F& f, Args&... args) {
+    try {
+      if constexpr (std::is_void_v<T>) {
+        std::invoke(f, args...);
+        set_value();
+      } else {
+        set_value(std::invoke(f, args...));
+      }
+    } catch (...) {
+      set_exception(std::current_exception());
+    }
+  }
+
+  private:
+  void checkState() const {
+    if (state_ == nullptr) [[unlikely]]
+      throw std::future_error(std::future_errc::promise_already_satisfied);
+  }
+
+  void abandon() {
+    if (state_ == nullptr) {
+      return;
+    }
+    if (!retrieved_) {
+      // 没有 future，直接释放两份引用
+      state_->release();
+      state_->release();
+      state_ = nullptr;
+      return;
+    }
+    set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+  }
+
+  private:
+  detail::SharedState<T>* state_ = nullptr;
+  bool retrieved_ = false;
+};
+
+namespace detail {
+// when_all、when_any 和 then 需要直接在共享状态上注册回调
+struct FutureAccess {
+  template <class T>
+  static SharedState<T>* state(const TaskFuture<T>& future) {
+    future.checkState();
+    return future.state_;
+  }
+};
+
+/**
+ * @brief then 的续体，前一个 future 完成时提交到 executor，执行完之后自己删除
+ */
+template <class Executor, class T, class F>
+class ThenNode {
+  static constexpr bool kTakesFuture = std::is_invocable_v<F&, TaskFuture<T>>;
+
+  template <class U>
+  struct ValueResult {
+    using type = std::invoke_result_t<F&, U>;
+  };
+
+  template <class U>
+    requires std::is_void_v<U>
+  struct ValueResult<U> {
+    using type = std::invoke_result_t<F&>;
+  };
+
+  public:
+  using result_type = typename std::conditional_t<kTakesFuture,
+                                                  std::invoke_result<F&, TaskFuture<T>>,
+                                                  ValueResult<T>>::type;
+
+  template <class Fn>
+  ThenNode(Executor& executor, TaskFuture<T>&& antecedent, Fn&& f)
+      : executor_(executor),
+        promise_(FutureAccess::state(antecedent)->slab()),
+        antecedent_(std::move(antecedent)),
+        f_(std::forward<Fn>(f)) {}
+
+  TaskFuture<result_type> get_future() { return promise_.get_future(); }
+
+  static void attach(ThenNode* node) {
+    if (!FutureAccess::state(node->antecedent_)->setCallback(&node->callback_)) {
+      schedule(node);
+    }
+  }
+
+  private:
+  // 在完成前一个任务的线程上调用，这个线程通常是工作线程。executor 提供 post_or_help 时(ThreadPool)
+  // 工作线程遇到满的队列不阻塞，而是帮忙执行排队中的任务直到续体入队，所有工作线程都在提交也不会死锁
+  static void schedule(void* arg) {
+    auto* node = static_cast<ThenNode*>(arg);
+    auto task = [node]() {
+      node->run();
+      delete node;
+    };
+    if constexpr (requires { node->executor_.post_or_help(std::move(task)); }) {
+      node->executor_.post_or_help(std::move(task));
+    } else {
+      node->executor_.post(std::move(task));
+    }
+  }
+
+  void run() {
+    auto call = [this]() -> result_type {
+      if constexpr (kTakesFuture) {
+        return std::invoke(f_, std::move(antecedent_));
+      } else if constexpr (std::is_void_v<T>) {
+        antecedent_.get();
+        return std::invoke(f_);
+      } else {
+        return std::invoke(f_, antecedent_.get());
+      }
+    };
+    promise_.run(call);
+  }
+
+  private:
+  Executor& executor_;
+  FutureCallback callback_{&ThenNode::schedule, this};
+  TaskPromise<result_type> promise_;
+  TaskFuture<T> antecedent_;
+  F f_;
+};
+
+// 对 vector 或者 tuple 中的每个 future 调用 fn(index, future)
+template <class T, class Fn>
+void forEachFuture(std::vector<TaskFuture<T>>& futures, Fn&& fn) {
+  for (std::size_t i = 0; i < futures.size(); i++) {
+    fn(i, futures[i]);
+  }
+}
+
+template <class... Ts, class Fn>
+void forEachFuture(std::tuple<TaskFuture<Ts>...>& futures, Fn&& fn) {
+  [&]<std::size_t... I>(std::index_sequence<I...>) {
+    (fn(I, std::get<I>(futures)), ...);
+  }(std::index_sequence_for<Ts...>{});
+}
+
+template <class T>
+std::size_t futureCount(const std::vector<TaskFuture<T>>& futures) {
+  return futures.size();
+}
+
+template <class... Ts>
+std::size_t futureCount(const std::tuple<TaskFuture<Ts>...>&) {
+  return sizeof...(Ts);
+}
+}  // namespace detail
+
+/**
+ * @brief when_any 的结果，index 是最先完成的 future 的下标，没有输入时为 SIZE_MAX
+ */
+template <class Sequence>
+struct WhenAnyResult {
+  std::size_t index;
+  Sequence futures;
+};
+
+namespace detail {
+/**
+ * @brief when_all 和 when_any 的共享状态
+ * 每个输入的 future 上注册一个回调，回调只修改原子计数，不阻塞任何线程；
+ * 所有回调都执行之后(每个 promise 最终一定会完成)节点自己删除。
+ * 注册期间回调可能已经在其他线程上执行，计数器多出的一份属于注册的线程，保证注册完成之前不会发布结果
+ */
+template <class Sequence, bool Any>
+class WhenNode {
+  using Result = std::conditional_t<Any, WhenAnyResult<Sequence>, Sequence>;
+
+  struct Slot {
+    WhenNode* node;
+    std::size_t index;
+    FutureCallback callback;
+  };
+
+  public:
+  explicit WhenNode(Sequence&& futures)
+      : futures_(std::move(futures)),
+        slots_(futureCount(futures_)),
+        refs_(slots_.size() + 1),
+        gate_(Any && !slots_.empty() ? 2 : slots_.size() + 1) {}
+
+  static TaskFuture<Result> attach(WhenNode* node) {
+    TaskFuture<Result> result = node->promise_.get_future();
+    forEachFuture(node->futures_, [node](std::size_t index, auto& future) {
+      Slot& slot = node->slots_[index];
+      slot = Slot{node, index, FutureCallback{&WhenNode::ready, &slot}};
+      if (!FutureAccess::state(future)->setCallback(&slot.callback)) {
+        ready(&slot);
+      }
+    });
+    node->arrive();
+    node->release();
+    return result;
+  }
+
+  private:
+  static void ready(void* arg) {
+    auto* slot = static_cast<Slot*>(arg);
+    WhenNode* node = slot->node;
+    if constexpr (Any) {
+      std::size_t expected = SIZE_MAX;
+      if (node->first_.compare_exchange_strong(expected, slot->index, std::memory_order_acq_rel)) {
+        node->arrive();
+      }
+    } else {
+      node->arrive();
+    }
+    node->release();
+  }
+
+  // when_all 在所有输入完成且注册结束时发布，when_any 在第一个输入完成且注册结束时发布
+  void arrive() {
+    if (gate_.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+      return;
+    }
+    if constexpr (Any) {
+      promise_.set_value(
+          Result{first_.load(std::memory_order_acquire), std::move(futures_)});
+    } else {
+      promise_.set_value(std::move(futures_));
+    }
+  }
+
+  void release() {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  private:
+  Sequence futures_;
+  std::vector<Slot> slots_;
+  std::atomic<std::size_t> refs_;
+  std::atomic<std::size_t> gate_;
+  std::atomic<std::size_t> first_ = {SIZE_MAX};
+  TaskPromise<Result> promise_;
+};
+}  // namespace detail
+
+/**
+ * @brief 所有输入完成时完成，结果是已经完成的输入(可以逐个 get 得到值或者异常)
+ * 输入被移走，没有输入时立即完成
+ */
+template <class T>
+TaskFuture<std::vector<TaskFuture<T>>> when_all(std::vector<TaskFuture<T>> futures) {
+  using Node = detail::WhenNode<std::vector<TaskFuture<T>>, false>;
+  return Node::attach(new Node(std::move(futures)));
+}
+
+template <class... Ts>
+TaskFuture<std::tuple<TaskFuture<Ts>...>> when_all(TaskFuture<Ts>... futures) {
+  using Node = detail::WhenNode<std::tuple<TaskFuture<Ts>...>, false>;
+  return Node::attach(new Node(std::tuple<TaskFuture<Ts>...>(std::move(futures)...)));
+}
+
+/**
+ * @brief 任意一个输入完成时完成，其他输入仍然在结果中，可以继续等待
+ */
+template <class T>
+TaskFuture<WhenAnyResult<std::vector<TaskFuture<T>>>> when_any(
+    std::vector<TaskFuture<T>> futures) {
+  using Node = detail::WhenNode<std::vector<TaskFuture<T>>, true>;
+  return Node::attach(new Node(std::move(futures)));
+}
+
+template <class... Ts>
+TaskFuture<WhenAnyResult<std::tuple<TaskFuture<Ts>...>>> when_any(TaskFuture<Ts>... futures) {
+  using Node = detail::WhenNode<std::tuple<TaskFuture<Ts>...>, true>;
+  return Node::attach(new Node(std::tuple<TaskFuture<Ts>...>(std::move(futures)...)));
+}
+
+}  // namespace threadpool
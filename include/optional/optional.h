@@ -364,7 +364,7 @@ class Optional {
     }
   }
 
-  template <class F, std::enable_if_t<std::is_copy_constructible_v<T>, int> = 0>
+  template <class F, class U = T, std::enable_if_t<std::is_copy_constructible_v<U>, int> = 0>
   Optional or_else(F&& f) const& {
     if (m_has_value) {
       return *this;
@@ -373,7 +373,7 @@ class Optional {
     }
   }
 
-  template <class F, std::enable_if_t<std::is_move_constructible_v<T>, int> = 0>
+  template <class F, class U = T, std::enable_if_t<std::is_move_constructible_v<U>, int> = 0>
   Optional or_else(F&& f) && {
     if (m_has_value) {
       return std::move(*this);
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+#include "wait_strategy.h"
+
+/**
+ * @brief 事件计数(eventcount)，低32位是已登记的等待者数量，高32位是通知的轮次
+ * 等待方先登记再做最后一次检查，通知方发布数据之后只有看到等待者时才调用等待策略唤醒，
+ * 没有线程等待时一次通知只是一个屏障加一次读，不会进入等待策略。
+ * 真正的阻塞和唤醒仍然交给等待策略，这里只负责判断是否需要唤醒。
+ */
+class EventCount {
+  public:
+  /**
+   * @brief 登记为等待者，之后必须调用 CancelWait 撤销登记
+   *
+   * @return std::uint32_t 登记时的轮次，配合 Notified 判断期间是否有过通知
+   */
+  std::uint32_t PrepareWait() {
+    std::uint64_t state = state_.fetch_add(kWaiter, std::memory_order_seq_cst);
+    // 和 Notify 中的屏障配对：要么通知方看到登记，要么登记之后的检查能看到新数据
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return static_cast<std::uint32_t>(state >> kEpochShift);
+  }
+
+  void CancelWait() { state_.fetch_sub(kWaiter, std::memory_order_relaxed); }
+
+  // 登记之后是否已经有过通知，有的话不必进入等待策略
+  bool Notified(std::uint32_t epoch) const {
+    return static_cast<std::uint32_t>(state_.load(std::memory_order_acquire) >> kEpochShift) !=
+           epoch;
+  }
+
+  /**
+   * @brief 发布数据之后调用，最多唤醒count个等待者
+   *
+   * @return std::uint64_t 实际调用等待策略唤醒的次数
+   */
+  std::uint64_t Notify(wait_strategy::WaitStrategy* wait_strategy, std::uint64_t count = 1) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::uint64_t waiters = state_.load(std::memory_order_relaxed) & kWaiterMask;
+    if (waiters == 0) [[likely]] {
+      return 0;
+    }
+    std::uint64_t n = std::min(count, waiters);
+    state_.fetch_add(kEpoch, std::memory_order_release);
+    for (std::uint64_t i = 0; i < n; i++) {
+      wait_strategy->NotifyOne();
+    }
+    notified_.fetch_add(n, std::memory_order_relaxed);
+    return n;
+  }
+
+  // 累计调用等待策略唤醒的次数
+  std::uint64_t notified() const { return notified_.load(std::memory_order_relaxed); }
+
+  private:
+  static constexpr std::uint64_t kWaiter = 1;
+  static constexpr std::uint64_t kWaiterMask = (1ULL << 32) - 1;
+  static constexpr std::uint64_t kEpochShift = 32;
+  static constexpr std::uint64_t kEpoch = 1ULL << kEpochShift;
+
+  std::atomic<std::uint64_t> state_ = {0};
+  std::atomic<std::uint64_t> notified_ = {0};
+};
@@ -1,25 +1,80 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <bit>
 #include <cstdint>
 #include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
 
+#include "event_count.h"
 #include "wait_strategy.h"
 
+/**
+ * @brief 有界无锁多生产者多消费者队列
+ * 每个槽位带有一个序号(Vyukov)：序号等于位置时槽位可写，等于位置+1时槽位可读，
+ * 读出后序号增加一圈。生产者和消费者只在自己占到的槽位上同步，
+ * 某个线程在占位后被调度出去，只会阻塞这一个槽位，而不会阻塞整个环。
+ * 元素在占位之后才在槽位中构造，出队时移出并立即析构，不要求T可以默认构造。
+ * 入队和出队之后通过事件计数通知等待方，没有线程在等待时不会调用等待策略。
+ */
 template <typename T>
 class BoundedQueue {
+  // 占位之后无法撤销，移动构造抛出异常会导致槽位永远无法发布
+  static_assert(std::is_nothrow_move_constructible_v<T>,
+                "BoundedQueue requires nothrow move constructible T");
+
   public:
   BoundedQueue() = default;
   ~BoundedQueue();
   BoundedQueue(const BoundedQueue&) = delete;
   BoundedQueue& operator=(const BoundedQueue&) = delete;
 
+  /**
+   * @brief 初始化队列
+   *
+   * @param cap 容量
+   * @param wait_strategy 等待策略，队列负责释放
+   * @param power_of_two 容量向上取整为2的幂，下标用掩码计算，避免每次操作都做64位除法
+   * @return false 容量为0或者内存申请失败
+   */
   bool Init(std::uint64_t cap,
-            wait_strategy::WaitStrategy* wait_strategy = new wait_strategy::TimeoutBlockStrategy());
+            wait_strategy::WaitStrategy* wait_strategy = new wait_strategy::TimeoutBlockStrategy(),
+            bool power_of_two = false);
 
   bool enqueue(const T& item);
+  bool enqueue(T&& item);
+
+  /**
+   * @brief 在槽位中直接构造元素
+   * 构造函数可能抛出异常时，会先在槽位之外构造再移动进去，此时即使入队失败参数也可能已经被移走
+   */
+  template <typename... Args>
+  bool emplace(Args&&... args);
+
+  // 元素移动到item之后，槽位中的对象立即析构，及时释放其持有的资源
   bool dequeue(T* item);
 
+  /**
+   * @brief 批量入队，一次CAS占用多个连续的空槽位
+   *
+   * @param items 待入队的元素，入队成功的元素会被移走
+   * @param count 元素个数
+   * @return std::uint64_t 实际入队的个数(前缀)，队列剩余空间不足时可能小于count
+   */
+  std::uint64_t enqueue_bulk(T* items, std::uint64_t count);
+
+  /**
+   * @brief 批量出队，一次CAS取走多个元素
+   *
+   * @param items 输出缓冲区，至少能容纳max_count个元素
+   * @param max_count 最多取出的个数
+   * @return std::uint64_t 实际取出的个数，队列为空时返回0
+   */
+  std::uint64_t dequeue_bulk(T* items, std::uint64_t max_count);
+
   /**
    * @brief 队列满时，按照策略等待
    *
@@ -28,6 +83,7 @@ class BoundedQueue {
    * @return false
    */
   bool wait_enqueue(const T& item);
+  bool wait_enqueue(T&& item);
 
   /**
    * @brief 队列空时，按照策略等待
@@ -42,15 +98,45 @@ class BoundedQueue {
   void BreakAllWait();
 
   public:
-  std::uint64_t size() { return tail_ - head_ - 1; }
+  std::uint64_t size() {
+    // 先读head_，保证读到的tail_不小于head_
+    std::uint64_t head = head_.load(std::memory_order_acquire);
+    return tail_.load(std::memory_order_acquire) - head;
+  }
 
   bool empty() { return size() == 0; }
 
+  std::uint64_t capacity() const { return capacity_; }
+
+  // 实际调用等待策略唤醒的次数
+  std::uint64_t notified_wakeups() const { return event_count_.notified(); }
+
+  // 每个入队和出队的元素都是一次通知的机会，没有等待者而省掉的唤醒次数
+  std::uint64_t avoided_wakeups() {
+    std::uint64_t head = head_.load(std::memory_order_acquire);
+    std::uint64_t tail = tail_.load(std::memory_order_acquire);
+    return head + tail - event_count_.notified();
+  }
+
   void set_waitStrategy(wait_strategy::WaitStrategy* wait_strategy) {
     wait_strategy_.reset(wait_strategy);
   }
 
   private:
+  struct Slot {
+    std::atomic<std::uint64_t> seq;
+    // 只有序号等于位置+1时才存放着有效的元素
+    alignas(T) unsigned char storage[sizeof(T)];
+
+    T* get() { return std::launder(reinterpret_cast<T*>(storage)); }
+  };
+
+  template <typename... Args>
+  bool enqueue_impl(Args&&... args);
+
+  template <typename U>
+  bool wait_enqueue_impl(U&& item);
+
   // 获取下标
   std::uint64_t get_index(std::uint64_t);
 
@@ -58,26 +144,32 @@ class BoundedQueue {
 
   std::uint64_t get_tail() { return tail_.load(); }
 
-  std::uint64_t get_max_head() { return max_head_.load(); }
-
   private:
 // 指定内存对齐方式, 可提高代码性能和效率
 #define CACHELINE_SIZE 64
-  alignas(CACHELINE_SIZE) std::atomic<std::uint64_t> head_ = {0};
-  alignas(CACHELINE_SIZE) std::atomic<std::uint64_t> tail_ = {1};
-  alignas(CACHELINE_SIZE) std::atomic<std::uint64_t> max_head_ = {1};  // 最大的head, tail的备份
+  alignas(CACHELINE_SIZE) std::atomic<std::uint64_t> head_ = {0};  // 下一个出队的位置
+  alignas(CACHELINE_SIZE) std::atomic<std::uint64_t> tail_ = {0};  // 下一个入队的位置
+  // 每次操作都要读，和head_/tail_分开避免伪共享
+  alignas(CACHELINE_SIZE) EventCount event_count_;
 #undef CACHELINE_SIZE
 
-  T* pool_ = nullptr;
+  Slot* pool_ = nullptr;
 
-  std::atomic<std::uint64_t> size_ = 0;
+  // 只在Init中写入，之后只读，不需要原子变量
+  std::uint64_t capacity_ = 0;
+  // 槽位数，至少为2：只有一个槽位时写入的序号 pos + 1 正好等于下一圈可写的序号，会覆盖还没取走的元素
+  std::uint64_t slots_ = 0;
+  std::uint64_t mask_ = 0;  // 槽位数是2的幂时为slots_ - 1，否则为0
   std::unique_ptr<wait_strategy::WaitStrategy> wait_strategy_ = nullptr;
   std::atomic<bool> break_all_wait_ = false;
 };
 
 template <typename T>
 inline std::uint64_t BoundedQueue<T>::get_index(std::uint64_t num) {
-  return num - (num / size_) * size_;
+  if (mask_ != 0) [[likely]] {
+    return num & mask_;
+  }
+  return num % slots_;
 }
 
 template <typename T>
@@ -90,22 +182,40 @@ template <typename T>
 BoundedQueue<T>::~BoundedQueue() {
   BreakAllWait();
   if (pool_) {
-    for (std::uint64_t i = 0; i < size_; i++) {
-      pool_[i].~T();
+    // 析构还留在队列中的元素
+    std::uint64_t tail = tail_.load(std::memory_order_acquire);
+    for (std::uint64_t pos = head_.load(std::memory_order_acquire); pos != tail; pos++) {
+      Slot& slot = pool_[get_index(pos)];
+      if (slot.seq.load(std::memory_order_acquire) == pos + 1) {
+        slot.get()->~T();
+      }
+    }
+    for (std::uint64_t i = 0; i < slots_; i++) {
+      pool_[i].~Slot();
     }
     std::free(pool_);
   }
 }
 
 template <typename T>
-bool BoundedQueue<T>::Init(std::uint64_t cap, wait_strategy::WaitStrategy* wait_strategy) {
-  size_ = cap + 2;
-  pool_ = reinterpret_cast<T*>(std::calloc(size_, sizeof(T)));
+bool BoundedQueue<T>::Init(std::uint64_t cap, wait_strategy::WaitStrategy* wait_strategy,
+                           bool power_of_two) {
+  if (cap == 0) {
+    return false;
+  }
+  if (power_of_two) {
+    cap = std::bit_ceil(cap);
+  }
+  capacity_ = cap;
+  slots_ = std::max<std::uint64_t>(cap, 2);
+  mask_ = std::has_single_bit(slots_) ? slots_ - 1 : 0;
+  pool_ = reinterpret_cast<Slot*>(std::calloc(slots_, sizeof(Slot)));
   if (pool_ == nullptr) {
     return false;
   }
-  for (std::uint64_t i = 0; i < size_; i++) {
-    new (&pool_[i]) T();
+  for (std::uint64_t i = 0; i < slots_; i++) {
+    new (&pool_[i]) Slot();
+    pool_[i].seq.store(i, std::memory_order_relaxed);
   }
   wait_strategy_.reset(wait_strategy);
   return true;
@@ -113,15 +223,40 @@ bool BoundedQueue<T>::Init(std::uint64_t cap, wait_strategy::WaitStrategy* wait_
 
 template <typename T>
 bool BoundedQueue<T>::wait_enqueue(const T& item) {
+  return wait_enqueue_impl(item);
+}
+
+template <typename T>
+bool BoundedQueue<T>::wait_enqueue(T&& item) {
+  return wait_enqueue_impl(std::move(item));
+}
+
+template <typename T>
+template <typename U>
+bool BoundedQueue<T>::wait_enqueue_impl(U&& item) {
   while (!break_all_wait_) {
-    if (enqueue(item)) {
+    // 入队失败时不会移动item，可以安全重试
+    if (enqueue(std::forward<U>(item))) {
       return true;
     }
-    // 插入失败
-    if (wait_strategy_->EmptyWait()) {
+    // 插入失败，取得序号并登记为等待者之后再尝试一次
+    std::uint32_t key = wait_strategy_->PrepareWait();
+    std::uint32_t epoch = event_count_.PrepareWait();
+    if (enqueue(std::forward<U>(item))) {
+      event_count_.CancelWait();
+      return true;
+    }
+    if (break_all_wait_ || event_count_.Notified(epoch)) {
+      event_count_.CancelWait();
       continue;
     }
-    break;
+    bool woken = wait_strategy_->CommitWait(key);
+    event_count_.CancelWait();
+    if (woken) {
+      continue;
+    }
+    // 通知可能在进入等待之前就已经发出，超时后再尝试一次
+    return enqueue(std::forward<U>(item));
   }
   return false;
 }
@@ -132,49 +267,190 @@ bool BoundedQueue<T>::wait_dequeue(T* item) {
     if (dequeue(item)) {
       return true;
     }
-    if (wait_strategy_->EmptyWait()) {
+    // 取得序号并登记为等待者之后再检查一次，之后的入队一定能看到登记
+    std::uint32_t key = wait_strategy_->PrepareWait();
+    std::uint32_t epoch = event_count_.PrepareWait();
+    if (dequeue(item)) {
+      event_count_.CancelWait();
+      return true;
+    }
+    if (break_all_wait_ || event_count_.Notified(epoch)) {
+      event_count_.CancelWait();
+      continue;
+    }
+    bool woken = wait_strategy_->CommitWait(key);
+    event_count_.CancelWait();
+    if (woken) {
       continue;
     }
-    break;
+    return dequeue(item);
   }
   return false;
 }
 
 template <typename T>
 bool BoundedQueue<T>::enqueue(const T& item) {
-  std::uint64_t new_tail = 0;
-  std::uint64_t old_tail = tail_.load(std::memory_order_acquire);  // 获取旧值
-  do {
-    new_tail = old_tail + 1;
-    if (get_index(new_tail) == get_index(head_.load(std::memory_order_acquire))) {
-      return false;  // 队列满
-    }
-  } while (!tail_.compare_exchange_weak(old_tail, new_tail, std::memory_order_acq_rel,
-                                        std::memory_order_relaxed));
-
-  pool_[get_index(old_tail)] = item;
-
-  do {
-  } while (!max_head_.compare_exchange_weak(old_tail, new_tail, std::memory_order_acq_rel,
-                                            std::memory_order_relaxed));
-  wait_strategy_->NotifyOne();
+  return emplace(item);
+}
+
+template <typename T>
+bool BoundedQueue<T>::enqueue(T&& item) {
+  return enqueue_impl(std::move(item));
+}
+
+template <typename T>
+template <typename... Args>
+bool BoundedQueue<T>::emplace(Args&&... args) {
+  if constexpr (std::is_nothrow_constructible_v<T, Args&&...>) {
+    return enqueue_impl(std::forward<Args>(args)...);
+  } else {
+    return enqueue_impl(T(std::forward<Args>(args)...));
+  }
+}
+
+template <typename T>
+template <typename... Args>
+bool BoundedQueue<T>::enqueue_impl(Args&&... args) {
+  std::uint64_t pos = tail_.load(std::memory_order_relaxed);
+  Slot* slot = nullptr;
+  while (true) {
+    slot = &pool_[get_index(pos)];
+    std::uint64_t seq = slot->seq.load(std::memory_order_acquire);
+    auto diff = static_cast<std::int64_t>(seq - pos);
+    if (diff == 0) {
+      // 槽位比容量多时(容量为1)另外检查元素个数；槽位可写说明pos还没有入队，head_不会超过pos
+      if (capacity_ < slots_ && pos - head_.load(std::memory_order_acquire) >= capacity_) {
+        return false;
+      }
+      // 槽位可写，占位
+      if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed,
+                                      std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false;  // 队列满，上一圈的元素还没有被取走
+    } else {
+      pos = tail_.load(std::memory_order_relaxed);  // 被其他生产者抢先
+    }
+  }
+
+  ::new (static_cast<void*>(slot->storage)) T(std::forward<Args>(args)...);
+  slot->seq.store(pos + 1, std::memory_order_release);
+  event_count_.Notify(wait_strategy_.get());
   return true;
 }
 
 template <typename T>
 bool BoundedQueue<T>::dequeue(T* item) {
-  std::uint64_t new_head = 0;
-  std::uint64_t old_head = head_.load(std::memory_order_acquire);
-  do {
-    new_head = old_head + 1;
-    // 是否在最大出队的下标之前，不用tail_，因为tail_可能会和入队操作冲突，
-    // 也就是申请了空间但是元素还没正式插入
-    if (new_head == max_head_.load(std::memory_order_acquire)) {
-      return false;
-    }
-    *item = pool_[get_index(new_head)];
-  } while (!head_.compare_exchange_weak(old_head, new_head, std::memory_order_acq_rel,
-                                        std::memory_order_relaxed));
-  wait_strategy_->NotifyOne();
+  std::uint64_t pos = head_.load(std::memory_order_relaxed);
+  Slot* slot = nullptr;
+  while (true) {
+    slot = &pool_[get_index(pos)];
+    std::uint64_t seq = slot->seq.load(std::memory_order_acquire);
+    auto diff = static_cast<std::int64_t>(seq - (pos + 1));
+    if (diff == 0) {
+      // 槽位可读，占位
+      if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed,
+                                      std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false;  // 队列空，或者生产者占位之后还没有写完
+    } else {
+      pos = head_.load(std::memory_order_relaxed);
+    }
+  }
+
+  // 占位成功后再移出元素，序号增加一圈之前该槽位不会被生产者覆盖
+  T* value = slot->get();
+  *item = std::move(*value);
+  value->~T();
+  slot->seq.store(pos + slots_, std::memory_order_release);
+  event_count_.Notify(wait_strategy_.get());
   return true;
 }
+
+template <typename T>
+std::uint64_t BoundedQueue<T>::enqueue_bulk(T* items, std::uint64_t count) {
+  std::uint64_t n = 0;
+  std::uint64_t pos = tail_.load(std::memory_order_relaxed);
+  while (true) {
+    // 从pos开始数连续可写的槽位，消费者可能乱序归还槽位，所以不能只看最后一个
+    n = 0;
+    while (n < count) {
+      std::uint64_t seq = pool_[get_index(pos + n)].seq.load(std::memory_order_acquire);
+      if (seq != pos + n) {
+        break;
+      }
+      n++;
+    }
+    if (n > 0 && capacity_ < slots_) {
+      std::uint64_t used = pos - head_.load(std::memory_order_acquire);
+      if (used >= capacity_) {
+        return 0;  // 队列满
+      }
+      n = std::min(n, capacity_ - used);
+    }
+    if (n == 0) {
+      std::uint64_t seq = pool_[get_index(pos)].seq.load(std::memory_order_acquire);
+      if (count == 0 || static_cast<std::int64_t>(seq - pos) < 0) {
+        return 0;  // 队列满
+      }
+      pos = tail_.load(std::memory_order_relaxed);
+      continue;
+    }
+    if (tail_.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed,
+                                    std::memory_order_relaxed)) {
+      break;
+    }
+  }
+
+  // 每个槽位各自发布，不需要等待前面的生产者
+  for (std::uint64_t i = 0; i < n; i++) {
+    Slot& slot = pool_[get_index(pos + i)];
+    ::new (static_cast<void*>(slot.storage)) T(std::move(items[i]));
+    slot.seq.store(pos + i + 1, std::memory_order_release);
+  }
+  event_count_.Notify(wait_strategy_.get(), n);
+  return n;
+}
+
+template <typename T>
+std::uint64_t BoundedQueue<T>::dequeue_bulk(T* items, std::uint64_t max_count) {
+  std::uint64_t n = 0;
+  std::uint64_t pos = head_.load(std::memory_order_relaxed);
+  while (true) {
+    // 从pos开始数连续可读的槽位，遇到还没写完的槽位就停下
+    n = 0;
+    while (n < max_count) {
+      std::uint64_t seq = pool_[get_index(pos + n)].seq.load(std::memory_order_acquire);
+      if (seq != pos + n + 1) {
+        break;
+      }
+      n++;
+    }
+    if (n == 0) {
+      std::uint64_t seq = pool_[get_index(pos)].seq.load(std::memory_order_acquire);
+      if (max_count == 0 || static_cast<std::int64_t>(seq - (pos + 1)) < 0) {
+        return 0;  // 队列空
+      }
+      pos = head_.load(std::memory_order_relaxed);
+      continue;
+    }
+    if (head_.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed,
+                                    std::memory_order_relaxed)) {
+      break;
+    }
+  }
+
+  for (std::uint64_t i = 0; i < n; i++) {
+    Slot& slot = pool_[get_index(pos + i)];
+    T* value = slot.get();
+    items[i] = std::move(*value);
+    value->~T();
+    slot.seq.store(pos + i + slots_, std::memory_order_release);
+  }
+  // 空出了n个槽位，最多可以让n个生产者继续
+  event_count_.Notify(wait_strategy_.get(), n);
+  return n;
+}
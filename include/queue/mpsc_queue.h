@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+
+/**
+ * @brief 侵入式节点，放入 MpscQueue 的对象需要继承它
+ */
+struct MpscNode {
+  std::atomic<MpscNode*> next = {nullptr};
+};
+
+/**
+ * @brief 侵入式的多生产者单消费者无锁队列(Vyukov)
+ * push 只有一次原子交换，不会失败也不分配内存；pop 只能由一个线程调用。
+ * 生产者在交换 head 和链接 next 之间被打断时，后面的节点暂时不可见，pop 会返回 nullptr，
+ * 调用方如果另外知道队列非空(例如有计数)，重试即可。
+ * 队列不拥有节点，节点的分配和释放由调用方负责。
+ */
+class MpscQueue {
+  public:
+  MpscQueue()
+      : head_(&stub_),
+        tail_(&stub_) {}
+  // non-copy
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  // 任意线程调用
+  void push(MpscNode* node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    MpscNode* prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  // 仅消费者线程调用，队列为空或者下一个节点还没有链接上时返回 nullptr
+  MpscNode* pop() {
+    MpscNode* tail = tail_;
+    MpscNode* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &stub_) {
+      if (next == nullptr) {
+        return nullptr;
+      }
+      tail_ = next;
+      tail = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+    if (next != nullptr) {
+      tail_ = next;
+      return tail;
+    }
+    if (tail != head_.load(std::memory_order_acquire)) {
+      // 有生产者正在链接
+      return nullptr;
+    }
+    // tail 是最后一个节点，放回哨兵之后才能把它取出
+    push(&stub_);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next != nullptr) {
+      tail_ = next;
+      return tail;
+    }
+    return nullptr;
+  }
+
+  // 仅消费者线程调用，结果只是一个近似值
+  bool empty() const {
+    return tail_ == &stub_ && stub_.next.load(std::memory_order_acquire) == nullptr;
+  }
+
+  private:
+  // 不按缓存行对齐，每个 strand/actor 都有一个队列，空闲时只占三个指针
+  std::atomic<MpscNode*> head_;  // 生产者一侧
+  MpscNode* tail_;               // 消费者一侧
+  MpscNode stub_;
+};
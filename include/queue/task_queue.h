@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "lockfree_queue.h"
+#include "unbounded_queue.h"
+#include "wait_strategy.h"
+
+/**
+ * @brief 线程池的任务队列，在有界队列和无界队列之间二选一
+ * 初始化之后不再切换，每次操作只多一次可预测的分支
+ */
+template <typename T>
+class TaskQueue {
+  public:
+  TaskQueue() = default;
+  TaskQueue(const TaskQueue&) = delete;
+  TaskQueue& operator=(const TaskQueue&) = delete;
+
+  bool InitBounded(std::uint64_t cap, wait_strategy::WaitStrategy* wait_strategy,
+                   bool power_of_two = false) {
+    unbounded_.reset();
+    bounded_ = std::make_unique<BoundedQueue<T>>();
+    return bounded_->Init(cap, wait_strategy, power_of_two);
+  }
+
+  bool InitUnbounded(wait_strategy::WaitStrategy* wait_strategy) {
+    bounded_.reset();
+    unbounded_ = std::make_unique<UnboundedQueue<T>>();
+    return unbounded_->Init(wait_strategy);
+  }
+
+  // 无界队列入队总是成功，提交方不需要按阈值等待
+  bool bounded() const { return bounded_ != nullptr; }
+
+  bool enqueue(T&& item) {
+    return bounded_ ? bounded_->enqueue(std::move(item)) : unbounded_->enqueue(std::move(item));
+  }
+
+  bool dequeue(T* item) { return bounded_ ? bounded_->dequeue(item) : unbounded_->dequeue(item); }
+
+  std::uint64_t enqueue_bulk(T* items, std::uint64_t count) {
+    return bounded_ ? bounded_->enqueue_bulk(items, count) : unbounded_->enqueue_bulk(items, count);
+  }
+
+  std::uint64_t dequeue_bulk(T* items, std::uint64_t max_count) {
+    return bounded_ ? bounded_->dequeue_bulk(items, max_count)
+                    : unbounded_->dequeue_bulk(items, max_count);
+  }
+
+  bool wait_dequeue(T* item) {
+    return bounded_ ? bounded_->wait_dequeue(item) : unbounded_->wait_dequeue(item);
+  }
+
+  void BreakAllWait() { bounded_ ? bounded_->BreakAllWait() : unbounded_->BreakAllWait(); }
+
+  std::uint64_t size() { return bounded_ ? bounded_->size() : unbounded_->size(); }
+
+  bool empty() { return size() == 0; }
+
+  void set_waitStrategy(wait_strategy::WaitStrategy* wait_strategy) {
+    bounded_ ? bounded_->set_waitStrategy(wait_strategy)
+             : unbounded_->set_waitStrategy(wait_strategy);
+  }
+
+  private:
+  std::unique_ptr<BoundedQueue<T>> bounded_;
+  std::unique_ptr<UnboundedQueue<T>> unbounded_;
+};
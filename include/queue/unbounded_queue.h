@@ -0,0 +1,408 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "event_count.h"
+#include "wait_strategy.h"
+
+/**
+ * @brief 无界无锁多生产者多消费者队列
+ * 由定长的段(segment)串成链表，head_/tail_ 是全局位置，位置的低位标记是否已经有下一段。
+ * 每段比容量多一个位置作为哨兵，位置落在哨兵上说明正在切换到下一段，其余线程稍等即可。
+ * 段的回收不需要epoch或者hazard pointer：槽位带有WRITE/READ/DESTROY三个标记，
+ * 取走段中最后一个元素的消费者负责回收，遇到还没读完的槽位就把回收工作交给那个槽位的消费者。
+ * 实现参考 crossbeam 的 SegQueue。
+ */
+template <typename T, std::size_t SegmentSize = 63>
+class UnboundedQueue {
+  static_assert(SegmentSize > 0, "UnboundedQueue requires a non-empty segment");
+
+  public:
+  UnboundedQueue() = default;
+  ~UnboundedQueue();
+  UnboundedQueue(const UnboundedQueue&) = delete;
+  UnboundedQueue& operator=(const UnboundedQueue&) = delete;
+
+  bool Init(wait_strategy::WaitStrategy* wait_strategy = new wait_strategy::TimeoutBlockStrategy());
+
+  // 入队总是成功，返回值和 BoundedQueue 保持一致
+  bool enqueue(const T& item);
+  bool enqueue(T&& item);
+
+  template <typename... Args>
+  bool emplace(Args&&... args);
+
+  bool dequeue(T* item);
+
+  std::uint64_t enqueue_bulk(T* items, std::uint64_t count);
+  std::uint64_t dequeue_bulk(T* items, std::uint64_t max_count);
+
+  bool wait_enqueue(const T& item) { return enqueue(item); }
+  bool wait_enqueue(T&& item) { return enqueue(std::move(item)); }
+
+  /**
+   * @brief 队列空时，按照策略等待
+   *
+   * @param item
+   * @return true
+   * @return false
+   */
+  bool wait_dequeue(T* item);
+
+  // notify all thread to break wait
+  void BreakAllWait();
+
+  public:
+  // 并发修改时只是近似值
+  std::uint64_t size();
+
+  bool empty() { return size() == 0; }
+
+  // 当前还没有回收的段数量
+  std::int64_t segment_count() const { return segments_.load(std::memory_order_relaxed); }
+
+  // 实际调用等待策略唤醒的次数
+  std::uint64_t notified_wakeups() const { return event_count_.notified(); }
+
+  // 只有入队会通知，每个入队的元素是一次通知的机会
+  std::uint64_t avoided_wakeups() {
+    return itemIndex(tail_.load(std::memory_order_acquire)) - event_count_.notified();
+  }
+
+  void set_waitStrategy(wait_strategy::WaitStrategy* wait_strategy) {
+    wait_strategy_.reset(wait_strategy);
+  }
+
+  private:
+  enum SlotState : std::uint32_t {
+    kWrite = 1,    // 元素已经写入
+    kRead = 2,     // 元素已经被取走
+    kDestroy = 4,  // 段正在回收，读完之后由该槽位的消费者继续回收
+  };
+
+  struct Slot {
+    std::atomic<std::uint32_t> state = {0};
+    alignas(T) unsigned char storage[sizeof(T)];
+
+    T* get() { return std::launder(reinterpret_cast<T*>(storage)); }
+
+    void waitWrite() {
+      while ((state.load(std::memory_order_acquire) & kWrite) == 0) {
+        std::this_thread::yield();
+      }
+    }
+  };
+
+  struct Segment {
+    std::atomic<Segment*> next = {nullptr};
+    Slot slots[SegmentSize];
+
+    Segment* waitNext() {
+      Segment* n = nullptr;
+      while ((n = next.load(std::memory_order_acquire)) == nullptr) {
+        std::this_thread::yield();
+      }
+      return n;
+    }
+  };
+
+  static constexpr std::uint64_t kShift = 1;
+  static constexpr std::uint64_t kHasNext = 1;      // head_ 的最低位，已经存在下一段
+  static constexpr std::uint64_t kLap = SegmentSize + 1;  // 每段的位置数，最后一个是哨兵
+
+  template <typename... Args>
+  void enqueue_impl(Args&&... args);
+
+  // 位置换算成元素序号，哨兵不占元素
+  static std::uint64_t itemIndex(std::uint64_t index) {
+    std::uint64_t pos = index >> kShift;
+    std::uint64_t offset = pos % kLap;
+    return pos / kLap * SegmentSize + (offset < SegmentSize ? offset : SegmentSize);
+  }
+
+  Segment* newSegment();
+  // 从start开始回收段，遇到还没读完的槽位就交给它的消费者
+  void destroySegment(Segment* segment, std::size_t start);
+
+  private:
+#define CACHELINE_SIZE 64
+  alignas(CACHELINE_SIZE) std::atomic<std::uint64_t> head_ = {0};
+  std::atomic<Segment*> headSegment_ = {nullptr};
+  alignas(CACHELINE_SIZE) std::atomic<std::uint64_t> tail_ = {0};
+  std::atomic<Segment*> tailSegment_ = {nullptr};
+  alignas(CACHELINE_SIZE) EventCount event_count_;
+#undef CACHELINE_SIZE
+
+  std::atomic<std::int64_t> segments_ = {0};
+  std::unique_ptr<wait_strategy::WaitStrategy> wait_strategy_ = nullptr;
+  std::atomic<bool> break_all_wait_ = false;
+};
+
+template <typename T, std::size_t SegmentSize>
+UnboundedQueue<T, SegmentSize>::~UnboundedQueue() {
+  BreakAllWait();
+  std::uint64_t head = head_.load(std::memory_order_relaxed) & ~kHasNext;
+  std::uint64_t tail = tail_.load(std::memory_order_relaxed) & ~kHasNext;
+  Segment* segment = headSegment_.load(std::memory_order_relaxed);
+  // 析构还留在队列中的元素，并释放经过的段
+  while (head != tail) {
+    std::uint64_t offset = (head >> kShift) % kLap;
+    if (offset < SegmentSize) {
+      segment->slots[offset].get()->~T();
+    } else {
+      Segment* next = segment->next.load(std::memory_order_relaxed);
+      delete segment;
+      segment = next;
+    }
+    head += 1 << kShift;
+  }
+  delete segment;
+}
+
+template <typename T, std::size_t SegmentSize>
+bool UnboundedQueue<T, SegmentSize>::Init(wait_strategy::WaitStrategy* wait_strategy) {
+  wait_strategy_.reset(wait_strategy);
+  return true;
+}
+
+template <typename T, std::size_t SegmentSize>
+inline void UnboundedQueue<T, SegmentSize>::BreakAllWait() {
+  break_all_wait_ = true;
+  if (wait_strategy_) {
+    wait_strategy_->BreakAllWait();
+  }
+}
+
+template <typename T, std::size_t SegmentSize>
+typename UnboundedQueue<T, SegmentSize>::Segment* UnboundedQueue<T, SegmentSize>::newSegment() {
+  segments_.fetch_add(1, std::memory_order_relaxed);
+  return new Segment();
+}
+
+template <typename T, std::size_t SegmentSize>
+void UnboundedQueue<T, SegmentSize>::destroySegment(Segment* segment, std::size_t start) {
+  // 最后一个槽位的消费者发起回收，所以不用检查最后一个槽位
+  for (std::size_t i = start; i + 1 < SegmentSize; i++) {
+    Slot& slot = segment->slots[i];
+    if ((slot.state.load(std::memory_order_acquire) & kRead) == 0 &&
+        (slot.state.fetch_or(kDestroy, std::memory_order_acq_rel) & kRead) == 0) {
+      return;
+    }
+  }
+  segments_.fetch_sub(1, std::memory_order_relaxed);
+  delete segment;
+}
+
+template <typename T, std::size_t SegmentSize>
+bool UnboundedQueue<T, SegmentSize>::enqueue(const T& item) {
+  enqueue_impl(item);
+  return true;
+}
+
+template <typename T, std::size_t SegmentSize>
+bool UnboundedQueue<T, SegmentSize>::enqueue(T&& item) {
+  enqueue_impl(std::move(item));
+  return true;
+}
+
+template <typename T, std::size_t SegmentSize>
+template <typename... Args>
+bool UnboundedQueue<T, SegmentSize>::emplace(Args&&... args) {
+  enqueue_impl(std::forward<Args>(args)...);
+  return true;
+}
+
+template <typename T, std::size_t SegmentSize>
+template <typename... Args>
+void UnboundedQueue<T, SegmentSize>::enqueue_impl(Args&&... args) {
+  // 占位之后无法撤销，先构造好元素，写入槽位时只需要移动
+  T item(std::forward<Args>(args)...);
+  std::uint64_t tail = tail_.load(std::memory_order_acquire);
+  Segment* segment = tailSegment_.load(std::memory_order_acquire);
+  Segment* next = nullptr;  // 提前申请好的下一段
+  while (true) {
+    std::uint64_t offset = (tail >> kShift) % kLap;
+    if (offset == SegmentSize) {
+      // 其他生产者正在切换到下一段
+      std::this_thread::yield();
+      tail = tail_.load(std::memory_order_acquire);
+      segment = tailSegment_.load(std::memory_order_acquire);
+      continue;
+    }
+    // 即将占用段的最后一个槽位，在占位之前申请下一段，缩短其他生产者等待的时间
+    if (offset + 1 == SegmentSize && next == nullptr) {
+      next = newSegment();
+    }
+    if (segment == nullptr) {
+      // 第一次入队，安装第一个段
+      Segment* first = newSegment();
+      Segment* expected = nullptr;
+      if (tailSegment_.compare_exchange_strong(expected, first, std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+        headSegment_.store(first, std::memory_order_release);
+        segment = first;
+      } else {
+        // 其他生产者已经安装，申请的段留作下一段
+        if (next == nullptr) {
+          next = first;
+        } else {
+          segments_.fetch_sub(1, std::memory_order_relaxed);
+          delete first;
+        }
+        tail = tail_.load(std::memory_order_acquire);
+        segment = tailSegment_.load(std::memory_order_acquire);
+        continue;
+      }
+    }
+    std::uint64_t new_tail = tail + (1 << kShift);
+    if (tail_.compare_exchange_weak(tail, new_tail, std::memory_order_seq_cst,
+                                    std::memory_order_acquire)) {
+      if (offset + 1 == SegmentSize) {
+        // 占用了最后一个槽位，负责把tail_移动到下一段，跳过哨兵
+        tailSegment_.store(next, std::memory_order_release);
+        tail_.store(new_tail + (1 << kShift), std::memory_order_release);
+        segment->next.store(next, std::memory_order_release);
+        next = nullptr;
+      }
+      Slot& slot = segment->slots[offset];
+      ::new (static_cast<void*>(slot.storage)) T(std::move(item));
+      slot.state.fetch_or(kWrite, std::memory_order_release);
+      break;
+    }
+    segment = tailSegment_.load(std::memory_order_acquire);
+  }
+  if (next != nullptr) {
+    segments_.fetch_sub(1, std::memory_order_relaxed);
+    delete next;
+  }
+  if (wait_strategy_) {
+    event_count_.Notify(wait_strategy_.get());
+  }
+}
+
+template <typename T, std::size_t SegmentSize>
+bool UnboundedQueue<T, SegmentSize>::dequeue(T* item) {
+  std::uint64_t head = head_.load(std::memory_order_acquire);
+  Segment* segment = headSegment_.load(std::memory_order_acquire);
+  while (true) {
+    std::uint64_t offset = (head >> kShift) % kLap;
+    if (offset == SegmentSize) {
+      // 其他消费者正在切换到下一段
+      std::this_thread::yield();
+      head = head_.load(std::memory_order_acquire);
+      segment = headSegment_.load(std::memory_order_acquire);
+      continue;
+    }
+    std::uint64_t new_head = head + (1 << kShift);
+    if ((new_head & kHasNext) == 0) {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      std::uint64_t tail = tail_.load(std::memory_order_relaxed);
+      if ((head >> kShift) == (tail >> kShift)) {
+        return false;  // 队列空
+      }
+      // head 和 tail 不在同一段，说明下一段已经存在
+      if ((head >> kShift) / kLap != (tail >> kShift) / kLap) {
+        new_head |= kHasNext;
+      }
+    }
+    if (segment == nullptr) {
+      // 第一个段正在安装
+      std::this_thread::yield();
+      head = head_.load(std::memory_order_acquire);
+      segment = headSegment_.load(std::memory_order_acquire);
+      continue;
+    }
+    if (head_.compare_exchange_weak(head, new_head, std::memory_order_seq_cst,
+                                    std::memory_order_acquire)) {
+      if (offset + 1 == SegmentSize) {
+        // 取到了最后一个槽位，负责把head_移动到下一段，跳过哨兵
+        Segment* next = segment->waitNext();
+        std::uint64_t next_head = (new_head & ~kHasNext) + (1 << kShift);
+        if (next->next.load(std::memory_order_relaxed) != nullptr) {
+          next_head |= kHasNext;
+        }
+        headSegment_.store(next, std::memory_order_release);
+        head_.store(next_head, std::memory_order_release);
+      }
+      // 槽位已经被占用，生产者可能还没写完
+      Slot& slot = segment->slots[offset];
+      slot.waitWrite();
+      T* value = slot.get();
+      *item = std::move(*value);
+      value->~T();
+      if (offset + 1 == SegmentSize) {
+        destroySegment(segment, 0);
+      } else if (slot.state.fetch_or(kRead, std::memory_order_acq_rel) & kDestroy) {
+        destroySegment(segment, offset + 1);
+      }
+      return true;
+    }
+    segment = headSegment_.load(std::memory_order_acquire);
+  }
+}
+
+template <typename T, std::size_t SegmentSize>
+std::uint64_t UnboundedQueue<T, SegmentSize>::enqueue_bulk(T* items, std::uint64_t count) {
+  for (std::uint64_t i = 0; i < count; i++) {
+    enqueue_impl(std::move(items[i]));
+  }
+  return count;
+}
+
+template <typename T, std::size_t SegmentSize>
+std::uint64_t UnboundedQueue<T, SegmentSize>::dequeue_bulk(T* items, std::uint64_t max_count) {
+  std::uint64_t n = 0;
+  while (n < max_count && dequeue(&items[n])) {
+    n++;
+  }
+  return n;
+}
+
+template <typename T, std::size_t SegmentSize>
+bool UnboundedQueue<T, SegmentSize>::wait_dequeue(T* item) {
+  while (!break_all_wait_) {
+    if (dequeue(item)) {
+      return true;
+    }
+    // 取得序号并登记为等待者之后再检查一次，之后的入队一定能看到登记
+    std::uint32_t key = wait_strategy_->PrepareWait();
+    std::uint32_t epoch = event_count_.PrepareWait();
+    if (dequeue(item)) {
+      event_count_.CancelWait();
+      return true;
+    }
+    if (break_all_wait_ || event_count_.Notified(epoch)) {
+      event_count_.CancelWait();
+      continue;
+    }
+    bool woken = wait_strategy_->CommitWait(key);
+    event_count_.CancelWait();
+    if (woken) {
+      continue;
+    }
+    return dequeue(item);
+  }
+  return false;
+}
+
+template <typename T, std::size_t SegmentSize>
+std::uint64_t UnboundedQueue<T, SegmentSize>::size() {
+  while (true) {
+    std::uint64_t tail = tail_.load(std::memory_order_seq_cst);
+    std::uint64_t head = head_.load(std::memory_order_seq_cst);
+    // tail_ 没有变化，说明读到的是一致的快照
+    if (tail_.load(std::memory_order_seq_cst) != tail) {
+      continue;
+    }
+    std::uint64_t h = itemIndex(head);
+    std::uint64_t t = itemIndex(tail);
+    return t > h ? t - h : 0;
+  }
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <cstdint>
@@ -7,11 +8,31 @@
 #include <thread>
 
 namespace wait_strategy {
+// 自旋时提示cpu当前处于忙等，降低功耗并让出超线程的执行资源
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#else
+  std::this_thread::yield();
+#endif
+}
+
 class WaitStrategy {
   public:
   virtual void NotifyOne() {};
   virtual void BreakAllWait() {};
   virtual bool EmptyWait() = 0;
+
+  /**
+   * @brief 两阶段等待：先取得序号，再检查一次队列，仍然不满足时才用序号等待
+   * 取得序号之后的通知都不会丢失。默认不区分序号，退化为 EmptyWait()
+   */
+  virtual std::uint32_t PrepareWait() { return 0; }
+
+  virtual bool CommitWait(std::uint32_t /*key*/) { return EmptyWait(); }
+
   virtual ~WaitStrategy() {};
 };
 
@@ -22,19 +43,36 @@ class WaitStrategy {
 class BlockWaitStrategy : public WaitStrategy {
   public:
   BlockWaitStrategy() = default;
-  void NotifyOne() override { cv_.notify_one(); }
+  // 在锁内记录通知，等待方在检查队列之后才进入等待，不记录的话中间的通知会丢失。
+  // 通知标记由生产者和消费者共享，只适合单方向阻塞的场景(例如线程池的工作线程)
+  void NotifyOne() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      signaled_ = true;
+    }
+    cv_.notify_one();
+  }
 
-  void BreakAllWait() override { cv_.notify_all(); }
+  void BreakAllWait() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      broken_ = true;
+    }
+    cv_.notify_all();
+  }
 
   bool EmptyWait() override {
     std::unique_lock<std::mutex> lock(mutex_);
-    cv_.wait(lock);
+    cv_.wait(lock, [&]() -> bool { return signaled_ || broken_; });
+    signaled_ = false;
     return true;
   }
 
   private:
   std::mutex mutex_;
   std::condition_variable cv_;
+  bool signaled_ = false;
+  bool broken_ = false;
 };
 
 /**
@@ -82,6 +120,8 @@ class YieldWaitStrategy : public WaitStrategy {
 /**
  * @brief timeout等待策略
  * 结合定时器和阻塞等待，在一定时间内等到的处理和超时等到的处理相互分离
+ * 通知在锁内递增序号，等待方用 PrepareWait 取得的序号判断期间是否已有通知，
+ * 通知发生在进入等待之前也不会白等一个超时周期
  */
 
 class TimeoutBlockStrategy : public WaitStrategy {
@@ -91,17 +131,34 @@ class TimeoutBlockStrategy : public WaitStrategy {
   explicit TimeoutBlockStrategy(std::uint64_t timeout_ms)
       : timeout_ms_(timeout_ms) {}
 
-  bool EmptyWait() override {
+  // 没有事先取得序号，只能等到之后的通知
+  bool EmptyWait() override { return CommitWait(PrepareWait()); }
+
+  std::uint32_t PrepareWait() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return seq_;
+  }
+
+  bool CommitWait(std::uint32_t key) override {
     std::unique_lock<std::mutex> lock(mutex_);
-    if (cv_.wait_for(lock, timeout_ms_) == std::cv_status::timeout) {
-      return false;
-    }
-    return true;
+    return cv_.wait_for(lock, timeout_ms_, [&]() -> bool { return seq_ != key || broken_; });
   }
 
-  void NotifyOne() override { cv_.notify_one(); }
+  void NotifyOne() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      seq_++;
+    }
+    cv_.notify_one();
+  }
 
-  void BreakAllWait() override { cv_.notify_all(); }
+  void BreakAllWait() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      broken_ = true;
+    }
+    cv_.notify_all();
+  }
 
   void set_timeout(std::uint64_t timeout_us) {
     timeout_ms_ = std::chrono::milliseconds(timeout_us);
@@ -111,5 +168,70 @@ class TimeoutBlockStrategy : public WaitStrategy {
   std::chrono::milliseconds timeout_ms_ = std::chrono::milliseconds(1000);
   std::condition_variable cv_;
   std::mutex mutex_;
+  std::uint32_t seq_ = 0;
+  bool broken_ = false;
+};
+/**
+ * @brief 自旋、让出cpu、挂起三段式的等待策略
+ * 先用pause自旋，再yield，最后挂起在序号上(std::atomic::wait，linux下即futex)。
+ * 通知只递增序号，没有挂起的线程时不会进入系统调用。
+ * 和 BlockWaitStrategy 一样，序号由生产者和消费者共享，适合单方向等待的场景(例如线程池的工作线程)
+ */
+
+class HybridWaitStrategy : public WaitStrategy {
+  public:
+  HybridWaitStrategy() = default;
+
+  HybridWaitStrategy(std::uint32_t spin_count, std::uint32_t yield_count)
+      : spin_count_(spin_count),
+        yield_count_(yield_count) {}
+
+  void NotifyOne() override {
+    // 和 CommitWait 中的 parked_ 自增构成 Dekker 式同步，都需要 seq_cst
+    seq_.fetch_add(1, std::memory_order_seq_cst);
+    if (parked_.load(std::memory_order_seq_cst) > 0) {
+      seq_.notify_one();
+    }
+  }
+
+  void BreakAllWait() override {
+    broken_.store(true, std::memory_order_seq_cst);
+    seq_.fetch_add(1, std::memory_order_seq_cst);
+    seq_.notify_all();
+  }
+
+  // 没有事先取得序号，期间的通知可能丢失
+  bool EmptyWait() override { return CommitWait(PrepareWait()); }
+
+  std::uint32_t PrepareWait() override { return seq_.load(std::memory_order_seq_cst); }
+
+  bool CommitWait(std::uint32_t key) override {
+    for (std::uint32_t i = 0; i < spin_count_; i++) {
+      if (seq_.load(std::memory_order_acquire) != key) {
+        return true;
+      }
+      CpuRelax();
+    }
+    for (std::uint32_t i = 0; i < yield_count_; i++) {
+      if (seq_.load(std::memory_order_acquire) != key) {
+        return true;
+      }
+      std::this_thread::yield();
+    }
+    if (broken_.load(std::memory_order_seq_cst)) {
+      return true;
+    }
+    parked_.fetch_add(1, std::memory_order_seq_cst);
+    seq_.wait(key, std::memory_order_seq_cst);
+    parked_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  private:
+  std::uint32_t spin_count_ = 64;
+  std::uint32_t yield_count_ = 16;
+  std::atomic<std::uint32_t> seq_ = {0};
+  std::atomic<std::uint32_t> parked_ = {0};
+  std::atomic<bool> broken_ = false;
 };
-}  // namespace wait_strategy
\ No newline at end of file
+}  // namespace wait_strategy
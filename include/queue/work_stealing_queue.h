@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief Chase-Lev 工作窃取双端队列
+ * 只有拥有者线程可以在 bottom 端 push/pop，其余线程只能从 top 端 steal。
+ * 实现参考 "Correct and Efficient Work-Stealing for Weak Memory Models"(Lê et al. 2013)。
+ * 窃取时会在CAS之前读取元素，所以T必须是可平凡拷贝的(一般存放指针)。
+ */
+template <typename T>
+class WorkStealingQueue {
+  static_assert(std::is_trivially_copyable_v<T>, "WorkStealingQueue requires trivially copyable T");
+
+  public:
+  explicit WorkStealingQueue(std::int64_t capacity = 1024);
+  ~WorkStealingQueue() = default;
+  WorkStealingQueue(const WorkStealingQueue&) = delete;
+  WorkStealingQueue& operator=(const WorkStealingQueue&) = delete;
+
+  // 仅拥有者线程调用
+  void push(T item);
+  bool pop(T* item);
+
+  // 任意线程调用
+  bool steal(T* item);
+
+  public:
+  std::int64_t size() {
+    std::int64_t b = bottom_.load(std::memory_order_relaxed);
+    std::int64_t t = top_.load(std::memory_order_relaxed);
+    return b > t ? b - t : 0;
+  }
+
+  bool empty() { return size() == 0; }
+
+  private:
+  // 环形数组，容量为2的幂
+  struct Array {
+    explicit Array(std::int64_t cap)
+        : capacity(cap),
+          mask(cap - 1),
+          buffer(new std::atomic<T>[cap]) {}
+
+    T get(std::int64_t i) { return buffer[i & mask].load(std::memory_order_relaxed); }
+
+    void put(std::int64_t i, T item) { buffer[i & mask].store(item, std::memory_order_relaxed); }
+
+    std::int64_t capacity;
+    std::int64_t mask;
+    std::unique_ptr<std::atomic<T>[]> buffer;
+  };
+
+  Array* grow(Array* old, std::int64_t bottom, std::int64_t top);
+
+  private:
+#define CACHELINE_SIZE 64
+  alignas(CACHELINE_SIZE) std::atomic<std::int64_t> top_ = {0};
+  alignas(CACHELINE_SIZE) std::atomic<std::int64_t> bottom_ = {0};
+  alignas(CACHELINE_SIZE) std::atomic<Array*> array_ = {nullptr};
+#undef CACHELINE_SIZE
+  // 扩容后旧数组可能仍被窃取者读取，统一在析构时释放
+  std::vector<std::unique_ptr<Array>> arrays_;
+};
+
+template <typename T>
+WorkStealingQueue<T>::WorkStealingQueue(std::int64_t capacity) {
+  std::int64_t cap = 1;
+  while (cap < capacity) {
+    cap <<= 1;
+  }
+  arrays_.emplace_back(std::make_unique<Array>(cap));
+  array_.store(arrays_.back().get(), std::memory_order_relaxed);
+}
+
+template <typename T>
+typename WorkStealingQueue<T>::Array* WorkStealingQueue<T>::grow(Array* old,
+                                                                 std::int64_t bottom,
+                                                                 std::int64_t top) {
+  auto bigger = std::make_unique<Array>(old->capacity * 2);
+  for (std::int64_t i = top; i < bottom; i++) {
+    bigger->put(i, old->get(i));
+  }
+  Array* ret = bigger.get();
+  arrays_.emplace_back(std::move(bigger));
+  array_.store(ret, std::memory_order_release);
+  return ret;
+}
+
+template <typename T>
+void WorkStealingQueue<T>::push(T item) {
+  std::int64_t b = bottom_.load(std::memory_order_relaxed);
+  std::int64_t t = top_.load(std::memory_order_acquire);
+  Array* a = array_.load(std::memory_order_relaxed);
+  if (b - t > a->capacity - 1) {
+    // 队列满，扩容
+    a = grow(a, b, t);
+  }
+  a->put(b, item);
+  bottom_.store(b + 1, std::memory_order_release);
+}
+
+template <typename T>
+bool WorkStealingQueue<T>::pop(T* item) {
+  std::int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+  Array* a = array_.load(std::memory_order_relaxed);
+  bottom_.store(b, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  std::int64_t t = top_.load(std::memory_order_relaxed);
+
+  if (t > b) {
+    // 队列空
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return false;
+  }
+
+  *item = a->get(b);
+  if (t == b) {
+    // 只剩最后一个元素，和窃取者竞争
+    bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                            std::memory_order_relaxed);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return won;
+  }
+  return true;
+}
+
+template <typename T>
+bool WorkStealingQueue<T>::steal(T* item) {
+  std::int64_t t = top_.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  std::int64_t b = bottom_.load(std::memory_order_acquire);
+
+  if (t >= b) {
+    return false;
+  }
+
+  Array* a = array_.load(std::memory_order_acquire);
+  T tmp = a->get(t);
+  if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                    std::memory_order_relaxed)) {
+    // 被其他窃取者或拥有者抢先
+    return false;
+  }
+  *item = tmp;
+  return true;
+}
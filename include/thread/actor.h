@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <utility>
+
+#include "function/unique_function.h"
+#include "minilog/minilog.h"
+#include "queue/mpsc_queue.h"
+#include "queue/wait_strategy.h"
+#include "thread/threadpool.h"
+
+namespace threadpool {
+namespace config {
+static constexpr const int ACTOR_BATCH_SIZE = 32;  // 每次激活最多处理的消息数
+}  // namespace config
+
+/**
+ * @brief 轻量的 actor：无锁信箱加一个消息处理函数，同一个 actor 的消息按发送顺序逐个处理
+ * 信箱从空变为非空时才把 actor 提交到线程池，一次激活连续处理至多 batch 条消息，
+ * 处理完信箱还不空就重新排队，让其他 actor 也能执行；信箱为空时 actor 不占用线程池中的任何东西。
+ * 空闲的 actor 只有线程池指针、信箱的三个指针、计数和处理函数，一共不到100字节，
+ * 可以同时存在数以百万计的 actor。消息在堆上分配节点，处理完立即释放。
+ */
+template <class Msg>
+class Actor {
+  public:
+  // 处理函数的内部缓冲区只有16字节，通常只捕获一两个指针
+  using Handler = UniqueFunction<void(Msg&), 16>;
+
+  Actor(ThreadPool& pool, Handler handler, std::uint32_t batch = config::ACTOR_BATCH_SIZE)
+      : pool_(&pool),
+        pending_(0),
+        batch_(batch == 0 ? 1 : batch),
+        handler_(std::move(handler)) {}
+
+  // 等待信箱中的消息全部处理完，不能在自己的处理函数中析构
+  ~Actor() {
+    pool_->help_until([this]() { return pending_.load(std::memory_order_acquire) == 0; });
+  }
+
+  // non-copy
+  Actor(const Actor&) = delete;
+  Actor& operator=(const Actor&) = delete;
+
+  // 任意线程调用，不会阻塞
+  template <class... Args>
+  void send(Args&&... args) {
+    queue_.push(new Letter(std::forward<Args>(args)...));
+    if (pending_.fetch_add(1, std::memory_order_acq_rel) == 0) {
+      activate();
+    }
+  }
+
+  // 信箱中还没有处理完的消息数
+  std::uint32_t pending() const { return pending_.load(std::memory_order_relaxed); }
+
+  private:
+  struct Letter : MpscNode {
+    template <class... Args>
+    explicit Letter(Args&&... args)
+        : msg(std::forward<Args>(args)...) {}
+
+    Msg msg;
+  };
+
+  void activate() {
+    pool_->post([this]() { run(); });
+  }
+
+  void run() {
+    for (std::uint32_t processed = 0; processed < batch_; processed++) {
+      MpscNode* node = queue_.pop();
+      while (node == nullptr) {
+        // 计数保证消息已经入队，只是发送者还没有链接完
+        wait_strategy::CpuRelax();
+        node = queue_.pop();
+      }
+      auto* letter = static_cast<Letter*>(node);
+      try {
+        handler_(letter->msg);
+      } catch (const std::exception& e) {
+        minilog::log_warn("actor handler throw exception: {}", e.what());
+      } catch (...) {
+        minilog::log_warn("actor handler throw unknown exception");
+      }
+      delete letter;
+      if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        // 信箱已空，下一条消息的发送者会重新激活；此后不能再访问成员
+        return;
+      }
+    }
+    activate();
+  }
+
+  private:
+  ThreadPool* pool_;
+  MpscQueue queue_;
+  std::atomic<std::uint32_t> pending_;
+  std::uint32_t batch_;
+  Handler handler_;
+};
+
+}  // namespace threadpool
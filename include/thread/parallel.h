@@ -0,0 +1,494 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <ranges>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "optional/optional.h"
+#include "thread/threadpool.h"
+
+namespace threadpool {
+namespace config {
+static constexpr const int PARALLEL_CHUNKS_PER_THREAD = 8;  // 自动分块时每个线程分到的块数
+static constexpr const int PARALLEL_YIELD_COUNT = 16;  // 没有任务可以帮忙时，阻塞之前让出cpu的次数
+static constexpr const int PARALLEL_SORT_CUTOFF = 1 << 14;  // 小于这个长度直接顺序排序
+static constexpr const int PARALLEL_MERGE_GRAIN = 1 << 14;  // 自动分块时并行归并每块的最小输出长度
+}  // namespace config
+
+enum class ParallelMode : uint8_t {
+  PARALLEL_CALLER_RUNS,   // 调用线程也执行分块，等待时帮忙执行线程池中排队的任务
+  PARALLEL_CALLER_WAITS,  // 调用线程只阻塞等待，不能在同一个线程池的工作线程中使用
+};
+
+namespace detail {
+/**
+ * @brief 一次并行调用的共享状态：未完成的任务数、领取分块的计数器和第一个异常
+ * 由调用线程和提交出去的任务共同持有，调用线程返回之后任务仍然可以安全地减计数
+ */
+class ParallelContext {
+  public:
+  void add(std::size_t count) { pending_.fetch_add(count, std::memory_order_relaxed); }
+
+  void done(std::size_t count = 1) {
+    if (pending_.fetch_sub(count, std::memory_order_acq_rel) == count) {
+      pending_.notify_all();
+    }
+  }
+
+  // 领取下一个分块
+  bool claim(std::size_t chunks, std::size_t* index) {
+    *index = next_.fetch_add(1, std::memory_order_relaxed);
+    return *index < chunks && !failed();
+  }
+
+  bool failed() const { return failed_.load(std::memory_order_relaxed); }
+
+  // 执行一个分块，只保留第一个异常，出现异常之后剩下的分块不再执行
+  template <class F>
+  void run(F&& f) {
+    if (failed()) {
+      return;
+    }
+    try {
+      f();
+    } catch (...) {
+      if (!failed_.exchange(true, std::memory_order_relaxed)) {
+        error_ = std::current_exception();
+      }
+    }
+  }
+
+  // 等待所有提交出去的任务完成，然后重新抛出第一个异常
+  void wait(ThreadPool& pool, bool help) {
+    int idle = 0;
+    while (true) {
+      std::size_t pending = pending_.load(std::memory_order_acquire);
+      if (pending == 0) {
+        break;
+      }
+      if (help && pool.run_pending_task()) {
+        idle = 0;
+        continue;
+      }
+      if (idle++ < config::PARALLEL_YIELD_COUNT) {
+        std::this_thread::yield();
+        continue;
+      }
+      pending_.wait(pending, std::memory_order_acquire);
+    }
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+  }
+
+  // 重新使用，只能在没有未完成的任务时调用
+  void reset() {
+    next_.store(0, std::memory_order_relaxed);
+    failed_.store(false, std::memory_order_relaxed);
+    error_ = nullptr;
+  }
+
+  private:
+  std::atomic<std::size_t> pending_ = {0};
+  std::atomic<std::size_t> next_ = {0};
+  std::atomic<bool> failed_ = {false};
+  std::exception_ptr error_;
+};
+
+/**
+ * @brief 递归二分：右半边交给线程池，左半边继续拆分，最后在当前线程上执行剩下的一块
+ * 工作线程提交的任务进入自己的本地队列，先提交的一半最大，被窃取时一次拿走的工作最多
+ */
+template <class Fn>
+void splitChunks(ThreadPool& pool, const std::shared_ptr<ParallelContext>& ctx, std::size_t lo,
+                 std::size_t hi, Fn* fn) {
+  while (hi - lo > 1 && !ctx->failed()) {
+    std::size_t mid = lo + (hi - lo) / 2;
+    ctx->add(1);
+    pool.post([&pool, ctx, mid, hi, fn]() {
+      splitChunks(pool, ctx, mid, hi, fn);
+      ctx->done();
+    });
+    hi = mid;
+  }
+  ctx->run([&]() { (*fn)(lo); });
+}
+
+/**
+ * @brief 把 [0, chunks) 个分块交给线程池执行，fn(i) 执行第i块
+ * STEALING 模式下递归二分；其他模式的队列是共享的，按线程数提交若干个执行者，
+ * 执行者从原子计数器上领取分块，提交的任务数和分块数无关，有界队列不会被塞满
+ */
+template <class Fn>
+void forEachChunk(ThreadPool& pool, std::size_t chunks, Fn& fn, ParallelMode mode) {
+  if (chunks == 0) {
+    return;
+  }
+  bool help = mode == ParallelMode::PARALLEL_CALLER_RUNS;
+  if (chunks == 1 && help) {
+    fn(0);
+    return;
+  }
+  auto ctx = std::make_shared<ParallelContext>();
+  if (pool.mode() == PoolMode::MODE_STEALING) {
+    if (help) {
+      splitChunks(pool, ctx, 0, chunks, &fn);
+    } else {
+      ctx->add(1);
+      pool.post([&pool, ctx, chunks, fn = &fn]() {
+        splitChunks(pool, ctx, 0, chunks, fn);
+        ctx->done();
+      });
+    }
+    ctx->wait(pool, help);
+    return;
+  }
+  auto drain = [chunks](ParallelContext* ctx, Fn* fn) {
+    std::size_t index = 0;
+    while (ctx->claim(chunks, &index)) {
+      ctx->run([&]() { (*fn)(index); });
+    }
+  };
+  std::size_t threads = static_cast<std::size_t>(std::max(pool.threadSize(), 1));
+  std::size_t runners = std::min(chunks - (help ? 1 : 0), threads);
+  ctx->add(runners);
+  for (std::size_t i = 0; i < runners; i++) {
+    pool.post([ctx, fn = &fn, drain]() {
+      drain(ctx.get(), fn);
+      ctx->done();
+    });
+  }
+  if (help) {
+    drain(ctx.get(), &fn);
+  }
+  ctx->wait(pool, help);
+}
+
+// grain 为0时按线程数自动分块
+inline std::size_t chunkGrain(ThreadPool& pool, std::size_t count, std::size_t grain) {
+  if (grain > 0) {
+    return grain;
+  }
+  std::size_t threads = static_cast<std::size_t>(std::max(pool.threadSize(), 1));
+  return std::max<std::size_t>(count / (threads * config::PARALLEL_CHUNKS_PER_THREAD), 1);
+}
+
+/**
+ * @brief 归并路径上的划分：归并结果的前k个元素中，有多少个来自第一个序列
+ * 相等的元素第一个序列在前，和 std::merge 一样是稳定的
+ */
+template <class It1, class It2, class Compare>
+std::size_t mergeSplit(It1 first1, std::size_t n1, It2 first2, std::size_t n2, std::size_t k,
+                       Compare& comp) {
+  std::size_t lo = k > n2 ? k - n2 : 0;
+  std::size_t hi = std::min(k, n1);
+  while (lo < hi) {
+    std::size_t i = lo + (hi - lo) / 2;
+    std::size_t j = k - i;
+    // first1[i] 不大于 first2[j-1]，它应该排在前k个之内
+    if (j > 0 && !comp(first2[j - 1], first1[i])) {
+      lo = i + 1;
+    } else {
+      hi = i;
+    }
+  }
+  return lo;
+}
+
+/**
+ * @brief 归并输出区间 [k_lo, k_hi)，其中第一个序列贡献 [i_lo, i_hi)，划分由 mergeSplit 给出
+ * Move 为 true 时移动而不是拷贝元素；比较时总是传入左值，按值接收参数的 comp 不会移走元素
+ */
+template <bool Move, class It1, class It2, class OutputIt, class Compare>
+void mergeRange(It1 first1, It2 first2, OutputIt d_first, std::size_t k_lo, std::size_t k_hi,
+                std::size_t i_lo, std::size_t i_hi, Compare& comp) {
+  if constexpr (!Move) {
+    std::merge(first1 + i_lo, first1 + i_hi, first2 + (k_lo - i_lo), first2 + (k_hi - i_hi),
+               d_first + k_lo, comp);
+  } else {
+    It1 a = first1 + i_lo;
+    It1 a_end = first1 + i_hi;
+    It2 b = first2 + (k_lo - i_lo);
+    It2 b_end = first2 + (k_hi - i_hi);
+    OutputIt out = d_first + k_lo;
+    while (a != a_end && b != b_end) {
+      if (comp(*b, *a)) {
+        *out++ = std::move(*b++);
+      } else {
+        *out++ = std::move(*a++);
+      }
+    }
+    out = std::move(a, a_end, out);
+    std::move(b, b_end, out);
+  }
+}
+}  // namespace detail
+
+/**
+ * @brief 并行执行 [first, last) 上的循环
+ *
+ * @param grain 每块的最小长度，为0时按线程数自动划分
+ * @param body body(i) 处理一个下标，或者 body(lo, hi) 一次处理一块 [lo, hi)
+ * @param mode 调用线程是否参与执行，任意一块抛出的第一个异常会在调用线程上重新抛出
+ */
+template <std::integral Index, class Body>
+void parallel_for(ThreadPool& pool, Index first, std::type_identity_t<Index> last,
+                  std::type_identity_t<Index> grain, Body&& body,
+                  ParallelMode mode = ParallelMode::PARALLEL_CALLER_RUNS) {
+  if (last <= first) {
+    return;
+  }
+  auto count = static_cast<std::size_t>(last - first);
+  std::size_t step = detail::chunkGrain(pool, count, static_cast<std::size_t>(grain));
+  auto chunk = [&](std::size_t index) {
+    Index lo = first + static_cast<Index>(index * step);
+    Index hi = static_cast<Index>(std::min(count, (index + 1) * step)) + first;
+    if constexpr (std::is_invocable_v<Body&, Index, Index>) {
+      body(lo, hi);
+    } else {
+      for (Index i = lo; i < hi; i++) {
+        body(i);
+      }
+    }
+  };
+  detail::forEachChunk(pool, (count + step - 1) / step, chunk, mode);
+}
+
+// 并行处理随机访问区间中的每个元素，body(element)
+template <std::ranges::random_access_range R, class Body>
+void parallel_for(ThreadPool& pool, R&& range, std::size_t grain, Body&& body,
+                  ParallelMode mode = ParallelMode::PARALLEL_CALLER_RUNS) {
+  auto begin = std::ranges::begin(range);
+  auto count = static_cast<std::size_t>(std::ranges::distance(range));
+  parallel_for(
+      pool, std::size_t(0), count, grain,
+      [&](std::size_t lo, std::size_t hi) {
+        auto end = begin + hi;
+        for (auto it = begin + lo; it != end; ++it) {
+          body(*it);
+        }
+      },
+      mode);
+}
+
+/**
+ * @brief 并行归约，每块的结果按块的顺序合并，combine 只需要满足结合律
+ *
+ * @param identity combine 的单位元
+ * @param body body(i) 返回一个下标的值，或者 body(lo, hi) 返回一块 [lo, hi) 的归约结果
+ */
+template <std::integral Index, class T, class Body, class Combine>
+T parallel_reduce(ThreadPool& pool, Index first, std::type_identity_t<Index> last,
+                  std::type_identity_t<Index> grain, T identity, Body&& body, Combine&& combine,
+                  ParallelMode mode = ParallelMode::PARALLEL_CALLER_RUNS) {
+  if (last <= first) {
+    return identity;
+  }
+  auto count = static_cast<std::size_t>(last - first);
+  std::size_t step = detail::chunkGrain(pool, count, static_cast<std::size_t>(grain));
+  std::size_t chunks = (count + step - 1) / step;
+  std::vector<T> partials(chunks, identity);
+  auto chunk = [&](std::size_t index) {
+    Index lo = first + static_cast<Index>(index * step);
+    Index hi = static_cast<Index>(std::min(count, (index + 1) * step)) + first;
+    if constexpr (std::is_invocable_v<Body&, Index, Index>) {
+      partials[index] = body(lo, hi);
+    } else {
+      T acc = identity;
+      for (Index i = lo; i < hi; i++) {
+        acc = combine(std::move(acc), body(i));
+      }
+      partials[index] = std::move(acc);
+    }
+  };
+  detail::forEachChunk(pool, chunks, chunk, mode);
+  T result = std::move(identity);
+  for (auto& partial : partials) {
+    result = combine(std::move(result), std::move(partial));
+  }
+  return result;
+}
+
+/**
+ * @brief 并行的前缀和，结果和 std::inclusive_scan 相同，op 只需要满足结合律
+ * 分两趟：先并行求出每块的和，顺序求出每块的起始值，再并行地在块内扫描；输出可以和输入相同
+ *
+ * @return OutputIt 输出区间的尾后迭代器
+ */
+template <std::random_access_iterator InputIt, std::random_access_iterator OutputIt,
+          class BinaryOp = std::plus<>>
+OutputIt parallel_inclusive_scan(ThreadPool& pool, InputIt first, InputIt last, OutputIt d_first,
+                                 BinaryOp op = {}, std::size_t grain = 0,
+                                 ParallelMode mode = ParallelMode::PARALLEL_CALLER_RUNS) {
+  using T = std::iter_value_t<InputIt>;
+  auto count = static_cast<std::size_t>(last - first);
+  if (count == 0) {
+    return d_first;
+  }
+  std::size_t step = detail::chunkGrain(pool, count, grain);
+  std::size_t chunks = (count + step - 1) / step;
+  if (chunks == 1) {
+    return std::inclusive_scan(first, last, d_first, op);
+  }
+  // 第一趟，最后一块的和用不到
+  std::vector<Optional<T>> carries(chunks);
+  auto sum = [&](std::size_t index) {
+    InputIt it = first + index * step;
+    InputIt end = first + std::min(count, (index + 1) * step);
+    T acc = *it;
+    for (++it; it != end; ++it) {
+      acc = op(std::move(acc), *it);
+    }
+    carries[index + 1] = std::move(acc);
+  };
+  detail::forEachChunk(pool, chunks - 1, sum, mode);
+  for (std::size_t i = 2; i < chunks; i++) {
+    carries[i] = op(*carries[i - 1], std::move(*carries[i]));
+  }
+  // 第二趟
+  auto scan = [&](std::size_t index) {
+    InputIt lo = first + index * step;
+    InputIt hi = first + std::min(count, (index + 1) * step);
+    if (index == 0) {
+      std::inclusive_scan(lo, hi, d_first, op);
+    } else {
+      std::inclusive_scan(lo, hi, d_first + index * step, op, *carries[index]);
+    }
+  };
+  detail::forEachChunk(pool, chunks, scan, mode);
+  return d_first + count;
+}
+
+/**
+ * @brief 并行归并两个有序序列，结果和 std::merge 相同(稳定)
+ * 按输出位置在归并路径上二分出每段的起点，各段的归并互不依赖
+ *
+ * @param grain 每段的最小输出长度，为0时按线程数自动划分
+ * @return OutputIt 输出区间的尾后迭代器
+ */
+template <std::random_access_iterator It1, std::random_access_iterator It2,
+          std::random_access_iterator OutputIt, class Compare = std::less<>>
+OutputIt parallel_merge(ThreadPool& pool, It1 first1, It1 last1, It2 first2, It2 last2,
+                        OutputIt d_first, Compare comp = {}, std::size_t grain = 0,
+                        ParallelMode mode = ParallelMode::PARALLEL_CALLER_RUNS) {
+  auto n1 = static_cast<std::size_t>(last1 - first1);
+  auto n2 = static_cast<std::size_t>(last2 - first2);
+  std::size_t total = n1 + n2;
+  if (grain == 0) {
+    grain = std::max<std::size_t>(detail::chunkGrain(pool, total, 0),
+                                  config::PARALLEL_MERGE_GRAIN);
+  }
+  std::size_t parts = std::max<std::size_t>((total + grain - 1) / grain, 1);
+  // 只读不写输入，每一段可以各自在归并路径上找划分
+  auto part = [&](std::size_t index) {
+    std::size_t k_lo = total * index / parts;
+    std::size_t k_hi = total * (index + 1) / parts;
+    detail::mergeRange<false>(first1, first2, d_first, k_lo, k_hi,
+                              detail::mergeSplit(first1, n1, first2, n2, k_lo, comp),
+                              detail::mergeSplit(first1, n1, first2, n2, k_hi, comp), comp);
+  };
+  detail::forEachChunk(pool, parts, part, mode);
+  return d_first + total;
+}
+
+/**
+ * @brief 并行排序，不稳定，结果和 std::sort 相同
+ * 先把区间切成2的幂个段并行地 std::sort，再两两并行归并，每一轮归并本身也按输出位置切段，
+ * 最后几轮只剩一两对序列时仍然能用上所有线程；需要一块和输入同样大小的缓冲区
+ */
+template <std::random_access_iterator RandomIt, class Compare = std::less<>>
+void parallel_sort(ThreadPool& pool, RandomIt first, RandomIt last, Compare comp = {},
+                   ParallelMode mode = ParallelMode::PARALLEL_CALLER_RUNS) {
+  using T = std::iter_value_t<RandomIt>;
+  auto count = static_cast<std::size_t>(last - first);
+  std::size_t threads = static_cast<std::size_t>(std::max(pool.threadSize(), 1));
+  if (mode == ParallelMode::PARALLEL_CALLER_RUNS) {
+    threads++;
+  }
+  // 段数是2的幂，每段不小于顺序排序的阈值
+  std::size_t limit = std::max<std::size_t>(count / config::PARALLEL_SORT_CUTOFF, 1);
+  std::size_t runs = std::min(std::bit_ceil(threads), std::bit_floor(limit));
+  if (runs <= 1) {
+    std::sort(first, last, comp);
+    return;
+  }
+  auto runBegin = [count, runs](std::size_t index) { return count * index / runs; };
+  auto sortRun = [&](std::size_t index) {
+    std::sort(first + runBegin(index), first + runBegin(index + 1), comp);
+  };
+  detail::forEachChunk(pool, runs, sortRun, mode);
+
+  std::vector<T> buffer;
+  if constexpr (std::is_default_constructible_v<T>) {
+    buffer.resize(count);
+  } else {
+    buffer.assign(first, last);
+  }
+  // 每一轮把 src 中相邻的两段归并到 dst，段数减半，src 和 dst 交替
+  std::size_t partsPerRound =
+      std::max<std::size_t>(threads * config::PARALLEL_CHUNKS_PER_THREAD, runs / 2);
+  // 移动会改写源序列，所以每一轮先算出所有划分点，再并行地移动归并
+  std::vector<std::size_t> splits;
+  bool inBuffer = false;
+  for (std::size_t width = 1; width < runs; width *= 2) {
+    std::size_t pairs = runs / (width * 2);
+    std::size_t parts = (partsPerRound + pairs - 1) / pairs;
+    splits.assign(pairs * (parts + 1), 0);
+    auto merge = [&](auto src, auto dst) {
+      // 第 pair 对归并 [lo, mid) 和 [mid, hi)，按输出长度切成 parts 段，splits 保存 parts+1 个划分点
+      auto bounds = [&](std::size_t pair, std::size_t* lo, std::size_t* mid, std::size_t* hi) {
+        *lo = runBegin(pair * width * 2);
+        *mid = runBegin(pair * width * 2 + width);
+        *hi = runBegin(pair * width * 2 + width * 2);
+      };
+      auto splitRound = [&](std::size_t index) {
+        std::size_t pair = index / (parts + 1);
+        std::size_t part = index % (parts + 1);
+        std::size_t lo = 0, mid = 0, hi = 0;
+        bounds(pair, &lo, &mid, &hi);
+        splits[index] = detail::mergeSplit(src + lo, mid - lo, src + mid, hi - mid,
+                                           (hi - lo) * part / parts, comp);
+      };
+      auto mergeRound = [&](std::size_t index) {
+        std::size_t pair = index / parts;
+        std::size_t part = index % parts;
+        std::size_t lo = 0, mid = 0, hi = 0;
+        bounds(pair, &lo, &mid, &hi);
+        std::size_t* split = &splits[pair * (parts + 1) + part];
+        detail::mergeRange<true>(src + lo, src + mid, dst + lo, (hi - lo) * part / parts,
+                                 (hi - lo) * (part + 1) / parts, split[0], split[1], comp);
+      };
+      detail::forEachChunk(pool, splits.size(), splitRound, mode);
+      detail::forEachChunk(pool, pairs * parts, mergeRound, mode);
+    };
+    if (inBuffer) {
+      merge(buffer.begin(), first);
+    } else {
+      merge(first, buffer.begin());
+    }
+    inBuffer = !inBuffer;
+  }
+  if (inBuffer) {
+    parallel_for(
+        pool, std::size_t(0), count, std::size_t(0),
+        [&](std::size_t lo, std::size_t hi) {
+          std::move(buffer.begin() + lo, buffer.begin() + hi, first + lo);
+        },
+        mode);
+  }
+}
+
+}  // namespace threadpool
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "future/slab_allocator.h"
+#include "future/task_future.h"
+#include "minilog/minilog.h"
+#include "queue/mpsc_queue.h"
+#include "queue/wait_strategy.h"
+#include "thread/threadpool.h"
+
+namespace threadpool {
+namespace config {
+static constexpr const int STRAND_DRAIN_LIMIT = 64;  // 一次调度最多连续执行的任务数，之后重新排队
+}  // namespace config
+
+/**
+ * @brief 串行执行器：提交到同一个 strand 的任务按提交顺序一个接一个地执行，不需要加锁
+ * 任务放在侵入式的无锁 MPSC 队列中，计数从0变为1的提交者把 strand 交给线程池，
+ * 执行者把队列清空之后才退出，所以同一时刻最多只有一个线程在执行这个 strand 的任务；
+ * strand 本身不持有线程，大量的 strand 可以共享一个很小的线程池。
+ * 队列节点和任务装在一起，从线程池的slab中分配，稳定之后提交不走堆分配；slab耗尽时才退化为堆分配。
+ * 连续执行 STRAND_DRAIN_LIMIT 个任务之后重新提交到线程池的队尾，一个繁忙的 strand 不会一直占着工作线程。
+ */
+class Strand {
+  public:
+  using Task = ThreadPool::Task;
+
+  explicit Strand(ThreadPool& pool, Priority priority = Priority::PRIORITY_NORMAL)
+      : pool_(pool),
+        priority_(priority) {}
+
+  // 等待已经提交的任务全部执行完，不能在这个 strand 的任务中析构
+  ~Strand() {
+    pool_.help_until([this]() { return pending_.load(std::memory_order_acquire) == 0; });
+  }
+
+  // non-copy
+  Strand(const Strand&) = delete;
+  Strand& operator=(const Strand&) = delete;
+
+  /**
+   * @brief 提交不需要结果的任务，任务抛出的异常只记录日志
+   */
+  void post(Task task) {
+    queue_.push(box(std::move(task)));
+    // 先入队再计数，执行者看到的计数不会超过队列中的任务数
+    if (pending_.fetch_add(1, std::memory_order_acq_rel) == 0) {
+      schedule();
+    }
+  }
+
+  // 和 ThreadPool::submit 相同，只是任务在这个 strand 上串行执行
+  template <class F, class... Args>
+  auto submit(F&& f, Args&&... args) -> TaskFuture<typename std::invoke_result_t<F, Args...>> {
+    using RetType = typename std::invoke_result_t<F, Args...>;
+    TaskPromise<RetType> promise;
+    TaskFuture<RetType> result = promise.get_future();
+    post([promise = std::move(promise), f = std::forward<F>(f),
+          ... args = std::forward<Args>(args)]() mutable { promise.run(f, args...); });
+    return result;
+  }
+
+  // 当前线程是否正在执行这个 strand 的任务
+  bool running_in_this_thread() const {
+    for (Frame* frame = current(); frame != nullptr; frame = frame->prev) {
+      if (frame->strand == this) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // 已经提交还没有执行完的任务数
+  std::size_t pending() const { return pending_.load(std::memory_order_relaxed); }
+
+  private:
+  struct Node : MpscNode {
+    explicit Node(Task&& t)
+        : task(std::move(t)) {}
+
+    Task task;
+    std::uint32_t index = SlabAllocator::kInvalidIndex;  // slab中的下标，堆分配时为 kInvalidIndex
+  };
+
+  Node* box(Task&& task) { return pool_.slab()->create<Node>(std::move(task)); }
+
+  void unbox(Node* node) { pool_.slab()->destroy(node); }
+
+  // 执行中的 strand 链，任务中帮忙执行线程池的任务时 strand 可能嵌套
+  struct Frame {
+    const Strand* strand;
+    Frame* prev;
+  };
+
+  static Frame*& current() {
+    static thread_local Frame* frame = nullptr;
+    return frame;
+  }
+
+  void schedule() {
+    pool_.post([this]() { drain(); }, priority_);
+  }
+
+  void drain() {
+    Frame frame{this, current()};
+    current() = &frame;
+    for (int executed = 0;; executed++) {
+      if (executed == config::STRAND_DRAIN_LIMIT) {
+        // 仍然持有执行权，重新排队让其他任务有机会执行
+        current() = frame.prev;
+        schedule();
+        return;
+      }
+      MpscNode* node = queue_.pop();
+      while (node == nullptr) {
+        // 计数保证节点已经入队，只是生产者还没有链接完
+        wait_strategy::CpuRelax();
+        node = queue_.pop();
+      }
+      auto* task = static_cast<Node*>(node);
+      run(task->task);
+      unbox(task);
+      if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        // 队列已空，之后的提交者会重新调度；此后不能再访问成员
+        break;
+      }
+    }
+    current() = frame.prev;
+  }
+
+  static void run(Task& task) {
+    try {
+      task();
+    } catch (const std::exception& e) {
+      minilog::log_warn("strand task throw exception: {}", e.what());
+    } catch (...) {
+      minilog::log_warn("strand task throw unknown exception");
+    }
+  }
+
+  private:
+  ThreadPool& pool_;
+  Priority priority_;
+  MpscQueue queue_;
+  std::atomic<std::size_t> pending_ = {0};
+};
+
+}  // namespace threadpool
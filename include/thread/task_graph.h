@@ -0,0 +1,278 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "queue/lockfree_queue.h"
+#include "queue/wait_strategy.h"
+#include "thread/parallel.h"
+#include "thread/threadpool.h"
+
+namespace threadpool {
+
+/**
+ * @brief 静态的任务依赖图：先声明任务和依赖，然后可以反复执行
+ * 每个节点有一个原子的入度计数器，前驱完成时减一，减到0的后继由完成前驱的线程负责，
+ * 最后一个就绪的后继直接在当前线程上接着执行，数据在缓存中还是热的，也少一次入队出队。
+ * STEALING 模式下其余就绪的后继提交到线程池，工作线程提交的任务进入自己的本地队列；
+ * 其他模式的队列是共享且有界的，就绪的节点放入图自己的就绪队列，
+ * 由至多线程数个执行者取出执行，不会因为工作线程都在等待队列的空位而死锁。
+ * 第一次执行时把后继表压缩成连续的数组并检查是否有环，之后图不变就不再分配，
+ * 每次执行只需要把计数器恢复成入度。
+ * 任务抛出的第一个异常在 run() 中重新抛出，出现异常之后还没有开始的任务不再执行。
+ */
+class TaskGraph {
+  public:
+  using Task = ThreadPool::Task;
+  using NodeId = std::size_t;
+
+  explicit TaskGraph(ThreadPool& pool, Priority priority = Priority::PRIORITY_NORMAL)
+      : pool_(pool),
+        priority_(priority) {}
+
+  // non-copy
+  TaskGraph(const TaskGraph&) = delete;
+  TaskGraph& operator=(const TaskGraph&) = delete;
+
+  /**
+   * @brief 添加一个任务，predecessors 中的任务都完成之后才会执行
+   */
+  NodeId add(Task task, std::initializer_list<NodeId> predecessors = {}) {
+    NodeId id = tasks_.size();
+    for (NodeId pred : predecessors) {
+      check(pred);
+    }
+    tasks_.push_back(std::move(task));
+    for (NodeId pred : predecessors) {
+      edges_.emplace_back(pred, id);
+    }
+    compiled_ = false;
+    return id;
+  }
+
+  // node 在 predecessor 完成之后才执行
+  void add_dependency(NodeId node, NodeId predecessor) {
+    check(node);
+    check(predecessor);
+    edges_.emplace_back(predecessor, node);
+    compiled_ = false;
+  }
+
+  /**
+   * @brief 执行整个图并等待完成，不能并发调用；图中有环时抛出 std::logic_error
+   *
+   * @param mode PARALLEL_CALLER_RUNS 等待时帮忙执行线程池中排队的任务，可以在工作线程中调用；
+   * PARALLEL_CALLER_WAITS 只阻塞等待，不会从工作线程的本地队列中窃取，外部线程调用时开销更小
+   */
+  void run(ParallelMode mode = ParallelMode::PARALLEL_CALLER_RUNS) {
+    if (tasks_.empty()) {
+      return;
+    }
+    if (!compiled_) {
+      compile();
+    }
+    for (std::size_t i = 0; i < tasks_.size(); i++) {
+      counters_[i].store(indegree_[i], std::memory_order_relaxed);
+    }
+    // 上一次执行的计数已经归零，还没有析构的任务在 done() 之后不会再访问上下文，可以直接复用；
+    // 用 shared_ptr 只是为了图被析构时 done() 中的 notify_all 仍然作用在有效的内存上
+    if (ctx_ == nullptr) {
+      ctx_ = std::make_shared<detail::ParallelContext>();
+    } else {
+      ctx_->reset();
+    }
+    ctx_->add(tasks_.size());
+    stealing_ = pool_.mode() == PoolMode::MODE_STEALING;
+    if (stealing_) {
+      // 由工作线程拆分根节点，它们进入本地队列，不会挤在外部提交的注入队列上
+      pool_.post([this, ctx = ctx_]() { postRoots(ctx, 0, roots_.size()); }, priority_);
+    } else {
+      executorLimit_ = static_cast<std::size_t>(std::max(pool_.threadSize(), 1));
+      for (NodeId root : roots_) {
+        ready_->enqueue(root);
+      }
+      for (std::size_t i = 0; i < std::min(executorLimit_, roots_.size()); i++) {
+        executors_.fetch_add(1, std::memory_order_relaxed);
+        postExecutor();
+      }
+    }
+    ctx_->wait(pool_, mode == ParallelMode::PARALLEL_CALLER_RUNS);
+  }
+
+  std::size_t size() const { return tasks_.size(); }
+
+  private:
+  void check(NodeId id) const {
+    if (id >= tasks_.size()) {
+      throw std::out_of_range("task graph: invalid node id");
+    }
+  }
+
+  // 按起点排序成连续的后继表，计算入度，同时用拓扑排序检查环
+  void compile() {
+    std::size_t n = tasks_.size();
+    offsets_.assign(n + 1, 0);
+    for (auto& edge : edges_) {
+      offsets_[edge.first + 1]++;
+    }
+    for (std::size_t i = 0; i < n; i++) {
+      offsets_[i + 1] += offsets_[i];
+    }
+    successors_.resize(edges_.size());
+    indegree_.assign(n, 0);
+    std::vector<std::size_t> fill(offsets_.begin(), offsets_.end() - 1);
+    for (auto& edge : edges_) {
+      successors_[fill[edge.first]++] = edge.second;
+      indegree_[edge.second]++;
+    }
+    roots_.clear();
+    std::vector<std::uint32_t> remaining(indegree_);
+    std::vector<NodeId> order;
+    order.reserve(n);
+    for (NodeId i = 0; i < n; i++) {
+      if (remaining[i] == 0) {
+        roots_.push_back(i);
+        order.push_back(i);
+      }
+    }
+    for (std::size_t k = 0; k < order.size(); k++) {
+      for (std::size_t e = offsets_[order[k]]; e < offsets_[order[k] + 1]; e++) {
+        if (--remaining[successors_[e]] == 0) {
+          order.push_back(successors_[e]);
+        }
+      }
+    }
+    if (order.size() != n) {
+      throw std::logic_error("task graph: dependency cycle");
+    }
+    counters_ = std::make_unique<std::atomic<std::uint32_t>[]>(n);
+    // 每次执行每个节点至多进入一次就绪队列，入队不会失败
+    ready_ = std::make_unique<BoundedQueue<NodeId>>();
+    ready_->Init(n, new wait_strategy::YieldWaitStrategy());
+    compiled_ = true;
+  }
+
+  // 和 splitChunks 一样递归二分根节点：右半边交给线程池，左半边继续拆分，最后在当前线程上执行剩下的一个，
+  // 本地队列的深度只有 log(根节点数)，不会因为根节点很多而扩容，被窃取时一次拿走一半；
+  // 和其他任务一样只通过捕获的 ctx 访问上下文
+  void postRoots(const std::shared_ptr<detail::ParallelContext>& ctx, std::size_t lo,
+                 std::size_t hi) {
+    while (hi - lo > 1) {
+      std::size_t mid = lo + (hi - lo) / 2;
+      ctx->add(1);
+      pool_.post(
+          [this, ctx, mid, hi]() {
+            postRoots(ctx, mid, hi);
+            ctx->done();
+          },
+          priority_);
+      hi = mid;
+    }
+    execute(ctx.get(), roots_[lo]);
+  }
+
+  void post(NodeId node) {
+    pool_.post([this, ctx = ctx_, node]() { execute(ctx.get(), node); }, priority_);
+  }
+
+  // 就绪但是不在当前线程上执行的节点
+  void schedule(NodeId node) {
+    if (stealing_) {
+      post(node);
+      return;
+    }
+    ready_->enqueue(node);
+    // 和执行者退出前的检查配对，二者至少有一方能看到对方的修改
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (tryAcquireExecutor()) {
+      postExecutor();
+    }
+  }
+
+  bool tryAcquireExecutor() {
+    std::size_t active = executors_.load(std::memory_order_relaxed);
+    while (active < executorLimit_) {
+      if (executors_.compare_exchange_weak(active, active + 1, std::memory_order_acq_rel,
+                                           std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // 执行者本身也计入未完成的数量，退出之前图不会被析构
+  void postExecutor() {
+    ctx_->add(1);
+    pool_.post(
+        [this, ctx = ctx_]() {
+          while (true) {
+            NodeId node = 0;
+            while (ready_->dequeue(&node)) {
+              execute(ctx.get(), node);
+            }
+            executors_.fetch_sub(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (ready_->empty() || !tryAcquireExecutor()) {
+              break;
+            }
+          }
+          ctx->done();
+        },
+        priority_);
+  }
+
+  void execute(detail::ParallelContext* ctx, NodeId node) {
+    // 连续执行的节点最后一起计入完成数，减少对共享计数器的争用
+    std::size_t finished = 0;
+    while (true) {
+      ctx->run(tasks_[node]);
+      NodeId next = tasks_.size();
+      for (std::size_t e = offsets_[node]; e < offsets_[node + 1]; e++) {
+        NodeId succ = successors_[e];
+        if (counters_[succ].fetch_sub(1, std::memory_order_acq_rel) != 1) {
+          continue;
+        }
+        if (next != tasks_.size()) {
+          // 除了最后一个，就绪的后继都交给其他线程
+          schedule(next);
+        }
+        next = succ;
+      }
+      finished++;
+      if (next == tasks_.size()) {
+        // 计数归零之后 run() 可能已经返回，此后只能访问 ctx
+        ctx->done(finished);
+        return;
+      }
+      node = next;
+    }
+  }
+
+  private:
+  ThreadPool& pool_;
+  Priority priority_;
+  std::vector<Task> tasks_;
+  std::vector<std::pair<NodeId, NodeId>> edges_;  // (前驱, 后继)
+  bool compiled_ = false;
+  // 编译之后的图
+  std::vector<std::size_t> offsets_;  // 第i个节点的后继是 successors_[offsets_[i], offsets_[i + 1])
+  std::vector<NodeId> successors_;
+  std::vector<std::uint32_t> indegree_;
+  std::vector<NodeId> roots_;
+  std::unique_ptr<std::atomic<std::uint32_t>[]> counters_;
+  std::shared_ptr<detail::ParallelContext> ctx_;
+  // 非 STEALING 模式的就绪队列和执行者
+  bool stealing_ = false;
+  std::unique_ptr<BoundedQueue<NodeId>> ready_;
+  std::size_t executorLimit_ = 1;
+  std::atomic<std::size_t> executors_ = {0};
+};
+
+}  // namespace threadpool
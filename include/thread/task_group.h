@@ -0,0 +1,91 @@
+#pragma once
+
+#include <exception>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "thread/parallel.h"
+#include "thread/threadpool.h"
+
+namespace threadpool {
+
+/**
+ * @brief 一组 fork-join 任务，用一个原子计数器跟踪还没有完成的任务
+ * 任务不产生 future，结果通过捕获的引用写回；wait() 在等待时帮忙执行线程池中排队的任务，
+ * 所以可以在工作线程中递归地创建和等待任务组，不会因为工作线程都在等待而死锁，也不会额外创建线程。
+ * 任务抛出的第一个异常在 wait() 中重新抛出，出现异常之后还没有开始的任务不再执行。
+ */
+class TaskGroup {
+  public:
+  explicit TaskGroup(ThreadPool& pool, Priority priority = Priority::PRIORITY_NORMAL)
+      : pool_(pool),
+        priority_(priority),
+        ctx_(std::make_shared<detail::ParallelContext>()) {}
+
+  // 析构时等待所有任务完成，异常被丢弃，需要异常时先调用 wait()
+  ~TaskGroup() {
+    try {
+      wait();
+    } catch (...) {
+    }
+  }
+
+  // non-copy
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+
+  /**
+   * @brief 提交一个任务，和 submit 一样参数以左值的形式传给 f，返回值被忽略
+   * 在这个线程池的工作线程中调用并且队列已满时，任务直接在当前线程上执行：
+   * 递归的 fork-join 中所有工作线程都可能在提交，等待空位会互相等待而死锁
+   */
+  template <class F, class... Args>
+  void run(F&& f, Args&&... args) {
+    ctx_->add(1);
+    ThreadPool::Task task(
+        [ctx = ctx_, f = std::forward<F>(f), ... args = std::forward<Args>(args)]() mutable {
+          ctx->run([&]() { std::invoke(f, args...); });
+          ctx->done();
+        });
+    if (ThreadPool::current() != &pool_) {
+      pool_.post(std::move(task), priority_);
+    } else if (!pool_.try_post(task, priority_)) {
+      task();
+    }
+  }
+
+  /**
+   * @brief 在当前线程上执行 f，然后等待整个任务组，fork-join 中最后一个分支不需要提交
+   */
+  template <class F>
+  void run_and_wait(F&& f) {
+    ctx_->run(std::forward<F>(f));
+    wait();
+  }
+
+  /**
+   * @brief 等待所有已经提交的任务完成，然后重新抛出第一个异常
+   * 等待期间在当前线程上执行线程池中排队的任务(不一定属于这个任务组)，没有任务可执行时才阻塞；
+   * 返回之后任务组可以继续使用
+   */
+  void wait() {
+    try {
+      ctx_->wait(pool_, true);
+    } catch (...) {
+      // 异常只抛出一次，换一个新的状态让任务组可以重新使用
+      ctx_ = std::make_shared<detail::ParallelContext>();
+      throw;
+    }
+  }
+
+  // 有任务抛出了异常，还没有开始的任务会被跳过
+  bool is_canceling() const { return ctx_->failed(); }
+
+  private:
+  ThreadPool& pool_;
+  Priority priority_;
+  std::shared_ptr<detail::ParallelContext> ctx_;
+};
+
+}  // namespace threadpool
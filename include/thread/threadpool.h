@@ -1,34 +1,112 @@
 #pragma once
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <coroutine>
 #include <cstdint>
 #include <functional>
 #include <future>
 #include <memory>
 #include <mutex>
+#include <ranges>
+#include <stop_token>
 #include <thread>
+#include <type_traits>
+#include <vector>
 #include "thread/thread.h"
 
-#include "function/function.h"
+#include "function/unique_function.h"
+#include "future/slab_allocator.h"
+#include "future/task_future.h"
 #include "minilog/minilog.h"
 #include "queue/lockfree_queue.h"
+#include "queue/task_queue.h"
 #include "queue/wait_strategy.h"
+#include "queue/work_stealing_queue.h"
+#include "timer/timer_wheel.h"
 namespace threadpool {
+namespace detail {
+// 可取消的任务：f 的第一个参数能接收 std::stop_token 时把令牌传给它，用于轮询是否被取消
+template <class F, class... Args>
+struct StoppableResult {
+  using type = std::invoke_result_t<F, Args...>;
+};
+
+template <class F, class... Args>
+  requires std::is_invocable_v<F, std::stop_token, Args...>
+struct StoppableResult<F, Args...> {
+  using type = std::invoke_result_t<F, std::stop_token, Args...>;
+};
+
+template <class F, class... Args>
+using stoppable_result_t = typename StoppableResult<F, Args...>::type;
+}  // namespace detail
+
 namespace config {
 static constexpr const int TASK_MAX_THRESHOLD = 60;
 static constexpr const int THREAD_MAX_THRESHOLD = 12;
 static constexpr const int THREAD_MAX_IDLE_SECOND = 3;
+static constexpr const int TASK_BATCH_SIZE = 8;  // 工作线程一次最多取出的任务数
+static constexpr const int PRIORITY_WEIGHT_HIGH = 4;    // 加权轮转中每轮从各优先级取出的批次
+static constexpr const int PRIORITY_WEIGHT_NORMAL = 2;
+static constexpr const int PRIORITY_WEIGHT_LOW = 1;
+static constexpr const int PRIORITY_AGING_THRESHOLD = 16;  // 非空的低优先级队列最多连续被跳过的次数
+static constexpr const int TIMER_TICK_MS = 1;  // 定时任务的精度
+static constexpr const int HELP_SPIN_COUNT = 64;  // help_until 没有任务可执行时，让出cpu之前的自旋次数
 }  // namespace config
 
 enum class PoolMode : uint8_t {
   MODE_FIXED,   // 固定数量
   MODE_CACHED,  // 动态增长
+  MODE_STEALING,  // 固定数量，每个线程持有本地队列并互相窃取任务
+  MODE_LOCKFREE,  // 固定数量，提交和取任务只依赖无锁队列及其等待策略
+  MODE_DEADLINE,  // 固定数量，按截止时间最早优先(EDF)执行，过期的任务直接丢弃
+};
+
+enum class Priority : uint8_t {
+  PRIORITY_HIGH,    // 延迟敏感的任务
+  PRIORITY_NORMAL,  // 默认优先级，和 submit(f, args...) 相同
+  PRIORITY_LOW,     // 后台的批量任务
+};
+
+enum class PriorityPolicy : uint8_t {
+  POLICY_STRICT,    // 总是先取优先级最高的非空队列
+  POLICY_WEIGHTED,  // 按权重轮流取各个优先级的队列
+};
+
+enum class QueueMode : uint8_t {
+  QUEUE_BOUNDED,    // 有界无锁队列，任务数达到阈值时提交方等待
+  QUEUE_UNBOUNDED,  // 分段的无界无锁队列，突发的任务不会阻塞提交方，积压消化后内存归还
 };
 
 class ThreadPool {
   public:
-  using Task = Function<void()>;
-  ThreadPool();
+  using Task = UniqueFunction<void()>;
+  using Clock = std::chrono::steady_clock;
+  using TimerId = TimerWheel::TimerId;
+
+  // 一次性定时任务的句柄，id 用于 cancel_timer
+  template <class T>
+  struct Scheduled {
+    TimerId id;
+    TaskFuture<T> future;
+  };
+
+  // schedule() 返回的等待体，挂起的协程作为一个普通任务提交，在工作线程上恢复
+  struct ScheduleAwaitable {
+    ThreadPool* pool;
+    Priority priority;
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+      pool->post([handle]() { handle.resume(); }, priority);
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  explicit ThreadPool(QueueMode queue = QueueMode::QUEUE_BOUNDED);
   ~ThreadPool();
   // non-copy
   ThreadPool(const ThreadPool&) = delete;
@@ -38,54 +116,330 @@ class ThreadPool {
   void setMode(PoolMode mod);
   void setTaskThreshold(int threshold);
   void setThreadThreshold(int threshold);
+  // 优先级只在 FIXED 和 CACHED 模式下生效，其他模式按普通任务处理
+  void setPriorityPolicy(PriorityPolicy policy);
+  void setPriorityWeight(Priority priority, int weight);
+  // threshold 为0时关闭老化，严格优先级下低优先级的任务可能一直得不到执行
+  void setPriorityAging(int threshold);
 
   // 提交task
   template <class F, class... Args>
-  auto submit(F&& f, Args&&... args) -> std::future<typename std::invoke_result_t<F, Args...>> {
+  auto submit(F&& f, Args&&... args) -> TaskFuture<typename std::invoke_result_t<F, Args...>> {
+    return submit(Priority::PRIORITY_NORMAL, std::forward<F>(f), std::forward<Args>(args)...);
+  }
+
+  /**
+   * @brief 按优先级提交task，每个优先级一个有界队列，工作线程按 PriorityPolicy 选择队列
+   */
+  template <class F, class... Args>
+  auto submit(Priority priority, F&& f, Args&&... args)
+      -> TaskFuture<typename std::invoke_result_t<F, Args...>> {
+    using RetType = typename std::invoke_result_t<F, Args...>;
+    // 共享状态从slab中分配，promise 随任务一起放进 Task 的内部缓冲区
+    TaskPromise<RetType> promise(slab_);
+    TaskFuture<RetType> result = promise.get_future();
+    // 和 std::bind 一样，参数以左值的形式传给 f
+    Task task([promise = std::move(promise), f = std::forward<F>(f),
+               ... args = std::forward<Args>(args)]() mutable { promise.run(f, args...); });
+    dispatch(std::move(task), priority);
+    return result;
+  }
+
+  /**
+   * @brief 提交可取消的task，令牌和 std::jthread 一样来自 std::stop_source
+   * 轮到执行时已经被取消的任务不会运行，future 得到 TaskCancelledError 异常；
+   * f 的第一个参数能接收 std::stop_token 时，令牌会传给 f，长时间运行的任务可以自行轮询
+   */
+  template <class F, class... Args>
+  auto submit(std::stop_token token, F&& f, Args&&... args)
+      -> TaskFuture<detail::stoppable_result_t<F, Args...>> {
+    return submit(Priority::PRIORITY_NORMAL, std::move(token), std::forward<F>(f),
+                  std::forward<Args>(args)...);
+  }
+
+  template <class F, class... Args>
+  auto submit(Priority priority, std::stop_token token, F&& f, Args&&... args)
+      -> TaskFuture<detail::stoppable_result_t<F, Args...>> {
+    using RetType = detail::stoppable_result_t<F, Args...>;
+    TaskPromise<RetType> promise(slab_);
+    TaskFuture<RetType> result = promise.get_future();
+    Task task([this, token = std::move(token), promise = std::move(promise),
+               f = std::forward<F>(f), ... args = std::forward<Args>(args)]() mutable {
+      if (token.stop_requested()) {
+        cancelledTasks_.fetch_add(1, std::memory_order_relaxed);
+        promise.set_exception(std::make_exception_ptr(TaskCancelledError()));
+        return;
+      }
+      if constexpr (std::is_invocable_v<F, std::stop_token, Args...>) {
+        promise.run(f, token, args...);
+      } else {
+        promise.run(f, args...);
+      }
+    });
+    dispatch(std::move(task), priority);
+    return result;
+  }
+
+  // 因为取消而没有执行的任务数量
+  std::uint64_t cancelledTaskCount() const {
+    return cancelledTasks_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief 提交带截止时间的task，到截止时间还没有开始执行的任务不再执行，
+   * future 得到 TaskExpiredError 异常。
+   * MODE_DEADLINE 下按截止时间从早到晚执行，其他模式只在执行前检查是否过期
+   */
+  template <class F, class... Args>
+  auto submit_with_deadline(Clock::time_point deadline, F&& f, Args&&... args)
+      -> TaskFuture<typename std::invoke_result_t<F, Args...>> {
+    using RetType = typename std::invoke_result_t<F, Args...>;
+    TaskPromise<RetType> promise(slab_);
+    TaskFuture<RetType> result = promise.get_future();
+    DeadlineTask task([promise = std::move(promise), f = std::forward<F>(f),
+                       ... args = std::forward<Args>(args)](bool expired) mutable {
+      if (expired) {
+        promise.set_exception(std::make_exception_ptr(TaskExpiredError()));
+        return;
+      }
+      promise.run(f, args...);
+    });
+    submitDeadline(deadline, std::move(task));
+    return result;
+  }
+
+  /**
+   * @brief 在 when 时刻把task交给线程池执行，等待期间不占用工作线程
+   * 定时器由单独的时间轮线程管理，到期后按当前模式提交到普通队列
+   */
+  template <class F, class... Args>
+  auto schedule_at(Clock::time_point when, F&& f, Args&&... args)
+      -> Scheduled<typename std::invoke_result_t<F, Args...>> {
     using RetType = typename std::invoke_result_t<F, Args...>;
-    auto task = std::make_shared<std::packaged_task<RetType()>>(
-        std::bind(std::forward<F>(f), std::forward<Args>(args)...));
-    std::future<RetType> result = task->get_future();
-
-    // lock
-    std::unique_lock<std::mutex> lock(mtx_);
-    // submit
-    while (!notFull_.wait_for(lock, std::chrono::seconds(1),
-                              [&]() -> bool { return TaskQueue_.size() < taskThreshold_; })) {
-      minilog::log_warn("task queue is full,thread id {} submit task fail, try again",
-                        convertThreadId(std::this_thread::get_id()));
+    TaskPromise<RetType> promise(slab_);
+    TaskFuture<RetType> result = promise.get_future();
+    Task task([promise = std::move(promise), f = std::forward<F>(f),
+               ... args = std::forward<Args>(args)]() mutable { promise.run(f, args...); });
+    TimerId id = scheduleTimer(when, Clock::duration::zero(), std::move(task));
+    return {id, std::move(result)};
+  }
+
+  // 延迟 delay 之后执行
+  template <class F, class... Args>
+  auto schedule_after(Clock::duration delay, F&& f, Args&&... args)
+      -> Scheduled<typename std::invoke_result_t<F, Args...>> {
+    return schedule_at(Clock::now() + delay, std::forward<F>(f), std::forward<Args>(args)...);
+  }
+
+  /**
+   * @brief 每隔 period 执行一次，第一次在 period 之后，直到 cancel_timer
+   * 每次到期提交一个新的任务，返回值被忽略，异常只记录日志；
+   * 上一次还没有执行完或者错过的周期直接跳过，不会补上
+   */
+  template <class F, class... Args>
+  TimerId schedule_every(Clock::duration period, F&& f, Args&&... args) {
+    Task task([f = std::forward<F>(f), ... args = std::forward<Args>(args)]() mutable {
+      try {
+        std::invoke(f, args...);
+      } catch (const std::exception& e) {
+        minilog::log_warn("periodic task throw exception: {}", e.what());
+      } catch (...) {
+        minilog::log_warn("periodic task throw unknown exception");
+      }
+    });
+    return scheduleTimer(Clock::now() + period, period, std::move(task));
+  }
+
+  /**
+   * @brief 取消定时任务
+   * 一次性任务只能在到期之前取消，取消后它的 future 得到 broken_promise；
+   * 周期任务取消后不会再提交，已经提交的那一次照常执行
+   */
+  bool cancel_timer(TimerId id);
+
+  // 因为过期而没有执行的任务数量
+  std::uint64_t expiredTaskCount() const { return expiredTasks_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief 批量提交，range 中的每个元素都是无参的可调用对象
+   * 整批任务只加一次锁(或一次批量入队)，只通知一次
+   *
+   * @param range 可调用对象的区间，右值区间中的元素会被移走，否则拷贝
+   * @return 和 range 中元素顺序一致的 future
+   */
+  template <class Range>
+  auto submit_bulk(Range&& range)
+      -> std::vector<TaskFuture<std::invoke_result_t<std::ranges::range_value_t<Range>&>>> {
+    using Fn = std::ranges::range_value_t<Range>;
+    using RetType = std::invoke_result_t<Fn&>;
+    std::vector<TaskFuture<RetType>> results;
+    std::vector<Task> tasks;
+    if constexpr (std::ranges::sized_range<Range>) {
+      results.reserve(std::ranges::size(range));
+      tasks.reserve(std::ranges::size(range));
     }
+    for (auto&& fn : range) {
+      TaskPromise<RetType> promise(slab_);
+      results.emplace_back(promise.get_future());
+      if constexpr (std::is_rvalue_reference_v<Range&&>) {
+        tasks.emplace_back([promise = std::move(promise), f = Fn(std::move(fn))]() mutable {
+          promise.run(f);
+        });
+      } else {
+        tasks.emplace_back([promise = std::move(promise), f = Fn(fn)]() mutable { promise.run(f); });
+      }
+    }
+    submitBulk(tasks.data(), tasks.size());
+    return results;
+  }
 
-    // push task
-    // minilog::log_info("submit task to thread pool.");
-    TaskQueue_.enqueue([task]() { (*task)(); });
-    taskSize_++;
-    // 通知分配线程执行任务
-    notEmpty_.notify_all();
-
-    // cached模式，根据任务数量和空闲线程的数量，判断是否需要创建新的线程出来
-    if (mod_ == PoolMode::MODE_CACHED && taskSize_ > idleThreadSize_ &&
-        curTheadSize_ < threadSizeThreshHold_) {
-      // 创建新的线程
-      auto thread_ptr =
-          std::make_unique<Thread>(std::bind(&ThreadPool::newThread, this, std::placeholders::_1));
-      int threadID = thread_ptr->getID();
-      // push to pool
-      pool_.emplace(threadID, std::move(thread_ptr));
-      // minilog::log_info("create new thread, id {}.", threadID);
-      pool_[threadID]->start();
-      curTheadSize_++;
-      idleThreadSize_++;
+  /**
+   * @brief 批量提交 count 个任务，第 i 个任务执行 f(i)，f 会被拷贝到每个任务中
+   */
+  template <class F>
+  auto submit_n(std::size_t count, F&& f)
+      -> std::vector<TaskFuture<std::invoke_result_t<std::decay_t<F>&, std::size_t&>>> {
+    using RetType = std::invoke_result_t<std::decay_t<F>&, std::size_t&>;
+    std::vector<TaskFuture<RetType>> results;
+    std::vector<Task> tasks;
+    results.reserve(count);
+    tasks.reserve(count);
+    for (std::size_t i = 0; i < count; i++) {
+      TaskPromise<RetType> promise(slab_);
+      results.emplace_back(promise.get_future());
+      tasks.emplace_back(
+          [promise = std::move(promise), f = std::decay_t<F>(f), i]() mutable { promise.run(f, i); });
     }
-    return result;
+    submitBulk(tasks.data(), tasks.size());
+    return results;
+  }
+
+  /**
+   * @brief 提交不需要结果的任务，没有 future 的开销
+   * task 不能抛出异常，需要结果或者异常时使用 submit
+   */
+  void post(Task task, Priority priority = Priority::PRIORITY_NORMAL) {
+    dispatch(std::move(task), priority);
   }
 
+  /**
+   * @brief 和 post 一样提交任务，但是队列已满时不等待空位，直接返回 false
+   * 失败时 task 保持不变，可以重试或者由调用方自行处理(例如在当前线程上执行)；
+   * STEALING 模式下工作线程提交到没有容量限制的本地队列，总是成功
+   */
+  bool try_post(Task& task, Priority priority = Priority::PRIORITY_NORMAL);
+
+  /**
+   * @brief 从线程池的工作线程提交任务，队列已满时帮忙执行排队中的任务直到腾出空位
+   * 任务总是排队执行，不会在当前线程上直接执行；等待空位的工作线程自己也在取任务，
+   * 所有工作线程同时提交也不会死锁。不是这个线程池的工作线程时和 post 相同
+   */
+  void post_or_help(Task task, Priority priority = Priority::PRIORITY_NORMAL) {
+    if (current() != this) {
+      post(std::move(task), priority);
+      return;
+    }
+    help_until([&]() { return try_post(task, priority); });
+  }
+
+  /**
+   * @brief 在协程中 co_await pool.schedule()，之后的代码在工作线程上继续执行
+   * 只提交一个捕获协程句柄的任务，没有 future 和共享状态
+   */
+  ScheduleAwaitable schedule(Priority priority = Priority::PRIORITY_NORMAL) {
+    return ScheduleAwaitable{this, priority};
+  }
+
+  /**
+   * @brief 在当前线程上执行一个排队中的任务，等待其他任务时用来帮忙而不是阻塞
+   * STEALING 模式下工作线程优先取自己的本地队列，外部线程从注入队列取或者窃取
+   *
+   * @return false 当前没有可执行的任务
+   */
+  bool run_pending_task();
+
+  /**
+   * @brief 帮忙执行排队中的任务直到 pred() 为真，没有任务可执行时先自旋，再让出cpu
+   * 用于等待已经提交到线程池的工作，在工作线程中调用也不会死锁
+   */
+  template <class Pred>
+  void help_until(Pred pred) {
+    int idle = 0;
+    while (!pred()) {
+      if (run_pending_task()) {
+        idle = 0;
+      } else if (idle++ < config::HELP_SPIN_COUNT) {
+        wait_strategy::CpuRelax();
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  // 当前线程所属的线程池，不是工作线程时返回 nullptr
+  static ThreadPool* current();
+
+  PoolMode mode() const { return mod_; }
+  // future 的共享状态使用的slab，strand 等执行器的节点也从这里分配
+  SlabAllocator* slab() const { return slab_; }
+  // 当前的工作线程数量
+  int threadSize() const { return curTheadSize_.load(std::memory_order_relaxed); }
+
   void start(int initThreadSize = std::thread::hardware_concurrency() / 4);
 
   private:
   void newThread(int threadid);
   bool isRunning() const;
   uint32_t convertThreadId(std::thread::id id);
+  // FIXED 和 CACHED 模式下加锁提交到对应优先级的队列
+  void submitTask(Task task, Priority priority);
+  // 任务已经放入优先级队列，计数、唤醒并按需扩容，调用时需持有 mtx_
+  void onEnqueued();
+  // 有界队列中的任务数达到阈值，调用时需持有 mtx_
+  bool isFull(Priority priority = Priority::PRIORITY_NORMAL);
+  // cached模式下创建新的线程，调用时需持有 mtx_
+  void addCachedThread();
+
+  // 批量提交，成功入队的任务会被移走
+  void submitBulk(Task* tasks, std::size_t count);
+  // 工作线程一次取出的任务数，按线程数平分队列中的任务，避免一个线程把任务全部取走
+  std::uint64_t batchSize(Priority priority = Priority::PRIORITY_NORMAL);
+
+  // priority lanes，调用时需持有 mtx_
+  std::uint64_t laneSize(Priority priority);
+  bool laneEnqueue(Priority priority, Task&& task);
+  // 按照策略和老化计数选出本次取任务的队列，至少有一个队列非空
+  Priority selectLane();
+  std::uint64_t dequeuePriority(Task* tasks, std::uint64_t max_count = config::TASK_BATCH_SIZE);
+
+  // work stealing
+  void stealingThread(int threadid, int index);
+  struct TaskBox;
+  TaskBox* boxTask(Task&& task);
+  void unboxTask(TaskBox* box);
+  void submitStealing(Task task);
+  // 有线程在睡眠时唤醒一个
+  void wakeStealing();
+  // index 为-1时表示外部线程，没有本地队列
+  bool popStealing(int index, TaskBox** task);
+  bool hasStealingTask();
+
+  // lock free
+  void lockfreeThread(int threadid);
+  void submitLockFree(Task task);
+
+  // deadline，参数表示任务是否已经过期
+  using DeadlineTask = UniqueFunction<void(bool)>;
+  void deadlineThread(int threadid);
+  void submitDeadline(Clock::time_point deadline, DeadlineTask task);
+  // 放入截止时间堆，调用时需持有 mtx_
+  void pushDeadline(Clock::time_point deadline, DeadlineTask task);
+  void runDeadline(Clock::time_point deadline, DeadlineTask& task);
+
+  // timer
+  TimerId scheduleTimer(Clock::time_point when, Clock::duration period, Task task);
+  // 按当前模式提交任务，优先级只在 FIXED 和 CACHED 模式下生效
+  void dispatch(Task task, Priority priority = Priority::PRIORITY_NORMAL);
 
   private:
   // init
@@ -97,7 +451,7 @@ class ThreadPool {
   std::atomic<int> idleThreadSize_;
   // task queue
   // std::queue<Task> TaskQueue_;
-  BoundedQueue<Task> TaskQueue_;
+  TaskQueue<Task> TaskQueue_;
 
   std::atomic<int> taskSize_;
   int taskThreshold_;
@@ -109,6 +463,43 @@ class ThreadPool {
 
   PoolMode mod_;
   std::atomic<bool> running_;
+
+  // MODE_STEALING: 每个工作线程一个本地双端队列, TaskQueue_ 作为外部提交的注入队列
+  std::vector<std::unique_ptr<WorkStealingQueue<TaskBox*>>> localQueues_;
+  std::atomic<int> sleepingThreadSize_;
+
+  // TaskFuture 共享状态的内存池，引用计数管理，可能比线程池活得更久
+  SlabAllocator* slab_;
+
+  // 高、低优先级的队列，普通优先级直接使用 TaskQueue_
+  static constexpr int kPriorityCount = 3;
+  BoundedQueue<Task> highQueue_;
+  BoundedQueue<Task> lowQueue_;
+  PriorityPolicy priorityPolicy_;
+  int priorityWeights_[kPriorityCount];
+  int priorityAging_;
+  // 以下调度状态受 mtx_ 保护
+  int priorityCredits_[kPriorityCount];  // 加权轮转中本轮剩余的批次
+  int priorityStarved_[kPriorityCount];  // 非空却被更高优先级跳过的次数
+
+  // MODE_DEADLINE: 按截止时间排序的小顶堆，受 mtx_ 保护
+  struct DeadlineEntry {
+    Clock::time_point deadline;
+    std::uint64_t seq;  // 截止时间相同时先提交的先执行
+    DeadlineTask task;
+  };
+  struct DeadlineLater {
+    bool operator()(const DeadlineEntry& a, const DeadlineEntry& b) const {
+      return a.deadline > b.deadline || (a.deadline == b.deadline && a.seq > b.seq);
+    }
+  };
+  std::vector<DeadlineEntry> deadlineQueue_;
+  std::uint64_t deadlineSeq_;
+  std::atomic<std::uint64_t> expiredTasks_;
+  std::atomic<std::uint64_t> cancelledTasks_;
+
+  // 定时任务，第一次使用时才启动时间轮线程
+  TimerWheel timer_;
 };
 
 };  // namespace threadpool
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "function/unique_function.h"
+
+namespace threadpool {
+
+/**
+ * @brief 分层时间轮
+ * 4层，每层256个槽位，以tick为单位覆盖 2^32 个tick(1ms的tick约49天)，更远的定时器在最高层反复降级。
+ * 槽位是侵入式的双向链表，插入和取消都是O(1)；定时器节点放在deque中按下标复用，
+ * 定时器id带有版本号，节点复用之后旧的id自动失效。
+ * 到期的回调在专门的线程上、在锁外执行，回调应该尽快返回(例如只是把任务交给线程池)。
+ */
+class TimerWheel {
+  public:
+  using Clock = std::chrono::steady_clock;
+  using Callback = UniqueFunction<void()>;
+  using TimerId = std::uint64_t;
+  static constexpr TimerId kInvalidTimer = 0;
+
+  explicit TimerWheel(Clock::duration tick = std::chrono::milliseconds(1));
+  ~TimerWheel();
+  // non-copy
+  TimerWheel(const TimerWheel&) = delete;
+  TimerWheel& operator=(const TimerWheel&) = delete;
+
+  // 启动时间轮线程，重复调用无效
+  void start();
+  // 停止时间轮线程，没有到期的定时器直接丢弃
+  void stop();
+
+  /**
+   * @brief 添加定时器
+   *
+   * @param when 第一次到期的时间，已经过去的时间在下一个tick到期
+   * @param period 为0时只执行一次，否则按周期重复执行，错过的周期不会补上
+   * @param callback 到期时在时间轮线程上调用
+   * @return TimerId 用于取消
+   */
+  TimerId add(Clock::time_point when, Clock::duration period, Callback callback);
+
+  /**
+   * @brief 取消定时器
+   *
+   * @return true 定时器不会再被触发
+   * @return false id无效，或者一次性的定时器已经在执行
+   */
+  bool cancel(TimerId id);
+
+  // 还没有到期或者周期执行的定时器数量
+  std::size_t size();
+
+  private:
+  static constexpr int kLevels = 4;
+  static constexpr int kSlotBits = 8;
+  static constexpr std::uint64_t kSlots = 1 << kSlotBits;
+  static constexpr std::uint64_t kSlotMask = kSlots - 1;
+  static constexpr std::uint64_t kMaxDelta = (1ULL << (kLevels * kSlotBits)) - 1;
+
+  enum NodeState : std::uint8_t {
+    kFree,
+    kPending,  // 挂在某个槽位上
+    kFiring,   // 已经摘下，回调正在锁外执行
+  };
+
+  struct Node {
+    Node* prev = nullptr;
+    Node* next = nullptr;
+    Node** slot = nullptr;  // 所在槽位的链表头，摘除时使用
+    std::uint64_t expire = 0;  // 到期的tick
+    std::uint64_t period = 0;  // 周期，单位tick
+    std::uint32_t index = 0;
+    std::uint32_t generation = 1;
+    std::uint8_t level = 0;
+    NodeState state = kFree;
+    bool cancelled = false;  // 执行期间被取消
+    Callback callback;
+  };
+
+  void run();
+  // 以下调用时需持有 mtx_
+  std::uint64_t tickOf(Clock::time_point time, bool round_up) const;
+  void link(Node* node);
+  void unlink(Node* node);
+  void cascade(int level);
+  // 前进一个tick，到期的节点摘下放入 firing_
+  void advance();
+  void release(Node* node, std::vector<Callback>* garbage);
+
+  private:
+  const Clock::duration tick_;
+  const Clock::time_point start_;
+  std::uint64_t now_ = 0;  // 已经处理完的tick
+  Node* wheel_[kLevels][kSlots] = {};
+  std::deque<Node> nodes_;  // deque扩容不会移动已有的节点
+  std::vector<std::uint32_t> freeNodes_;
+  std::vector<Node*> firing_;
+  std::size_t pending_ = 0;
+  std::size_t nearCount_ = 0;  // 第0层的节点数，为0时线程可以一直睡到下一次降级
+  std::uint64_t wakeTick_ = UINT64_MAX;  // 线程睡眠的目标tick，更早到期的定时器需要唤醒线程
+
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::thread thread_;
+  bool running_ = false;
+};
+
+}  // namespace threadpool
@@ -1,5 +1,6 @@
 #include "thread/threadpool.h"
 
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
 #include <cstdint>
@@ -13,7 +14,24 @@
 
 namespace threadpool {
 
-ThreadPool::ThreadPool()
+namespace {
+// 当前线程所属的线程池和本地队列下标，用于判断任务是否由工作线程提交
+thread_local ThreadPool* tls_pool = nullptr;
+thread_local int tls_index = -1;
+thread_local uint32_t tls_seed = 0;
+
+// xorshift，用于随机挑选窃取对象
+uint32_t nextRandom() {
+  uint32_t x = tls_seed;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  tls_seed = x;
+  return x;
+}
+}  // namespace
+
+ThreadPool::ThreadPool(QueueMode queue)
     : initThreadSize_(0),
       taskSize_(0),
       idleThreadSize_(0),
@@ -21,15 +39,46 @@ ThreadPool::ThreadPool()
       taskThreshold_(config::TASK_MAX_THRESHOLD),
       threadSizeThreshHold_(config::THREAD_MAX_THRESHOLD),
       mod_(PoolMode::MODE_FIXED),
-      running_(false) {
-  TaskQueue_.Init(config::TASK_MAX_THRESHOLD);
+      running_(false),
+      sleepingThreadSize_(0),
+      slab_(new SlabAllocator()),
+      priorityPolicy_(PriorityPolicy::POLICY_STRICT),
+      priorityWeights_{config::PRIORITY_WEIGHT_HIGH, config::PRIORITY_WEIGHT_NORMAL,
+                       config::PRIORITY_WEIGHT_LOW},
+      priorityAging_(config::PRIORITY_AGING_THRESHOLD),
+      priorityCredits_{},
+      priorityStarved_{},
+      deadlineSeq_(0),
+      expiredTasks_(0),
+      cancelledTasks_(0),
+      timer_(std::chrono::milliseconds(config::TIMER_TICK_MS)) {
+  highQueue_.Init(config::TASK_MAX_THRESHOLD, new wait_strategy::TimeoutBlockStrategy(), true);
+  lowQueue_.Init(config::TASK_MAX_THRESHOLD, new wait_strategy::TimeoutBlockStrategy(), true);
+  if (queue == QueueMode::QUEUE_UNBOUNDED) {
+    TaskQueue_.InitUnbounded(new wait_strategy::TimeoutBlockStrategy());
+    return;
+  }
+  // 任务数量由 taskThreshold_ 限制，容量向上取整为2的幂只是为了用掩码计算下标
+  TaskQueue_.InitBounded(config::TASK_MAX_THRESHOLD, new wait_strategy::TimeoutBlockStrategy(),
+                         true);
 }
 
 ThreadPool::~ThreadPool() {
+  // 先停止时间轮，之后不会再有定时任务提交进来
+  timer_.stop();
   running_ = false;
   std::unique_lock<std::mutex> lock(mtx_);
   notEmpty_.notify_all();
-  exit_.wait(lock, [&]() -> bool { return pool_.size() == 0; });
+  if (mod_ == PoolMode::MODE_LOCKFREE) {
+    // setQueueWaitStrategy 换上的等待策略不一定记录打断状态，通知可能丢失，所以周期性地重新打断等待
+    do {
+      TaskQueue_.BreakAllWait();
+    } while (!exit_.wait_for(lock, std::chrono::milliseconds(10),
+                             [&]() -> bool { return pool_.size() == 0; }));
+  } else {
+    exit_.wait(lock, [&]() -> bool { return pool_.size() == 0; });
+  }
+  slab_->release();
   // minilog::log_info("Thread Pool destroy.");
 }
 
@@ -56,6 +105,27 @@ void ThreadPool::setThreadThreshold(int threshold) {
   }
 }
 
+void ThreadPool::setPriorityPolicy(PriorityPolicy policy) {
+  if (isRunning()) {
+    return;
+  }
+  priorityPolicy_ = policy;
+}
+
+void ThreadPool::setPriorityWeight(Priority priority, int weight) {
+  if (isRunning()) {
+    return;
+  }
+  priorityWeights_[static_cast<int>(priority)] = std::max(weight, 1);
+}
+
+void ThreadPool::setPriorityAging(int threshold) {
+  if (isRunning()) {
+    return;
+  }
+  priorityAging_ = std::max(threshold, 0);
+}
+
 void ThreadPool::setQueueWaitStrategy(wait_strategy::WaitStrategy* strategy) {
   if (isRunning()) {
     return;
@@ -69,12 +139,29 @@ void ThreadPool::start(int initThreadSize) {
     return;
   }
   running_ = true;
+  // 核数较少时 hardware_concurrency() / 4 可能为0，至少保证一个线程
+  if (initThreadSize <= 0) {
+    initThreadSize = 1;
+  }
   // 创建初始线程
   initThreadSize_ = initThreadSize;
   curTheadSize_ = initThreadSize;
   for (int i = 0; i < initThreadSize_; i++) {
-    auto thread_ptr =
-        std::make_unique<Thread>(std::bind(&ThreadPool::newThread, this, std::placeholders::_1));
+    std::unique_ptr<Thread> thread_ptr;
+    if (mod_ == PoolMode::MODE_STEALING) {
+      localQueues_.emplace_back(std::make_unique<WorkStealingQueue<TaskBox*>>());
+      thread_ptr = std::make_unique<Thread>(
+          std::bind(&ThreadPool::stealingThread, this, std::placeholders::_1, i));
+    } else if (mod_ == PoolMode::MODE_LOCKFREE) {
+      thread_ptr = std::make_unique<Thread>(
+          std::bind(&ThreadPool::lockfreeThread, this, std::placeholders::_1));
+    } else if (mod_ == PoolMode::MODE_DEADLINE) {
+      thread_ptr = std::make_unique<Thread>(
+          std::bind(&ThreadPool::deadlineThread, this, std::placeholders::_1));
+    } else {
+      thread_ptr =
+          std::make_unique<Thread>(std::bind(&ThreadPool::newThread, this, std::placeholders::_1));
+    }
     int threadID = thread_ptr->getID();
     pool_.emplace(threadID, std::move(thread_ptr));
     // minilog::log_info("create new thread, id {}.", threadID);
@@ -88,17 +175,19 @@ void ThreadPool::start(int initThreadSize) {
 }
 
 void ThreadPool::newThread(int threadid) {
+  tls_pool = this;
   auto baseline = std::chrono::high_resolution_clock::now();
   uint32_t tid = convertThreadId(std::this_thread::get_id());
+  Task tasks[config::TASK_BATCH_SIZE];
   while (true) {
-    Task task;
+    std::uint64_t count = 0;
     {
       std::unique_lock<std::mutex> lock(mtx_);
       // minilog::log_info("tid: {} try get task", tid);
       //  cached下，可能动态创建许多线程，但是如果空闲时间超过1min，就会被销毁
       //  主要销毁多出去threshold的线程
 
-      while (TaskQueue_.empty()) {
+      while (taskSize_ == 0) {
         if (!running_) {
           pool_.erase(threadid);
           // minilog::log_info("thread id: {} exit.", threadid);
@@ -128,29 +217,597 @@ void ThreadPool::newThread(int threadid) {
         }
       }
       // minilog::log_info("tid: {} get Task", tid);
-      // get task
-      TaskQueue_.dequeue(&task);
-      taskSize_--;
-      if (!TaskQueue_.empty()) {
+      // get task，按优先级选出队列，一次取出一批，减少加锁次数
+      count = dequeuePriority(tasks);
+      taskSize_ -= static_cast<int>(count);
+      if (taskSize_ > 0) {
         notEmpty_.notify_all();
       }
-      // 取出一个任务，进行通知，通知可以继续提交生产任务
+      // 取出任务，进行通知，通知可以继续提交生产任务
       notFull_.notify_all();
     }
     // 执行任务 minilog::log_info("tid: {} do task", tid);
     idleThreadSize_--;
-    if (task != nullptr) {
-      task();
+    for (std::uint64_t i = 0; i < count; i++) {
+      Task task = std::move(tasks[i]);
+      if (task != nullptr) {
+        task();
+      }
     }
     idleThreadSize_++;
     baseline = std::chrono::high_resolution_clock::now();  // 更新时间
   }
 }
 
+void ThreadPool::addCachedThread() {
+  auto thread_ptr =
+      std::make_unique<Thread>(std::bind(&ThreadPool::newThread, this, std::placeholders::_1));
+  int threadID = thread_ptr->getID();
+  // push to pool
+  pool_.emplace(threadID, std::move(thread_ptr));
+  // minilog::log_info("create new thread, id {}.", threadID);
+  pool_[threadID]->start();
+  curTheadSize_++;
+  idleThreadSize_++;
+}
+
+void ThreadPool::submitTask(Task task, Priority priority) {
+  if (mod_ == PoolMode::MODE_DEADLINE) {
+    // 没有截止时间的任务排在所有带截止时间的任务之后
+    submitDeadline(Clock::time_point::max(),
+                   DeadlineTask([task = std::move(task)](bool) mutable { task(); }));
+    return;
+  }
+  // lock
+  std::unique_lock<std::mutex> lock(mtx_);
+  // submit，阈值大于队列容量时入队也可能失败，同样等待工作线程取走任务
+  while (isFull(priority) || !laneEnqueue(priority, std::move(task))) {
+    if (notFull_.wait_for(lock, std::chrono::seconds(1)) == std::cv_status::timeout) {
+      minilog::log_warn("task queue is full,thread id {} submit task fail, try again",
+                        convertThreadId(std::this_thread::get_id()));
+    }
+  }
+  onEnqueued();
+}
+
+void ThreadPool::onEnqueued() {
+  taskSize_++;
+  // 通知分配线程执行任务
+  notEmpty_.notify_all();
+
+  // cached模式，根据任务数量和空闲线程的数量，判断是否需要创建新的线程出来
+  if (mod_ == PoolMode::MODE_CACHED && taskSize_ > idleThreadSize_ &&
+      curTheadSize_ < threadSizeThreshHold_) {
+    // 创建新的线程
+    addCachedThread();
+  }
+}
+
+bool ThreadPool::try_post(Task& task, Priority priority) {
+  if (mod_ == PoolMode::MODE_STEALING) {
+    if (tls_pool == this) {
+      // 本地队列没有容量限制
+      submitStealing(std::move(task));
+      return true;
+    }
+    if (!TaskQueue_.enqueue(std::move(task))) {
+      return false;
+    }
+    wakeStealing();
+    return true;
+  }
+  if (mod_ == PoolMode::MODE_LOCKFREE) {
+    return TaskQueue_.enqueue(std::move(task));
+  }
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (mod_ == PoolMode::MODE_DEADLINE) {
+    if (deadlineQueue_.size() >= static_cast<std::size_t>(taskThreshold_)) {
+      return false;
+    }
+    pushDeadline(Clock::time_point::max(),
+                 DeadlineTask([task = std::move(task)](bool) mutable { task(); }));
+    return true;
+  }
+  if (isFull(priority) || !laneEnqueue(priority, std::move(task))) {
+    return false;
+  }
+  onEnqueued();
+  return true;
+}
+
+bool ThreadPool::isFull(Priority priority) {
+  if (priority == Priority::PRIORITY_NORMAL && !TaskQueue_.bounded()) {
+    return false;
+  }
+  return laneSize(priority) >= static_cast<std::uint64_t>(taskThreshold_);
+}
+
+std::uint64_t ThreadPool::batchSize(Priority priority) {
+  std::uint64_t threads = std::max(curTheadSize_.load(), 1);
+  return std::clamp<std::uint64_t>(laneSize(priority) / threads, 1, config::TASK_BATCH_SIZE);
+}
+
+std::uint64_t ThreadPool::laneSize(Priority priority) {
+  switch (priority) {
+    case Priority::PRIORITY_HIGH:
+      return highQueue_.size();
+    case Priority::PRIORITY_LOW:
+      return lowQueue_.size();
+    default:
+      return TaskQueue_.size();
+  }
+}
+
+bool ThreadPool::laneEnqueue(Priority priority, Task&& task) {
+  switch (priority) {
+    case Priority::PRIORITY_HIGH:
+      return highQueue_.enqueue(std::move(task));
+    case Priority::PRIORITY_LOW:
+      return lowQueue_.enqueue(std::move(task));
+    default:
+      return TaskQueue_.enqueue(std::move(task));
+  }
+}
+
+Priority ThreadPool::selectLane() {
+  bool ready[kPriorityCount];
+  for (int i = 0; i < kPriorityCount; i++) {
+    ready[i] = laneSize(static_cast<Priority>(i)) > 0;
+  }
+  int lane = -1;
+  // 老化：连续被跳过太多次的低优先级队列优先，避免饥饿
+  if (priorityAging_ > 0) {
+    for (int i = kPriorityCount - 1; i > 0 && lane < 0; i--) {
+      if (ready[i] && priorityStarved_[i] >= priorityAging_) {
+        lane = i;
+      }
+    }
+  }
+  if (lane < 0 && priorityPolicy_ == PriorityPolicy::POLICY_WEIGHTED) {
+    for (int round = 0; round < 2 && lane < 0; round++) {
+      for (int i = 0; i < kPriorityCount && lane < 0; i++) {
+        if (ready[i] && priorityCredits_[i] > 0) {
+          lane = i;
+        }
+      }
+      if (lane < 0) {
+        // 非空队列的额度都已用完，开始新的一轮
+        std::copy(priorityWeights_, priorityWeights_ + kPriorityCount, priorityCredits_);
+      }
+    }
+    if (lane >= 0) {
+      priorityCredits_[lane]--;
+    }
+  }
+  for (int i = 0; i < kPriorityCount && lane < 0; i++) {
+    if (ready[i]) {
+      lane = i;
+    }
+  }
+  if (lane < 0) {
+    return Priority::PRIORITY_NORMAL;
+  }
+  for (int i = lane + 1; i < kPriorityCount; i++) {
+    if (ready[i]) {
+      priorityStarved_[i]++;
+    }
+  }
+  priorityStarved_[lane] = 0;
+  return static_cast<Priority>(lane);
+}
+
+std::uint64_t ThreadPool::dequeuePriority(Task* tasks, std::uint64_t max_count) {
+  Priority lane = selectLane();
+  std::uint64_t count = std::min(batchSize(lane), max_count);
+  switch (lane) {
+    case Priority::PRIORITY_HIGH:
+      return highQueue_.dequeue_bulk(tasks, count);
+    case Priority::PRIORITY_LOW:
+      return lowQueue_.dequeue_bulk(tasks, count);
+    default:
+      return TaskQueue_.dequeue_bulk(tasks, count);
+  }
+}
+
+void ThreadPool::submitBulk(Task* tasks, std::size_t count) {
+  if (count == 0) {
+    return;
+  }
+  if (mod_ == PoolMode::MODE_STEALING) {
+    auto wakeup = [this]() {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (sleepingThreadSize_.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        notEmpty_.notify_all();
+      }
+    };
+    if (tls_pool == this) {
+      for (std::size_t i = 0; i < count; i++) {
+        localQueues_[tls_index]->push(boxTask(std::move(tasks[i])));
+      }
+      wakeup();
+      return;
+    }
+    // 注入队列容量有限，每入队一批就唤醒一次，否则休眠的线程不会腾出空间
+    for (std::size_t done = 0; done < count;) {
+      std::uint64_t n = TaskQueue_.enqueue_bulk(tasks + done, count - done);
+      if (n == 0) {
+        std::this_thread::yield();
+        continue;
+      }
+      done += n;
+      wakeup();
+    }
+    return;
+  }
+  if (mod_ == PoolMode::MODE_DEADLINE) {
+    for (std::size_t i = 0; i < count; i++) {
+      submitTask(std::move(tasks[i]), Priority::PRIORITY_NORMAL);
+    }
+    return;
+  }
+  if (mod_ == PoolMode::MODE_LOCKFREE) {
+    for (std::size_t done = 0; done < count;) {
+      std::uint64_t n = TaskQueue_.enqueue_bulk(tasks + done, count - done);
+      if (n == 0) {
+        std::this_thread::yield();
+      }
+      done += n;
+    }
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(mtx_);
+  for (std::size_t done = 0; done < count;) {
+    while (!notFull_.wait_for(lock, std::chrono::seconds(1), [&]() -> bool { return !isFull(); })) {
+      minilog::log_warn("task queue is full,thread id {} submit task fail, try again",
+                        convertThreadId(std::this_thread::get_id()));
+    }
+    std::uint64_t room = count - done;
+    if (TaskQueue_.bounded()) {
+      room = static_cast<std::uint64_t>(taskThreshold_) - TaskQueue_.size();
+    }
+    std::uint64_t n = TaskQueue_.enqueue_bulk(tasks + done, std::min<std::uint64_t>(room, count - done));
+    if (n == 0) {
+      // 阈值大于队列容量，等待工作线程取走任务
+      notFull_.wait(lock);
+      continue;
+    }
+    done += n;
+    taskSize_ += static_cast<int>(n);
+    notEmpty_.notify_all();
+
+    if (mod_ == PoolMode::MODE_CACHED && taskSize_ > idleThreadSize_ &&
+        curTheadSize_ < threadSizeThreshHold_) {
+      addCachedThread();
+    }
+  }
+}
+
+struct ThreadPool::TaskBox {
+  explicit TaskBox(Task&& t)
+      : task(std::move(t)) {}
+
+  Task task;
+  std::uint32_t index = SlabAllocator::kInvalidIndex;  // slab中的下标，堆分配时为 kInvalidIndex
+};
+
+// 本地队列只能存放指针，装箱用的内存和共享状态一样从slab中申请，稳定之后提交任务不再走堆分配
+ThreadPool::TaskBox* ThreadPool::boxTask(Task&& task) {
+  return slab_->create<TaskBox>(std::move(task));
+}
+
+void ThreadPool::unboxTask(TaskBox* box) { slab_->destroy(box); }
+
+void ThreadPool::submitStealing(Task task) {
+  if (tls_pool == this) {
+    // 工作线程提交的任务直接放入本地队列，无需任何锁
+    localQueues_[tls_index]->push(boxTask(std::move(task)));
+  } else {
+    // 外部线程提交的任务按值放入注入队列
+    while (!TaskQueue_.enqueue(std::move(task))) {
+      std::this_thread::yield();
+    }
+  }
+  wakeStealing();
+}
+
+void ThreadPool::wakeStealing() {
+  // 与 stealingThread 中的 sleepingThreadSize_++ 构成 Dekker 式同步，避免丢失唤醒
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleepingThreadSize_.load(std::memory_order_relaxed) > 0) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    notEmpty_.notify_one();
+  }
+}
+
+bool ThreadPool::popStealing(int index, TaskBox** task) {
+  // 1. 本地队列(LIFO，缓存友好)
+  if (index >= 0 && localQueues_[index]->pop(task)) {
+    return true;
+  }
+  // 2. 注入队列，一次取出一批，多出来的放进本地队列，其他线程可以窃取
+  Task injected[config::TASK_BATCH_SIZE];
+  std::uint64_t count = TaskQueue_.dequeue_bulk(injected, index >= 0 ? batchSize() : 1);
+  if (count > 0) {
+    for (std::uint64_t i = 1; i < count; i++) {
+      localQueues_[index]->push(boxTask(std::move(injected[i])));
+    }
+    *task = boxTask(std::move(injected[0]));
+    return true;
+  }
+  // 3. 从随机的受害者开始依次尝试窃取
+  int size = static_cast<int>(localQueues_.size());
+  if (size == 0) {
+    return false;
+  }
+  int start = static_cast<int>(nextRandom() % size);
+  for (int i = 0; i < size; i++) {
+    int victim = (start + i) % size;
+    if (victim != index && localQueues_[victim]->steal(task)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ThreadPool::hasStealingTask() {
+  if (!TaskQueue_.empty()) {
+    return true;
+  }
+  for (const auto& queue : localQueues_) {
+    if (!queue->empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::stealingThread(int threadid, int index) {
+  tls_pool = this;
+  tls_index = index;
+  tls_seed = convertThreadId(std::this_thread::get_id()) | 1;
+  while (true) {
+    TaskBox* box = nullptr;
+    if (popStealing(index, &box)) {
+      if (box->task != nullptr) {
+        box->task();
+      }
+      unboxTask(box);
+      continue;
+    }
+    // 没有可执行的任务，休眠等待
+    std::unique_lock<std::mutex> lock(mtx_);
+    sleepingThreadSize_++;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool hasTask = hasStealingTask();
+    if (!hasTask && !running_) {
+      sleepingThreadSize_--;
+      pool_.erase(threadid);
+      exit_.notify_all();
+      return;
+    }
+    if (!hasTask) {
+      notEmpty_.wait(lock);
+    }
+    sleepingThreadSize_--;
+  }
+}
+
+void ThreadPool::submitLockFree(Task task) {
+  // 队列满说明工作线程都在忙，让出cpu即可；入队成功后由等待策略唤醒至多一个线程
+  while (!TaskQueue_.enqueue(std::move(task))) {
+    std::this_thread::yield();
+  }
+}
+
+void ThreadPool::lockfreeThread(int threadid) {
+  tls_pool = this;
+  Task tasks[config::TASK_BATCH_SIZE];
+  while (true) {
+    // 先批量取，队列为空时再按等待策略等待单个任务
+    std::uint64_t count = TaskQueue_.dequeue_bulk(tasks, batchSize());
+    if (count == 0 && TaskQueue_.wait_dequeue(&tasks[0])) {
+      count = 1;
+    }
+    if (count > 0) {
+      for (std::uint64_t i = 0; i < count; i++) {
+        Task task = std::move(tasks[i]);
+        if (task != nullptr) {
+          task();
+        }
+      }
+      continue;
+    }
+    // 等待超时或被打断
+    if (!running_) {
+      // 退出前执行完剩余的任务
+      Task task;
+      while (TaskQueue_.dequeue(&task)) {
+        if (task != nullptr) {
+          task();
+        }
+      }
+      std::lock_guard<std::mutex> lock(mtx_);
+      pool_.erase(threadid);
+      exit_.notify_all();
+      return;
+    }
+  }
+}
+
+void ThreadPool::submitDeadline(Clock::time_point deadline, DeadlineTask task) {
+  if (mod_ != PoolMode::MODE_DEADLINE) {
+    // 其他模式不按截止时间排序，只在执行前检查是否过期
+    Task wrapped([this, deadline, task = std::move(task)]() mutable {
+      bool expired = Clock::now() > deadline;
+      if (expired) {
+        expiredTasks_.fetch_add(1, std::memory_order_relaxed);
+      }
+      task(expired);
+    });
+    dispatch(std::move(wrapped));
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(mtx_);
+  while (!notFull_.wait_for(lock, std::chrono::seconds(1), [&]() -> bool {
+    return deadlineQueue_.size() < static_cast<std::size_t>(taskThreshold_);
+  })) {
+    minilog::log_warn("task queue is full,thread id {} submit task fail, try again",
+                      convertThreadId(std::this_thread::get_id()));
+  }
+  pushDeadline(deadline, std::move(task));
+}
+
+void ThreadPool::pushDeadline(Clock::time_point deadline, DeadlineTask task) {
+  deadlineQueue_.push_back(DeadlineEntry{deadline, deadlineSeq_++, std::move(task)});
+  std::push_heap(deadlineQueue_.begin(), deadlineQueue_.end(), DeadlineLater());
+  taskSize_++;
+  notEmpty_.notify_all();
+}
+
+void ThreadPool::runDeadline(Clock::time_point deadline, DeadlineTask& task) {
+  bool expired = Clock::now() > deadline;
+  if (expired) {
+    expiredTasks_.fetch_add(1, std::memory_order_relaxed);
+  }
+  task(expired);
+}
+
+void ThreadPool::deadlineThread(int threadid) {
+  tls_pool = this;
+  while (true) {
+    DeadlineTask task;
+    Clock::time_point deadline;
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      while (deadlineQueue_.empty()) {
+        if (!running_) {
+          pool_.erase(threadid);
+          exit_.notify_all();
+          return;
+        }
+        notEmpty_.wait(lock);
+      }
+      // 堆顶是截止时间最早的任务，过期的任务总是先被取出并丢弃
+      std::pop_heap(deadlineQueue_.begin(), deadlineQueue_.end(), DeadlineLater());
+      deadline = deadlineQueue_.back().deadline;
+      task = std::move(deadlineQueue_.back().task);
+      deadlineQueue_.pop_back();
+      taskSize_--;
+      notFull_.notify_all();
+    }
+    idleThreadSize_--;
+    runDeadline(deadline, task);
+    idleThreadSize_++;
+  }
+}
+
 uint32_t ThreadPool::convertThreadId(std::thread::id id) {
   std::hash<std::thread::id> hasher;
   return static_cast<uint32_t>(hasher(id));
 }
 
 bool ThreadPool::isRunning() const { return running_; }
+
+ThreadPool* ThreadPool::current() { return tls_pool; }
+
+ThreadPool::TimerId ThreadPool::scheduleTimer(Clock::time_point when, Clock::duration period,
+                                              Task task) {
+  timer_.start();
+  if (period == Clock::duration::zero()) {
+    return timer_.add(when, period, [this, task = std::move(task)]() mutable {
+      dispatch(std::move(task));
+    });
+  }
+  // 周期任务每次到期都要提交一次，可调用对象由各次提交共享；
+  // 上一次还没有执行完时跳过本次，同一个可调用对象不会被并发调用
+  struct Periodic {
+    Task fn;
+    std::atomic<bool> busy = {false};
+  };
+  auto periodic = std::make_shared<Periodic>();
+  periodic->fn = std::move(task);
+  return timer_.add(when, period, [this, periodic]() {
+    if (periodic->busy.exchange(true, std::memory_order_acquire)) {
+      return;
+    }
+    dispatch(Task([periodic]() {
+      periodic->fn();
+      periodic->busy.store(false, std::memory_order_release);
+    }));
+  });
+}
+
+bool ThreadPool::cancel_timer(TimerId id) { return timer_.cancel(id); }
+
+void ThreadPool::dispatch(Task task, Priority priority) {
+  if (mod_ == PoolMode::MODE_STEALING) {
+    submitStealing(std::move(task));
+  } else if (mod_ == PoolMode::MODE_LOCKFREE) {
+    submitLockFree(std::move(task));
+  } else {
+    submitTask(std::move(task), priority);
+  }
+}
+
+bool ThreadPool::run_pending_task() {
+  if (mod_ == PoolMode::MODE_STEALING) {
+    if (tls_pool != this && tls_seed == 0) {
+      tls_seed = convertThreadId(std::this_thread::get_id()) | 1;
+    }
+    TaskBox* box = nullptr;
+    if (!popStealing(tls_pool == this ? tls_index : -1, &box)) {
+      return false;
+    }
+    if (box->task != nullptr) {
+      box->task();
+    }
+    unboxTask(box);
+    return true;
+  }
+  if (mod_ == PoolMode::MODE_LOCKFREE) {
+    Task task;
+    if (!TaskQueue_.dequeue(&task)) {
+      return false;
+    }
+    if (task != nullptr) {
+      task();
+    }
+    return true;
+  }
+  if (mod_ == PoolMode::MODE_DEADLINE) {
+    DeadlineTask task;
+    Clock::time_point deadline;
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      if (deadlineQueue_.empty()) {
+        return false;
+      }
+      std::pop_heap(deadlineQueue_.begin(), deadlineQueue_.end(), DeadlineLater());
+      deadline = deadlineQueue_.back().deadline;
+      task = std::move(deadlineQueue_.back().task);
+      deadlineQueue_.pop_back();
+      taskSize_--;
+      notFull_.notify_all();
+    }
+    runDeadline(deadline, task);
+    return true;
+  }
+  Task task;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (taskSize_ == 0 || dequeuePriority(&task, 1) == 0) {
+      return false;
+    }
+    taskSize_--;
+    notFull_.notify_all();
+  }
+  if (task != nullptr) {
+    task();
+  }
+  return true;
+}
+
 }  // namespace threadpool
\ No newline at end of file
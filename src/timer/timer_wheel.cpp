@@ -0,0 +1,260 @@
+#include "timer/timer_wheel.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace threadpool {
+
+TimerWheel::TimerWheel(Clock::duration tick)
+    : tick_(std::max<Clock::duration>(tick, Clock::duration(1))),
+      start_(Clock::now()) {}
+
+TimerWheel::~TimerWheel() { stop(); }
+
+void TimerWheel::start() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (running_) {
+    return;
+  }
+  running_ = true;
+  thread_ = std::thread(&TimerWheel::run, this);
+}
+
+void TimerWheel::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!running_) {
+      return;
+    }
+    running_ = false;
+    cv_.notify_all();
+  }
+  thread_.join();
+  // 回调可能持有其他对象，在锁外析构
+  std::vector<Callback> garbage;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (auto& level : wheel_) {
+      for (Node*& head : level) {
+        while (head != nullptr) {
+          Node* node = head;
+          unlink(node);
+          release(node, &garbage);
+        }
+      }
+    }
+  }
+}
+
+TimerWheel::TimerId TimerWheel::add(Clock::time_point when, Clock::duration period,
+                                    Callback callback) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (pending_ == 0) {
+    // 时间轮空闲时线程不会推进，先追上当前时间
+    now_ = std::max(now_, tickOf(Clock::now(), false));
+  }
+  Node* node = nullptr;
+  if (freeNodes_.empty()) {
+    node = &nodes_.emplace_back();
+    node->index = static_cast<std::uint32_t>(nodes_.size() - 1);
+  } else {
+    node = &nodes_[freeNodes_.back()];
+    freeNodes_.pop_back();
+  }
+  node->expire = std::max(tickOf(when, true), now_ + 1);
+  node->period = 0;
+  if (period > Clock::duration::zero()) {
+    node->period = std::max<std::uint64_t>((period + tick_ - Clock::duration(1)) / tick_, 1);
+  }
+  node->cancelled = false;
+  node->callback = std::move(callback);
+  link(node);
+  if (pending_++ == 0 || node->expire < wakeTick_) {
+    cv_.notify_one();
+  }
+  return (static_cast<TimerId>(node->generation) << 32) | (node->index + 1);
+}
+
+bool TimerWheel::cancel(TimerId id) {
+  std::uint64_t index = (id & 0xFFFFFFFF) - 1;
+  auto generation = static_cast<std::uint32_t>(id >> 32);
+  Callback garbage;
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (id == kInvalidTimer || index >= nodes_.size()) {
+    return false;
+  }
+  Node* node = &nodes_[index];
+  if (node->generation != generation || node->state == kFree || node->cancelled) {
+    return false;
+  }
+  if (node->state == kFiring) {
+    // 回调正在执行，只能阻止周期定时器下一次触发
+    if (node->period == 0) {
+      return false;
+    }
+    node->cancelled = true;
+    pending_--;
+    return true;
+  }
+  unlink(node);
+  garbage = std::move(node->callback);
+  node->state = kFree;
+  node->generation++;
+  freeNodes_.push_back(node->index);
+  pending_--;
+  return true;
+}
+
+std::size_t TimerWheel::size() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return pending_;
+}
+
+std::uint64_t TimerWheel::tickOf(Clock::time_point time, bool round_up) const {
+  if (time <= start_) {
+    return 0;
+  }
+  auto elapsed = time - start_;
+  if (round_up) {
+    elapsed += tick_ - Clock::duration(1);
+  }
+  return static_cast<std::uint64_t>(elapsed / tick_);
+}
+
+void TimerWheel::link(Node* node) {
+  // 按离到期还有多远选择层级，超过时间轮范围的先放在最高层
+  std::uint64_t expire = std::max(node->expire, now_);
+  std::uint64_t delta = std::min(expire - now_, kMaxDelta);
+  int level = 0;
+  while (level < kLevels - 1 && delta >= (1ULL << ((level + 1) * kSlotBits))) {
+    level++;
+  }
+  if (expire - now_ > kMaxDelta) {
+    expire = now_ + kMaxDelta;
+  }
+  Node** slot = &wheel_[level][(expire >> (level * kSlotBits)) & kSlotMask];
+  node->slot = slot;
+  node->level = static_cast<std::uint8_t>(level);
+  if (level == 0) {
+    nearCount_++;
+  }
+  node->prev = nullptr;
+  node->next = *slot;
+  if (*slot != nullptr) {
+    (*slot)->prev = node;
+  }
+  *slot = node;
+  node->state = kPending;
+}
+
+void TimerWheel::unlink(Node* node) {
+  if (node->level == 0) {
+    nearCount_--;
+  }
+  if (node->prev != nullptr) {
+    node->prev->next = node->next;
+  } else {
+    *node->slot = node->next;
+  }
+  if (node->next != nullptr) {
+    node->next->prev = node->prev;
+  }
+  node->prev = nullptr;
+  node->next = nullptr;
+  node->slot = nullptr;
+}
+
+void TimerWheel::cascade(int level) {
+  Node*& head = wheel_[level][(now_ >> (level * kSlotBits)) & kSlotMask];
+  while (head != nullptr) {
+    Node* node = head;
+    unlink(node);
+    link(node);
+  }
+}
+
+void TimerWheel::advance() {
+  now_++;
+  // 低层转完一圈时，把高层当前槽位的定时器重新分配到低层
+  for (int level = kLevels - 1; level > 0; level--) {
+    if ((now_ & ((1ULL << (level * kSlotBits)) - 1)) == 0) {
+      cascade(level);
+    }
+  }
+  Node*& head = wheel_[0][now_ & kSlotMask];
+  while (head != nullptr) {
+    Node* node = head;
+    unlink(node);
+    if (node->expire > now_) {
+      // 超出范围而被截断的定时器，还没有真正到期
+      link(node);
+      continue;
+    }
+    node->state = kFiring;
+    firing_.push_back(node);
+  }
+}
+
+void TimerWheel::release(Node* node, std::vector<Callback>* garbage) {
+  garbage->push_back(std::move(node->callback));
+  node->state = kFree;
+  node->generation++;
+  freeNodes_.push_back(node->index);
+}
+
+void TimerWheel::run() {
+  std::vector<Node*> firing;
+  std::vector<Callback> garbage;
+  std::unique_lock<std::mutex> lock(mtx_);
+  while (running_) {
+    if (pending_ == 0) {
+      cv_.wait(lock, [&]() -> bool { return !running_ || pending_ > 0; });
+      continue;
+    }
+    std::uint64_t target = tickOf(Clock::now(), false);
+    if (target <= now_) {
+      // 第0层为空时，下一次可能有定时器到期的时刻是低层转完一圈
+      wakeTick_ = nearCount_ > 0 ? now_ + 1 : (now_ | kSlotMask) + 1;
+      cv_.wait_until(lock, start_ + tick_ * wakeTick_);
+      wakeTick_ = UINT64_MAX;
+      continue;
+    }
+    while (now_ < target) {
+      if (nearCount_ == 0) {
+        // 第0层为空，直接跳到下一次降级之前，中间的tick没有定时器到期
+        now_ = std::min(target - 1, now_ | kSlotMask);
+      }
+      advance();
+    }
+    if (firing_.empty()) {
+      continue;
+    }
+    firing.swap(firing_);
+    lock.unlock();
+    // 节点在deque中的地址不变，执行期间只有 cancelled 可能被修改
+    for (Node* node : firing) {
+      node->callback();
+    }
+    lock.lock();
+    for (Node* node : firing) {
+      if (node->period == 0) {
+        pending_--;
+        release(node, &garbage);
+      } else if (node->cancelled) {
+        release(node, &garbage);
+      } else {
+        // 周期执行，错过的周期直接跳过
+        node->expire = std::max(node->expire + node->period, now_ + 1);
+        link(node);
+      }
+    }
+    firing.clear();
+    if (!garbage.empty()) {
+      lock.unlock();
+      garbage.clear();
+      lock.lock();
+    }
+  }
+}
+
+}  // namespace threadpool
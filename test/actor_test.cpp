@@ -0,0 +1,186 @@
+#define ANKERL_NANOBENCH_IMPLEMENT
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <doctest.h>
+#include <nanobench.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "thread/actor.h"
+#include "thread/threadpool.h"
+#include "test_util.h"
+
+namespace {
+struct Account {
+  std::atomic<bool> running = false;
+  int overlaps = 0;
+  int disorder = 0;
+  int last[4] = {};
+  long long balance = 0;
+};
+
+struct Deposit {
+  int producer;
+  int seq;
+  int amount;
+};
+}  // namespace
+
+// NOLINTNEXTLINE
+TEST_CASE("actor test") {
+  // 同一个 actor 的消息互斥处理，同一个发送者的消息按顺序处理
+  constexpr int kActors = 64;
+  constexpr int kProducers = 3;
+  constexpr int kPerProducer = 2000;
+  for (auto mode : test_util::kModes) {
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 4, 1024);
+    std::vector<Account> accounts(kActors);
+    std::vector<std::unique_ptr<threadpool::Actor<Deposit>>> actors;
+    for (int i = 0; i < kActors; i++) {
+      Account* account = &accounts[i];
+      actors.push_back(std::make_unique<threadpool::Actor<Deposit>>(
+          pool,
+          [account](Deposit& d) {
+            if (account->running.exchange(true)) {
+              account->overlaps++;
+            }
+            account->disorder += account->last[d.producer] >= d.seq ? 1 : 0;
+            account->last[d.producer] = d.seq;
+            account->balance += d.amount;
+            account->running = false;
+          },
+          i % 2 == 0 ? 1 : threadpool::config::ACTOR_BATCH_SIZE));
+    }
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; p++) {
+      producers.emplace_back([&, p]() {
+        for (int i = 1; i <= kPerProducer; i++) {
+          actors[(i * 7 + p) % kActors]->send(Deposit{p, i, 1});
+        }
+      });
+    }
+    for (auto& t : producers) {
+      t.join();
+    }
+    // 析构时等待信箱清空
+    actors.clear();
+    int overlaps = 0;
+    int disorder = 0;
+    long long total = 0;
+    for (auto& account : accounts) {
+      overlaps += account.overlaps;
+      disorder += account.disorder;
+      total += account.balance;
+    }
+    CHECK(overlaps == 0);
+    CHECK(disorder == 0);
+    CHECK(total == kProducers * kPerProducer);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("actor test") {
+  // 只能移动的消息、处理函数中给自己和其他 actor 发消息、异常只记录日志
+  threadpool::ThreadPool pool;
+  test_util::startPool(pool, threadpool::PoolMode::MODE_STEALING, 2);
+  std::vector<std::string> log;
+  std::atomic<bool> done = false;
+  threadpool::Actor<std::unique_ptr<std::string>> printer(pool, [&](std::unique_ptr<std::string>& s) {
+    if (*s == "throw") {
+      throw std::runtime_error("ignored");
+    }
+    log.push_back(*s);
+    if (*s == "end") {
+      done = true;
+    }
+  });
+  threadpool::Actor<int> counter(pool, [&](int& n) {
+    if (n > 0) {
+      printer.send(std::make_unique<std::string>(std::to_string(n)));
+      counter.send(n - 1);
+    } else {
+      printer.send(std::make_unique<std::string>("end"));
+    }
+  });
+  printer.send(std::make_unique<std::string>("throw"));
+  counter.send(3);
+  while (!done) {
+    std::this_thread::yield();
+  }
+  CHECK(log == std::vector<std::string>{"3", "2", "1", "end"});
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("actor test") {
+  // 大量空闲的 actor 不占用线程池，每个 actor 的开销很小；只有收到消息的 actor 被调度
+  constexpr int kActors = 1000000;
+  constexpr int kActive = 1000;
+  CHECK(sizeof(threadpool::Actor<int>) <= 96);
+  threadpool::ThreadPool pool(threadpool::QueueMode::QUEUE_UNBOUNDED);
+  test_util::startPool(pool, threadpool::PoolMode::MODE_LOCKFREE, 4);
+  std::atomic<int> received = 0;
+  std::deque<threadpool::Actor<int>> actors;
+  for (int i = 0; i < kActors; i++) {
+    actors.emplace_back(pool, [&received](int& n) { received += n; });
+  }
+  for (int i = 0; i < kActive; i++) {
+    actors[i * (kActors / kActive)].send(1);
+  }
+  while (received != kActive) {
+    pool.run_pending_task();
+  }
+  actors.clear();
+  CHECK(received == kActive);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("actor bench") {
+  // 1000 个 actor 上的消息：每条消息一个线程池任务加锁，和按批处理的信箱
+  constexpr int kActors = 1000;
+  constexpr int kMessages = 100000;
+  threadpool::ThreadPool pool(threadpool::QueueMode::QUEUE_UNBOUNDED);
+  test_util::startPool(pool, threadpool::PoolMode::MODE_STEALING, 4);
+  std::vector<std::mutex> locks(kActors);
+  std::vector<long long> counters(kActors, 0);
+  std::atomic<int> remaining = 0;
+  std::vector<std::unique_ptr<threadpool::Actor<int>>> actors;
+  for (int i = 0; i < kActors; i++) {
+    long long* counter = &counters[i];
+    actors.push_back(std::make_unique<threadpool::Actor<int>>(pool, [counter, &remaining](int& n) {
+      *counter += n;
+      remaining--;
+    }));
+  }
+  ankerl::nanobench::Bench bench;
+  bench.relative(true).minEpochIterations(20);
+  bench.run("pool.post + mutex per actor", [&]() {
+    remaining = kMessages;
+    for (int i = 0; i < kMessages; i++) {
+      pool.post([&, key = i % kActors]() {
+        std::lock_guard<std::mutex> lock(locks[key]);
+        counters[key]++;
+        remaining--;
+      });
+    }
+    while (remaining != 0) {
+      pool.run_pending_task();
+    }
+  });
+  bench.run("actor mailbox", [&]() {
+    remaining = kMessages;
+    for (int i = 0; i < kMessages; i++) {
+      actors[i % kActors]->send(1);
+    }
+    while (remaining != 0) {
+      pool.run_pending_task();
+    }
+  });
+}
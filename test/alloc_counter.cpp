@@ -0,0 +1,77 @@
+#include "alloc_counter.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace {
+void* allocate(std::size_t size, std::size_t align) {
+  alloc_counter::allocations.fetch_add(1, std::memory_order_relaxed);
+  size = size == 0 ? 1 : size;
+  if (align <= alignof(std::max_align_t)) {
+    return std::malloc(size);
+  }
+  // aligned_alloc 要求大小是对齐的整数倍
+  return std::aligned_alloc(align, (size + align - 1) / align * align);
+}
+
+void* allocateOrThrow(std::size_t size, std::size_t align) {
+  if (void* p = allocate(size, align)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+}  // namespace
+
+// 数组、对齐和 nothrow 的版本需要一起替换，否则标准库的版本和这里的版本会混用
+void* operator new(std::size_t size) { return allocateOrThrow(size, 0); }
+
+void* operator new[](std::size_t size) { return allocateOrThrow(size, 0); }
+
+void* operator new(std::size_t size, std::align_val_t align) {
+  return allocateOrThrow(size, static_cast<std::size_t>(align));
+}
+
+void* operator new[](std::size_t size, std::align_val_t align) {
+  return allocateOrThrow(size, static_cast<std::size_t>(align));
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return allocate(size, 0); }
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return allocate(size, 0);
+}
+
+void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+  return allocate(size, static_cast<std::size_t>(align));
+}
+
+void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+  return allocate(size, static_cast<std::size_t>(align));
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete[](void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+  std::free(p);
+}
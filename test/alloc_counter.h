@@ -0,0 +1,14 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief 统计所有线程上的堆分配次数，用来确认某段代码不再分配
+ * 全局 operator new/delete 的替换在 alloc_counter.cpp 中，只链接进需要统计的测试。
+ * 替换函数放在单独的源文件里，编译器看不到它们的实现，不会在内联之后把这里的 free
+ * 和标准库的 operator new 配对而报 -Wmismatched-new-delete
+ */
+namespace alloc_counter {
+inline std::atomic<std::uint64_t> allocations = {0};
+}  // namespace alloc_counter
@@ -0,0 +1,229 @@
+#define ANKERL_NANOBENCH_IMPLEMENT
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <doctest.h>
+#include <nanobench.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "coroutine/task.h"
+#include "future/task_future.h"
+#include "thread/threadpool.h"
+#include "test_util.h"
+
+namespace {
+threadpool::Task<int> answer() { co_return 42; }
+
+threadpool::Task<std::string> nested(int depth) {
+  if (depth == 0) {
+    co_return std::string("leaf");
+  }
+  std::string inner = co_await nested(depth - 1);
+  co_return inner + "+";
+}
+
+threadpool::Task<void> fail() {
+  throw std::runtime_error("coroutine");
+  co_return;
+}
+
+// 在线程池上计算，中间等待另一个任务的 future
+threadpool::Task<int> onPool(threadpool::ThreadPool& pool, int value, std::thread::id caller) {
+  co_await pool.schedule();
+  CHECK(std::this_thread::get_id() != caller);
+  int doubled = co_await pool.submit([value]() { return value * 2; });
+  co_return doubled + co_await answer();
+}
+
+// 当前线程正在写入 promise 的结果
+thread_local bool completing = false;
+
+// 挂起之后由另一个任务写入结果，恢复时检查是否嵌套在写入结果的任务中
+threadpool::Task<bool> resumedOutside(threadpool::ThreadPool& pool) {
+  co_await pool.schedule();
+  threadpool::TaskPromise<int> promise;
+  auto future = promise.get_future();
+  pool.post([promise = std::move(promise)]() mutable {
+    // 等协程先在 future 上挂起
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    completing = true;
+    promise.set_value(1);
+    completing = false;
+  });
+  int value = co_await std::move(future);
+  co_return value == 1 && !completing;
+}
+
+// 写入结果时队列已满，恢复任务等待空位，同样不在写入结果的任务中执行；线程池需要两个线程、阈值为2
+threadpool::Task<bool> resumedOutsideFull(threadpool::ThreadPool& pool) {
+  co_await pool.schedule();
+  threadpool::TaskPromise<int> promise;
+  auto future = promise.get_future();
+  pool.post([&pool, promise = std::move(promise)]() mutable {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    // 占住另一个工作线程，再放入两个任务把队列填满
+    std::atomic<bool> started = false;
+    std::atomic<bool> release = false;
+    pool.post([&started, &release]() {
+      started = true;
+      while (!release) {
+        std::this_thread::yield();
+      }
+    });
+    while (!started) {
+      std::this_thread::yield();
+    }
+    pool.post([]() {});
+    pool.post([]() {});
+    std::thread releaser([&release]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      release = true;
+    });
+    completing = true;
+    promise.set_value(1);
+    completing = false;
+    releaser.join();
+  });
+  int value = co_await std::move(future);
+  co_return value == 1 && !completing;
+}
+
+// 深度递归，对称转移在结束时直接恢复上一层
+threadpool::Task<int> countdown(int n) {
+  if (n == 0) {
+    co_return 0;
+  }
+  co_return 1 + co_await countdown(n - 1);
+}
+}  // namespace
+
+// NOLINTNEXTLINE
+TEST_CASE("coroutine test") {
+  // 不涉及线程池的 Task：惰性启动、嵌套、异常、移动 future 之外的值
+  CHECK(threadpool::sync_wait(answer()) == 42);
+  CHECK(threadpool::sync_wait(nested(3)) == "leaf+++");
+  CHECK_THROWS_AS(threadpool::sync_wait(fail()), std::runtime_error);
+
+  bool started = false;
+  auto lazy = [&started]() -> threadpool::Task<std::unique_ptr<int>> {
+    started = true;
+    co_return std::make_unique<int>(7);
+  };
+  auto task = lazy();
+  CHECK(started == false);
+  CHECK(*threadpool::sync_wait(std::move(task)) == 7);
+  CHECK(started);
+
+  // 没有执行就销毁的 Task 释放协程帧
+  auto holder = std::make_shared<int>(0);
+  {
+    auto unused = [](std::shared_ptr<int> h) -> threadpool::Task<void> {
+      (*h)++;
+      co_return;
+    }(holder);
+    CHECK(holder.use_count() == 2);
+  }
+  CHECK(holder.use_count() == 1);
+  CHECK(*holder == 0);
+
+  CHECK(threadpool::sync_wait(countdown(1000)) == 1000);
+
+  // 等待默认构造或者被移走的 Task 抛出 no_state
+  CHECK_THROWS_AS(threadpool::sync_wait(threadpool::Task<int>()), std::future_error);
+  auto source = answer();
+  auto target = std::move(source);
+  CHECK_FALSE(source.valid());
+  CHECK_THROWS_AS(threadpool::sync_wait(std::move(source)), std::future_error);
+  CHECK(threadpool::sync_wait(std::move(target)) == 42);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("coroutine test") {
+  // schedule 切换到工作线程，co_await future 之后在线程池上恢复
+  for (auto mode : test_util::kModes) {
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 2);
+    auto caller = std::this_thread::get_id();
+    CHECK(threadpool::sync_wait(onPool(pool, 5, caller)) == 52);
+
+    // 同时运行的协程，spawn 得到的 future 可以和 when_all 组合
+    std::vector<threadpool::TaskFuture<int>> futures;
+    for (int i = 0; i < 200; i++) {
+      futures.push_back(threadpool::spawn(pool, onPool(pool, i, caller)));
+    }
+    int sum = 0;
+    for (auto& future : threadpool::when_all(std::move(futures)).get()) {
+      sum += future.get();
+    }
+    CHECK(sum == 199 * 200 + 42 * 200);
+
+    // future 中的异常在 co_await 处抛出
+    auto catcher = [&pool]() -> threadpool::Task<std::string> {
+      try {
+        co_await pool.submit([]() -> int { throw std::logic_error("inner"); });
+      } catch (const std::logic_error& e) {
+        co_return std::string(e.what());
+      }
+      co_return std::string();
+    };
+    CHECK(threadpool::sync_wait(catcher()) == "inner");
+    CHECK_THROWS_AS(threadpool::spawn(pool, fail()).get(), std::runtime_error);
+
+    // 恢复协程的任务提交到线程池，不在写入结果的任务中嵌套执行
+    CHECK(threadpool::sync_wait(resumedOutside(pool)));
+  }
+
+  for (auto mode : {threadpool::PoolMode::MODE_FIXED, threadpool::PoolMode::MODE_DEADLINE}) {
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 2, 2);
+    CHECK(threadpool::sync_wait(resumedOutsideFull(pool)));
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("coroutine bench") {
+  // 切换到工作线程再回来的开销：协程的 schedule 和 submit + get
+  constexpr int kHops = 1000;
+  for (auto mode : {threadpool::PoolMode::MODE_FIXED, threadpool::PoolMode::MODE_STEALING}) {
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 2);
+    const char* name = mode == threadpool::PoolMode::MODE_FIXED ? "FIXED" : "STEALING";
+    ankerl::nanobench::Bench bench;
+    bench.title(name).relative(true).minEpochIterations(50);
+    bench.run("1000 submit().get() round trips", [&]() {
+      int value = 0;
+      for (int i = 0; i < kHops; i++) {
+        value = pool.submit([value]() { return value + 1; }).get();
+      }
+      ankerl::nanobench::doNotOptimizeAway(value);
+    });
+    bench.run("1000 co_await submit() in one coroutine", [&]() {
+      auto hops = [&pool]() -> threadpool::Task<int> {
+        int value = 0;
+        for (int i = 0; i < kHops; i++) {
+          value = co_await pool.submit([value]() { return value + 1; });
+        }
+        co_return value;
+      };
+      ankerl::nanobench::doNotOptimizeAway(threadpool::sync_wait(hops()));
+    });
+    bench.run("1000 co_await schedule() in one coroutine", [&]() {
+      auto hops = [&pool]() -> threadpool::Task<int> {
+        int value = 0;
+        for (int i = 0; i < kHops; i++) {
+          co_await pool.schedule();
+          value++;
+        }
+        co_return value;
+      };
+      ankerl::nanobench::doNotOptimizeAway(threadpool::sync_wait(hops()));
+    });
+  }
+}
@@ -0,0 +1,129 @@
+#define ANKERL_NANOBENCH_IMPLEMENT
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <doctest.h>
+#include <nanobench.h>
+
+#include <atomic>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "alloc_counter.h"
+#include "execution/sender.h"
+#include "thread/threadpool.h"
+#include "test_util.h"
+
+namespace ex = threadpool::execution;
+
+// NOLINTNEXTLINE
+TEST_CASE("sender test") {
+  // 不涉及线程池：just、then、let_value 和异常
+  CHECK(ex::sync_wait(ex::just(20) | ex::then([](int x) { return x + 1; }) |
+                      ex::then([](int x) { return std::to_string(x * 2); })) == "42");
+  CHECK(ex::sync_wait(ex::let_value(ex::just(std::string("ab")), [](std::string& s) {
+          return ex::just(s.size()) | ex::then([&s](std::size_t n) { return s + std::to_string(n); });
+        })) == "ab2");
+  CHECK_THROWS_AS(ex::sync_wait(ex::just() | ex::then([]() -> int { throw std::runtime_error("then"); }) |
+                                ex::then([](int x) { return x; })),
+                  std::runtime_error);
+  // 没有线程池时 bulk 顺序执行
+  std::vector<int> order;
+  ex::sync_wait(ex::just() | ex::bulk(5, [&order](std::size_t i) { order.push_back(static_cast<int>(i)); }));
+  CHECK(order == std::vector<int>{0, 1, 2, 3, 4});
+  // 只能移动的值
+  auto moved = ex::sync_wait(ex::just(std::make_unique<int>(5)) |
+                             ex::then([](std::unique_ptr<int> p) { return *p + 1; }));
+  CHECK(moved == 6);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("sender test") {
+  // schedule 在工作线程上完成，bulk 并行执行，let_value 中再次调度
+  for (auto mode : test_util::kModes) {
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 4);
+    ex::PoolScheduler sched(pool);
+    auto caller = std::this_thread::get_id();
+
+    auto onWorker = sched.schedule() | ex::then([caller]() { return std::this_thread::get_id() != caller; });
+    CHECK(ex::sync_wait(std::move(onWorker)));
+
+    constexpr std::size_t kCount = 100000;
+    auto sum = ex::sync_wait(
+        sched.schedule() | ex::then([]() { return std::vector<int>(kCount, 0); }) |
+        ex::bulk(kCount, [](std::size_t i, std::vector<int>& v) { v[i] = static_cast<int>(i % 7); }) |
+        ex::then([](std::vector<int> v) { return std::accumulate(v.begin(), v.end(), 0LL); }));
+    long long expected = 0;
+    for (std::size_t i = 0; i < kCount; i++) {
+      expected += static_cast<long long>(i % 7);
+    }
+    CHECK(sum == expected);
+
+    // bulk 中的异常走 set_error，其他块尽早停止
+    std::atomic<int> calls = 0;
+    CHECK_THROWS_AS(ex::sync_wait(sched.schedule() | ex::bulk(kCount,
+                                                              [&calls](std::size_t i) {
+                                                                calls++;
+                                                                if (i == 10) {
+                                                                  throw std::logic_error("bulk");
+                                                                }
+                                                              })),
+                    std::logic_error);
+    CHECK(calls <= static_cast<int>(kCount));
+
+    auto nested = sched.schedule() | ex::then([]() { return 3; }) | ex::let_value([sched](int& n) {
+                    return sched.schedule() | ex::then([&n]() { return n * 10; });
+                  });
+    CHECK(ex::sync_wait(std::move(nested)) == 30);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("sender test") {
+  // 操作状态在 sync_wait 的栈帧中，整个流水线没有堆分配
+  for (auto mode : {threadpool::PoolMode::MODE_FIXED, threadpool::PoolMode::MODE_STEALING,
+                    threadpool::PoolMode::MODE_LOCKFREE}) {
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 4);
+    ex::PoolScheduler sched(pool);
+    std::vector<int> data(4096, 1);
+    auto pipeline = [&]() {
+      return sched.schedule() | ex::then([&data]() { return data.data(); }) |
+             ex::bulk(data.size(), [](std::size_t i, int* p) { p[i] *= 2; }) |
+             ex::let_value([sched](int* p) {
+               return sched.schedule() | ex::then([p]() { return p[0] + p[4095]; });
+             });
+    };
+    CHECK(ex::sync_wait(pipeline()) == 4);
+    // 预热之后，工作线程的批量缓冲区等都已经分配过
+    std::uint64_t before = alloc_counter::allocations.load();
+    for (int i = 0; i < 100; i++) {
+      ex::sync_wait(pipeline());
+    }
+    CHECK(alloc_counter::allocations.load() - before == 0);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("sender bench") {
+  // 一次调度到工作线程再返回：submit + future.get() 和 schedule | then + sync_wait
+  threadpool::ThreadPool pool;
+  test_util::startPool(pool, threadpool::PoolMode::MODE_FIXED, 4);
+  ex::PoolScheduler sched(pool);
+  ankerl::nanobench::Bench bench;
+  bench.relative(true).minEpochIterations(2000);
+  int value = 0;
+  bench.run("submit + future.get()", [&]() { value = pool.submit([&value]() { return value + 1; }).get(); });
+  bench.run("schedule | then + sync_wait", [&]() {
+    value = ex::sync_wait(sched.schedule() | ex::then([&value]() { return value + 1; }));
+  });
+  std::vector<int> data(1 << 16, 1);
+  bench.run("schedule | bulk(65536) + sync_wait", [&]() {
+    ex::sync_wait(sched.schedule() | ex::bulk(data.size(), [&data](std::size_t i) { data[i]++; }));
+  });
+  ankerl::nanobench::doNotOptimizeAway(value);
+}
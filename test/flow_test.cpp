@@ -0,0 +1,268 @@
+#define ANKERL_NANOBENCH_IMPLEMENT
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <doctest.h>
+#include <nanobench.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "flow/graph.h"
+#include "thread/threadpool.h"
+#include "test_util.h"
+
+namespace flow = threadpool::flow;
+
+namespace {
+// 统计复制次数的消息
+struct Token {
+  static std::atomic<int> copies;
+
+  Token() = default;
+  explicit Token(long long v)
+      : value(v) {}
+  Token(const Token& other)
+      : value(other.value) {
+    copies++;
+  }
+  Token(Token&& other) noexcept = default;
+  Token& operator=(const Token& other) {
+    value = other.value;
+    copies++;
+    return *this;
+  }
+  Token& operator=(Token&& other) noexcept = default;
+
+  long long value = 0;
+};
+
+std::atomic<int> Token::copies = 0;
+}  // namespace
+
+// NOLINTNEXTLINE
+TEST_CASE("flow graph test") {
+  // source -> function(unlimited) -> function(serial) -> sink：结果正确，消息不复制，图中的消息数有上界
+  constexpr int kCount = 20000;
+  constexpr std::size_t kCapacity = 4;
+  for (auto mode : test_util::kModes) {
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 4, 1024);
+    flow::Graph graph(pool);
+    std::atomic<int> inFlight = 0;
+    std::atomic<int> maxInFlight = 0;
+    int next = 0;
+    flow::SourceNode<Token> source(graph, [&](Token& token) {
+      if (next == kCount) {
+        return false;
+      }
+      token.value = ++next;
+      int now = ++inFlight;
+      int seen = maxInFlight.load();
+      while (now > seen && !maxInFlight.compare_exchange_weak(seen, now)) {
+      }
+      return true;
+    });
+    flow::FunctionNode<Token, Token> square(
+        graph, flow::unlimited,
+        [](Token t) {
+          t.value *= t.value;
+          return t;
+        },
+        kCapacity);
+    flow::FunctionNode<Token, Token> negate(
+        graph, flow::serial,
+        [](Token t) {
+          t.value = -t.value;
+          return t;
+        },
+        kCapacity);
+    long long sum = 0;
+    flow::SinkNode<Token> sink(
+        graph, flow::serial,
+        [&](Token t) {
+          sum += t.value;
+          inFlight--;
+        },
+        kCapacity);
+    flow::make_edge(source, square);
+    flow::make_edge(square, negate);
+    flow::make_edge(negate, sink);
+    Token::copies = 0;
+    source.activate();
+    graph.wait_for_all();
+    long long expected = 0;
+    for (long long i = 1; i <= kCount; i++) {
+      expected -= i * i;
+    }
+    CHECK(sum == expected);
+    CHECK(Token::copies == 0);
+    // 三个缓冲区，加上每个节点正在处理的消息
+    CHECK(maxInFlight <= static_cast<int>(3 * kCapacity + 2 + pool.threadSize()));
+
+    // 结束之后可以重新开始
+    next = kCount - 10;
+    sum = 0;
+    source.activate();
+    graph.wait_for_all();
+    CHECK(sum == -[&]() {
+      long long s = 0;
+      for (long long i = kCount - 9; i <= kCount; i++) {
+        s += i * i;
+      }
+      return s;
+    }());
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("flow graph test") {
+  // broadcast 到两个分支，再 join 到一起；串行的节点保持顺序，所以 join 配对的是同一个输入
+  constexpr int kCount = 5000;
+  threadpool::ThreadPool pool;
+  test_util::startPool(pool, threadpool::PoolMode::MODE_STEALING, 4);
+  flow::Graph graph(pool);
+  int next = 0;
+  flow::SourceNode<int> source(graph, [&](int& v) {
+    v = next++;
+    return v < kCount;
+  });
+  flow::BroadcastNode<int> fanout(graph, 8);
+  flow::FunctionNode<int, int> twice(graph, flow::serial, [](int v) { return v * 2; });
+  flow::FunctionNode<int, int> plusOne(graph, flow::serial, [](int v) { return v + 1; }, 2);
+  flow::JoinNode<int, int> join(graph);
+  std::vector<std::tuple<int, int>> pairs;
+  flow::SinkNode<std::tuple<int, int>> sink(graph, flow::serial,
+                                            [&](std::tuple<int, int> t) { pairs.push_back(t); });
+  flow::make_edge(source, fanout);
+  flow::make_edge(fanout, twice);
+  flow::make_edge(fanout, plusOne);
+  flow::make_edge(twice, join.input<0>());
+  flow::make_edge(plusOne, join.input<1>());
+  flow::make_edge(join, sink);
+  source.activate();
+  graph.wait_for_all();
+  REQUIRE(pairs.size() == kCount);
+  int wrong = 0;
+  for (int i = 0; i < kCount; i++) {
+    wrong += pairs[i] != std::make_tuple(i * 2, i + 1) ? 1 : 0;
+  }
+  CHECK(wrong == 0);
+
+  // 只能移动的消息
+  flow::Graph other(pool);
+  int produced = 0;
+  flow::SourceNode<std::unique_ptr<int>> ptrs(other, [&](std::unique_ptr<int>& p) {
+    p = std::make_unique<int>(produced++);
+    return produced <= 100;
+  });
+  flow::FunctionNode<std::unique_ptr<int>, std::unique_ptr<int>> inc(other, flow::unlimited,
+                                                                     [](std::unique_ptr<int> p) {
+                                                                       ++*p;
+                                                                       return p;
+                                                                     });
+  std::atomic<int> total = 0;
+  flow::SinkNode<std::unique_ptr<int>> collect(other, flow::unlimited,
+                                               [&](std::unique_ptr<int> p) { total += *p; });
+  flow::make_edge(ptrs, inc);
+  flow::make_edge(inc, collect);
+  CHECK_THROWS_AS(flow::make_edge(ptrs, collect), std::logic_error);
+  ptrs.activate();
+  other.wait_for_all();
+  CHECK(total == 5050);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("flow graph test") {
+  // 图外 try_put 在缓冲区满时失败，节点的异常在 wait_for_all 中重新抛出
+  threadpool::ThreadPool pool;
+  test_util::startPool(pool, threadpool::PoolMode::MODE_FIXED, 2);
+  flow::Graph graph(pool);
+  std::atomic<bool> started = false;
+  std::atomic<bool> release = false;
+  std::atomic<int> consumed = 0;
+  flow::SinkNode<int> slow(
+      graph, flow::serial,
+      [&](int v) {
+        if (v < 0) {
+          throw std::runtime_error("flow");
+        }
+        started = true;
+        while (!release) {
+          std::this_thread::yield();
+        }
+        consumed++;
+      },
+      2);
+  CHECK(slow.try_put(1));
+  while (!started) {
+    std::this_thread::yield();
+  }
+  CHECK(slow.try_put(2));
+  CHECK(slow.try_put(3));
+  CHECK_FALSE(slow.try_put(4));
+  release = true;
+  graph.wait_for_all();
+  CHECK(consumed == 3);
+
+  CHECK(slow.try_put(-1));
+  CHECK_THROWS_AS(graph.wait_for_all(), std::runtime_error);
+  CHECK_FALSE(graph.is_canceling());
+  CHECK(slow.try_put(5));
+  graph.wait_for_all();
+  CHECK(consumed == 4);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("flow graph bench") {
+  // 三级流水线：每一级 submit 之后等 future 再提交下一级，和 flow graph
+  constexpr int kCount = 10000;
+  threadpool::ThreadPool pool;
+  test_util::startPool(pool, threadpool::PoolMode::MODE_STEALING, 4);
+  auto stage1 = [](long long v) { return v * 3; };
+  auto stage2 = [](long long v) { return v + 7; };
+  auto stage3 = [](long long v) { return v % 1000; };
+  long long result = 0;
+  ankerl::nanobench::Bench bench;
+  bench.relative(true).minEpochIterations(10);
+  bench.run("submit + future.get() per stage", [&]() {
+    std::vector<threadpool::TaskFuture<long long>> futures;
+    futures.reserve(kCount);
+    for (int i = 0; i < kCount; i++) {
+      futures.push_back(pool.submit(stage1, i));
+    }
+    for (auto& f : futures) {
+      f = pool.submit(stage2, f.get());
+    }
+    for (auto& f : futures) {
+      f = pool.submit(stage3, f.get());
+    }
+    for (auto& f : futures) {
+      result += f.get();
+    }
+  });
+  flow::Graph graph(pool);
+  long long next = 0;
+  flow::SourceNode<long long> source(graph, [&](long long& v) {
+    v = next++;
+    return v < kCount;
+  });
+  flow::FunctionNode<long long, long long> s1(graph, flow::unlimited, stage1);
+  flow::FunctionNode<long long, long long> s2(graph, flow::unlimited, stage2);
+  flow::FunctionNode<long long, long long> s3(graph, flow::unlimited, stage3);
+  flow::SinkNode<long long> sink(graph, flow::serial, [&](long long v) { result += v; });
+  flow::make_edge(source, s1);
+  flow::make_edge(s1, s2);
+  flow::make_edge(s2, s3);
+  flow::make_edge(s3, sink);
+  bench.run("flow graph", [&]() {
+    next = 0;
+    source.activate();
+    graph.wait_for_all();
+  });
+  ankerl::nanobench::doNotOptimizeAway(result);
+}
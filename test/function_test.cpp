@@ -1,4 +1,6 @@
+#include <array>
 #include <functional>
+#include <memory>
 #define ANKERL_NANOBENCH_IMPLEMENT
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 
@@ -6,6 +8,7 @@
 #include <nanobench.h>
 
 #include "function/function.h"
+#include "function/unique_function.h"
 
 void func_hello(int i) { printf("#%d Hello\n", i); }
 
@@ -70,3 +73,74 @@ TEST_CASE("function test") {
   ankerl::nanobench::Bench().minEpochIterations(1000).run("std::function test swap",
                                                           [&]() { test(func_swap); });
 }
+
+// NOLINTNEXTLINE
+TEST_CASE("unique function test") {
+  auto test = [](UniqueFunction<int(int)> func) {
+    for (int i = 0; i < 30000; i++) {
+      int res = func(i);
+      CHECK(res == i + 1);
+    }
+  };
+  ankerl::nanobench::Bench().minEpochIterations(1000).run("unique function test add",
+                                                          [&]() { test(func_add1); });
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("unique function test") {
+  // 只能移动的仿函数
+  auto ptr = std::make_unique<int>(41);
+  UniqueFunction<int()> func([p = std::move(ptr)]() { return *p + 1; });
+  CHECK(func != nullptr);
+  CHECK(func() == 42);
+
+  UniqueFunction<int()> moved(std::move(func));
+  CHECK(func == nullptr);
+  CHECK(moved() == 42);
+  CHECK_THROWS_AS(func(), std::runtime_error);
+
+  // 超出内部缓冲区大小的仿函数退化为堆分配
+  std::array<int, 64> big{};
+  big[63] = 7;
+  UniqueFunction<int()> large([big]() { return big[63]; });
+  func = std::move(large);
+  CHECK(large == nullptr);
+  CHECK(func() == 7);
+
+  // 仿函数在析构时被释放
+  auto shared = std::make_shared<int>(0);
+  {
+    UniqueFunction<void()> holder([shared]() {});
+    CHECK(shared.use_count() == 2);
+  }
+  CHECK(shared.use_count() == 1);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("unique function test") {
+  // 返回 void 的签名可以包装有返回值的仿函数，返回值被丢弃
+  int calls = 0;
+  UniqueFunction<void()> func([&calls]() { return ++calls; });
+  func();
+  CHECK(calls == 1);
+
+  std::array<int, 64> big{};
+  UniqueFunction<void()> large([big, &calls]() { return calls += big[0] + 1; });
+  large();
+  CHECK(calls == 2);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("unique function test") {
+  int x = 0;
+  ankerl::nanobench::Bench().minEpochIterations(100000).run("Function construct and call", [&]() {
+    Function<void()> func([&x]() { x++; });
+    func();
+  });
+  ankerl::nanobench::Bench().minEpochIterations(100000).run(
+      "UniqueFunction construct and call", [&]() {
+        UniqueFunction<void()> func([&x]() { x++; });
+        func();
+      });
+  ankerl::nanobench::doNotOptimizeAway(x);
+}
@@ -0,0 +1,341 @@
+#define ANKERL_NANOBENCH_IMPLEMENT
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <doctest.h>
+#include <nanobench.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "future/slab_allocator.h"
+#include "future/task_future.h"
+#include "minilog/minilog.h"
+#include "thread/threadpool.h"
+
+// NOLINTNEXTLINE
+TEST_CASE("task future test") {
+  auto* slab = new threadpool::SlabAllocator();
+  // value
+  threadpool::TaskPromise<std::string> promise(slab);
+  threadpool::TaskFuture<std::string> future = promise.get_future();
+  CHECK(future.valid());
+  CHECK(future.is_ready() == false);
+  promise.set_value("hello");
+  CHECK(future.is_ready());
+  CHECK(future.get() == "hello");
+  CHECK(future.valid() == false);
+  CHECK_THROWS_AS(future.get(), std::future_error);
+
+  // void
+  threadpool::TaskPromise<void> void_promise(slab);
+  auto void_future = void_promise.get_future();
+  CHECK_THROWS_AS(void_promise.get_future(), std::future_error);
+  void_promise.set_value();
+  void_future.get();
+
+  // exception
+  threadpool::TaskPromise<int> error_promise(slab);
+  auto error_future = error_promise.get_future();
+  int zero = 0;
+  auto throw_func = [&]() -> int {
+    if (zero == 0) throw std::runtime_error("divide by zero");
+    return 1 / zero;
+  };
+  error_promise.run(throw_func);
+  CHECK_THROWS_AS(error_future.get(), std::runtime_error);
+
+  // broken promise
+  threadpool::TaskFuture<int> broken;
+  {
+    threadpool::TaskPromise<int> abandoned(slab);
+    broken = abandoned.get_future();
+  }
+  CHECK_THROWS_AS(broken.get(), std::future_error);
+
+  // slab 先于 future 释放
+  threadpool::TaskPromise<int> late_promise(slab);
+  auto late_future = late_promise.get_future();
+  slab->release();
+  late_promise.set_value(42);
+  CHECK(late_future.get() == 42);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("task future test") {
+  // 跨线程等待，覆盖自旋、yield和阻塞三个阶段
+  auto* slab = new threadpool::SlabAllocator();
+  for (int i = 0; i < 100; i++) {
+    threadpool::TaskPromise<int> promise(slab);
+    auto future = promise.get_future();
+    std::thread t([&promise, i]() {
+      if (i % 10 == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      promise.set_value(i);
+    });
+    CHECK(future.get() == i);
+    t.join();
+  }
+  slab->release();
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("task future test") {
+  auto* slab = new threadpool::SlabAllocator();
+  ankerl::nanobench::Bench().minEpochIterations(100).run("std::promise 10000 set and get", [&]() {
+    std::vector<std::future<int>> results;
+    results.reserve(10000);
+    for (int i = 0; i < 10000; i++) {
+      std::promise<int> promise;
+      results.emplace_back(promise.get_future());
+      promise.set_value(i);
+    }
+    for (int i = 0; i < 10000; i++) {
+      CHECK(results[i].get() == i);
+    }
+  });
+  ankerl::nanobench::Bench().minEpochIterations(100).run("TaskPromise 10000 set and get", [&]() {
+    std::vector<threadpool::TaskFuture<int>> results;
+    results.reserve(10000);
+    for (int i = 0; i < 10000; i++) {
+      threadpool::TaskPromise<int> promise(slab);
+      results.emplace_back(promise.get_future());
+      promise.set_value(i);
+    }
+    for (int i = 0; i < 10000; i++) {
+      CHECK(results[i].get() == i);
+    }
+  });
+  slab->release();
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("task future continuation test") {
+  // then 在前一个任务完成后提交到线程池，值和异常沿着链传递
+  for (auto mode : {threadpool::PoolMode::MODE_FIXED, threadpool::PoolMode::MODE_STEALING,
+                    threadpool::PoolMode::MODE_LOCKFREE}) {
+    threadpool::ThreadPool pool;
+    minilog::set_log_level(minilog::log_level::warn);
+    pool.setMode(mode);
+    pool.start(2);
+    auto chained = pool.submit([]() { return 1; })
+                       .then(pool, [](int x) { return x + 1; })
+                       .then(pool, [](int x) { return std::to_string(x * 10); })
+                       .then(pool, [](std::string s) { return s + "!"; });
+    CHECK(chained.get() == "20!");
+
+    // 前一个任务的异常跳过 f，直接传给最后的 future
+    std::atomic<int> skipped = 0;
+    auto failed = pool.submit([]() -> int { throw std::runtime_error("first"); })
+                      .then(pool, [&skipped](int x) {
+                        skipped++;
+                        return x;
+                      })
+                      .then(pool, [&skipped](int) { skipped++; });
+    CHECK_THROWS_AS(failed.get(), std::runtime_error);
+    CHECK(skipped == 0);
+
+    // 接收 future 的续体可以自己处理异常
+    auto recovered = pool.submit([]() -> int { throw std::runtime_error("first"); })
+                         .then(pool, [](threadpool::TaskFuture<int> prev) {
+                           try {
+                             return prev.get();
+                           } catch (const std::runtime_error&) {
+                             return -1;
+                           }
+                         });
+    CHECK(recovered.get() == -1);
+
+    // 已经完成的 future 上注册续体，void 结果
+    threadpool::TaskPromise<void> promise;
+    auto ready = promise.get_future();
+    promise.set_value();
+    std::atomic<bool> ran = false;
+    ready.then(pool, [&ran]() { ran = true; }).get();
+    CHECK(ran);
+    CHECK(ready.valid() == false);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("task future continuation test") {
+  // when_all 等到所有输入完成，when_any 在第一个完成时就完成，都不阻塞任何线程
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_STEALING);
+  pool.start(2);
+
+  std::vector<threadpool::TaskFuture<int>> futures;
+  for (int i = 0; i < 100; i++) {
+    futures.push_back(pool.submit([i]() {
+      if (i == 50) {
+        throw std::runtime_error("one of them");
+      }
+      return i;
+    }));
+  }
+  auto all = threadpool::when_all(std::move(futures)).get();
+  REQUIRE(all.size() == 100);
+  int sum = 0;
+  for (int i = 0; i < 100; i++) {
+    REQUIRE(all[i].is_ready());
+    if (i == 50) {
+      CHECK_THROWS_AS(all[i].get(), std::runtime_error);
+    } else {
+      sum += all[i].get();
+    }
+  }
+  CHECK(sum == 4950 - 50);
+
+  // 不同类型的 future，结果再用 then 继续处理
+  auto mixed = threadpool::when_all(pool.submit([]() { return 1; }),
+                                    pool.submit([]() { return std::string("two"); }),
+                                    pool.submit([]() {}))
+                   .then(pool, [](std::tuple<threadpool::TaskFuture<int>,
+                                             threadpool::TaskFuture<std::string>,
+                                             threadpool::TaskFuture<void>>
+                                      results) {
+                     auto& [a, b, c] = results;
+                     c.get();
+                     return std::to_string(a.get()) + b.get();
+                   });
+  CHECK(mixed.get() == "1two");
+
+  // when_any：一个永远不会完成的输入不影响结果
+  threadpool::TaskPromise<int> never;
+  std::vector<threadpool::TaskFuture<int>> racing;
+  racing.push_back(never.get_future());
+  racing.push_back(pool.submit([]() { return 7; }));
+  auto any = threadpool::when_any(std::move(racing)).get();
+  CHECK(any.index == 1);
+  CHECK(any.futures[1].get() == 7);
+  CHECK(any.futures[0].is_ready() == false);
+  never.set_value(3);
+  CHECK(any.futures[0].get() == 3);
+
+  // when_any 的回调还留在没有完成的输入上，这些输入仍然可以 then 或者再参与一次 when_any
+  threadpool::TaskPromise<int> late;
+  std::vector<threadpool::TaskFuture<int>> losers;
+  losers.push_back(late.get_future());
+  losers.push_back(pool.submit([]() { return 1; }));
+  auto first = threadpool::when_any(std::move(losers)).get();
+  REQUIRE(first.index == 1);
+  std::vector<threadpool::TaskFuture<int>> again;
+  again.push_back(std::move(first.futures[0]));
+  again.push_back(std::move(first.futures[1]));
+  auto second = threadpool::when_any(std::move(again)).get();
+  REQUIRE(second.index == 1);
+  auto doubled = second.futures[0].then(pool, [](int x) { return x * 2; });
+  CHECK(doubled.is_ready() == false);
+  late.set_value(21);
+  CHECK(doubled.get() == 42);
+
+  auto anyTuple = threadpool::when_any(pool.submit([]() { return 1; }),
+                                       pool.submit([]() { return 2.0; }))
+                      .get();
+  CHECK(anyTuple.index < 2);
+
+  // 没有输入时立即完成
+  CHECK(threadpool::when_all(std::vector<threadpool::TaskFuture<int>>()).get().empty());
+  CHECK(threadpool::when_any(std::vector<threadpool::TaskFuture<int>>()).get().index == SIZE_MAX);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("task future continuation test") {
+  // 大量并发的链，注册续体和完成在不同线程上竞争
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_STEALING);
+  pool.start(4);
+  constexpr int kChains = 2000;
+  std::vector<threadpool::TaskFuture<int>> chains;
+  for (int i = 0; i < kChains; i++) {
+    auto future = pool.submit([i]() { return i; });
+    for (int stage = 0; stage < 5; stage++) {
+      future = future.then(pool, [](int x) { return x + 1; });
+    }
+    chains.push_back(std::move(future));
+  }
+  auto total = threadpool::when_all(std::move(chains))
+                   .then(pool, [](std::vector<threadpool::TaskFuture<int>> results) {
+    long long sum = 0;
+    for (auto& result : results) {
+      sum += result.get();
+    }
+    return sum;
+  });
+  CHECK(total.get() == static_cast<long long>(kChains) * (kChains - 1) / 2 + kChains * 5);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("task future continuation test") {
+  // 队列很小时，完成任务的工作线程提交续体不会因为等待空位而阻塞
+  for (auto mode : {threadpool::PoolMode::MODE_FIXED, threadpool::PoolMode::MODE_LOCKFREE,
+                    threadpool::PoolMode::MODE_DEADLINE}) {
+    threadpool::ThreadPool pool;
+    minilog::set_log_level(minilog::log_level::warn);
+    pool.setMode(mode);
+    pool.setTaskThreshold(2);
+    pool.start(2);
+    std::vector<threadpool::TaskFuture<int>> chains;
+    for (int i = 0; i < 500; i++) {
+      auto future = pool.submit([i]() { return i; });
+      for (int stage = 0; stage < 3; stage++) {
+        future = future.then(pool, [](int x) { return x + 1; });
+      }
+      chains.push_back(std::move(future));
+    }
+    long long sum = 0;
+    for (auto& chain : chains) {
+      sum += chain.get();
+    }
+    CHECK(sum == 500LL * 499 / 2 + 500 * 3);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("task future continuation bench") {
+  // 64 条 8 级的流水线：逐级 get 之后再提交下一级，和用 then 串起来一次等待
+  constexpr int kChains = 64;
+  constexpr int kStages = 8;
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_STEALING);
+  pool.start(4);
+  auto stage = [](int x) { return x + 1; };
+  ankerl::nanobench::Bench bench;
+  bench.relative(true).minEpochIterations(20);
+  bench.run("blocking get() then submit", [&]() {
+    std::vector<threadpool::TaskFuture<int>> futures;
+    for (int i = 0; i < kChains; i++) {
+      futures.push_back(pool.submit(stage, i));
+    }
+    for (int s = 1; s < kStages; s++) {
+      for (auto& future : futures) {
+        future = pool.submit(stage, future.get());
+      }
+    }
+    for (auto& future : futures) {
+      ankerl::nanobench::doNotOptimizeAway(future.get());
+    }
+  });
+  bench.run("then() chains + when_all", [&]() {
+    std::vector<threadpool::TaskFuture<int>> futures;
+    for (int i = 0; i < kChains; i++) {
+      auto future = pool.submit(stage, i);
+      for (int s = 1; s < kStages; s++) {
+        future = future.then(pool, stage);
+      }
+      futures.push_back(std::move(future));
+    }
+    for (auto& future : threadpool::when_all(std::move(futures)).get()) {
+      ankerl::nanobench::doNotOptimizeAway(future.get());
+    }
+  });
+}
@@ -0,0 +1,374 @@
+#define ANKERL_NANOBENCH_IMPLEMENT
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <doctest.h>
+#include <nanobench.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#ifdef THREADPOOL_HAS_TBB
+#include <execution>
+#endif
+
+#include "thread/parallel.h"
+#include "thread/threadpool.h"
+#include "test_util.h"
+
+namespace {
+const threadpool::ParallelMode kParallelModes[] = {
+    threadpool::ParallelMode::PARALLEL_CALLER_RUNS,
+    threadpool::ParallelMode::PARALLEL_CALLER_WAITS,
+};
+}  // namespace
+
+// NOLINTNEXTLINE
+TEST_CASE("parallel for test") {
+  // 每个下标恰好被访问一次，按下标和按块两种 body
+  for (auto mode : test_util::kModes) {
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 4);
+    for (auto parallel : kParallelModes) {
+      for (int count : {0, 1, 7, 1000, 100003}) {
+        std::vector<std::atomic<int>> visited(count);
+        threadpool::parallel_for(
+            pool, 0, count, 64, [&visited](int i) { visited[i]++; }, parallel);
+        threadpool::parallel_for(
+            pool, 0, count, 0,
+            [&visited](int lo, int hi) {
+              for (int i = lo; i < hi; i++) {
+                visited[i]++;
+              }
+            },
+            parallel);
+        int wrong = 0;
+        for (auto& v : visited) {
+          wrong += v != 2 ? 1 : 0;
+        }
+        CHECK(wrong == 0);
+      }
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("parallel for test") {
+  // 随机访问区间，body 直接修改元素
+  threadpool::ThreadPool pool;
+  test_util::startPool(pool, threadpool::PoolMode::MODE_STEALING, 4);
+  std::vector<std::int64_t> values(50000);
+  std::iota(values.begin(), values.end(), 0);
+  threadpool::parallel_for(pool, values, 100, [](std::int64_t& v) { v *= 2; });
+  std::int64_t wrong = 0;
+  for (std::size_t i = 0; i < values.size(); i++) {
+    wrong += values[i] != static_cast<std::int64_t>(2 * i) ? 1 : 0;
+  }
+  CHECK(wrong == 0);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("parallel for test") {
+  // 第一个异常在调用线程上重新抛出，之后线程池照常可用
+  for (auto mode : test_util::kModes) {
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 2);
+    for (auto parallel : kParallelModes) {
+      CHECK_THROWS_AS(threadpool::parallel_for(
+                          pool, 0, 10000, 10,
+                          [](int i) {
+                            if (i == 5000) {
+                              throw std::runtime_error("parallel for error");
+                            }
+                          },
+                          parallel),
+                      std::runtime_error);
+      CHECK(pool.submit([]() { return 1; }).get() == 1);
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("parallel for test") {
+  // 在任务中嵌套调用，工作线程帮忙执行，不会因为等待而死锁
+  for (auto mode : test_util::kModes) {
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 2, 0, 2);
+    std::atomic<int> sum = 0;
+    auto outer = [&pool, &sum]() {
+      threadpool::parallel_for(pool, 0, 64, 1, [&pool, &sum](int) {
+        threadpool::parallel_for(pool, 0, 100, 10, [&sum](int) { sum++; });
+      });
+    };
+    std::vector<threadpool::TaskFuture<void>> results;
+    for (int i = 0; i < 4; i++) {
+      results.emplace_back(pool.submit(outer));
+    }
+    for (auto& result : results) {
+      result.get();
+    }
+    CHECK(sum == 4 * 64 * 100);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("parallel reduce test") {
+  for (auto mode : test_util::kModes) {
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 4);
+    for (auto parallel : kParallelModes) {
+      std::int64_t n = 1000003;
+      auto sum = threadpool::parallel_reduce(
+          pool, std::int64_t(0), n, 1000, std::int64_t(0), [](std::int64_t i) { return i; },
+          std::plus<>(), parallel);
+      CHECK(sum == n * (n - 1) / 2);
+      // 按块的 body，结果按块的顺序合并：不满足交换律的拼接也和顺序执行一致
+      auto text = threadpool::parallel_reduce(
+          pool, 0, 200, 7, std::string(),
+          [](int lo, int hi) {
+            std::string s;
+            for (int i = lo; i < hi; i++) {
+              s += std::to_string(i) + ",";
+            }
+            return s;
+          },
+          std::plus<>(), parallel);
+      std::string expected;
+      for (int i = 0; i < 200; i++) {
+        expected += std::to_string(i) + ",";
+      }
+      CHECK(text == expected);
+      CHECK(threadpool::parallel_reduce(pool, 5, 5, 1, 42, [](int i) { return i; }, std::plus<>(),
+                                        parallel) == 42);
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("parallel scan test") {
+  std::mt19937 rng(2024);
+  for (auto mode : test_util::kModes) {
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 4);
+    for (auto parallel : kParallelModes) {
+      for (std::size_t count : {0, 1, 5, 4096, 100001}) {
+        std::vector<std::int64_t> input(count);
+        for (auto& v : input) {
+          v = static_cast<std::int64_t>(rng() % 1000) - 500;
+        }
+        std::vector<std::int64_t> expected(count);
+        std::inclusive_scan(input.begin(), input.end(), expected.begin());
+        std::vector<std::int64_t> output(count);
+        auto end = threadpool::parallel_inclusive_scan(pool, input.begin(), input.end(),
+                                                       output.begin(), std::plus<>(), 100, parallel);
+        CHECK(end == output.end());
+        CHECK(output == expected);
+        // 原地扫描，自动分块
+        threadpool::parallel_inclusive_scan(pool, input.begin(), input.end(), input.begin(),
+                                            std::plus<>(), 0, parallel);
+        CHECK(input == expected);
+      }
+      // 只满足结合律的运算：字符串拼接
+      std::vector<std::string> words(300);
+      for (std::size_t i = 0; i < words.size(); i++) {
+        words[i] = std::string(1, static_cast<char>('a' + i % 26));
+      }
+      std::vector<std::string> expected(words.size());
+      std::inclusive_scan(words.begin(), words.end(), expected.begin());
+      std::vector<std::string> output(words.size());
+      threadpool::parallel_inclusive_scan(pool, words.begin(), words.end(), output.begin(),
+                                          std::plus<>(), 16, parallel);
+      CHECK(output == expected);
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("parallel bench") {
+  // 对比手动拆成大量 submit 的写法和 parallel_reduce
+  constexpr std::int64_t kCount = 1 << 22;
+  std::vector<std::int64_t> values(kCount);
+  std::iota(values.begin(), values.end(), 0);
+  std::int64_t expected = kCount * (kCount - 1) / 2;
+  auto sum = [&values](std::int64_t lo, std::int64_t hi) {
+    return std::accumulate(values.begin() + lo, values.begin() + hi, std::int64_t(0));
+  };
+  ankerl::nanobench::Bench bench;
+  bench.minEpochIterations(10);
+  bench.run("[parallel] std::accumulate",
+            [&]() { CHECK(sum(0, kCount) == expected); });
+  for (auto mode : {threadpool::PoolMode::MODE_FIXED, threadpool::PoolMode::MODE_STEALING}) {
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 4);
+    bool stealing = mode == threadpool::PoolMode::MODE_STEALING;
+    bench.run(stealing ? "[parallel] STEALING mode submit 1024 tasks"
+                       : "[parallel] FIXED mode submit 1024 tasks",
+              [&]() {
+                std::vector<threadpool::TaskFuture<std::int64_t>> results;
+                constexpr std::int64_t kStep = kCount / 1024;
+                for (std::int64_t lo = 0; lo < kCount; lo += kStep) {
+                  results.emplace_back(pool.submit(sum, lo, lo + kStep));
+                }
+                std::int64_t total = 0;
+                for (auto& result : results) {
+                  total += result.get();
+                }
+                CHECK(total == expected);
+              });
+    bench.run(stealing ? "[parallel] STEALING mode parallel_reduce"
+                       : "[parallel] FIXED mode parallel_reduce",
+              [&]() {
+                CHECK(threadpool::parallel_reduce(pool, std::int64_t(0), kCount, 0,
+                                                  std::int64_t(0), sum, std::plus<>()) == expected);
+              });
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("parallel sort test") {
+  std::mt19937 rng(7);
+  for (auto mode : test_util::kModes) {
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 4);
+    for (auto parallel : kParallelModes) {
+      // 段数不同：不需要并行、2段、4段以上，以及长度不是段数倍数的情况
+      for (std::size_t count : {0, 1, 1000, 40000, 100003, 1000000}) {
+        std::vector<std::int64_t> values(count);
+        for (auto& v : values) {
+          v = static_cast<std::int64_t>(rng() % 1000);  // 大量重复元素
+        }
+        auto expected = values;
+        std::sort(expected.begin(), expected.end());
+        threadpool::parallel_sort(pool, values.begin(), values.end(), std::less<>(), parallel);
+        CHECK(values == expected);
+        // 逆序比较
+        threadpool::parallel_sort(pool, values.begin(), values.end(), std::greater<>(), parallel);
+        CHECK(std::is_sorted(values.begin(), values.end(), std::greater<>()));
+      }
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("parallel sort test") {
+  // 没有默认构造函数的类型；按值接收参数的比较函数不会移走元素
+  struct Item {
+    explicit Item(std::string s)
+        : text(std::move(s)) {}
+    std::string text;
+  };
+  threadpool::ThreadPool pool;
+  test_util::startPool(pool, threadpool::PoolMode::MODE_STEALING, 4);
+  std::mt19937 rng(11);
+  std::vector<Item> items;
+  for (int i = 0; i < 100000; i++) {
+    items.emplace_back(std::to_string(rng()));
+  }
+  std::vector<std::string> expected;
+  for (auto& item : items) {
+    expected.push_back(item.text);
+  }
+  std::sort(expected.begin(), expected.end());
+  threadpool::parallel_sort(pool, items.begin(), items.end(),
+                            [](Item a, Item b) { return a.text < b.text; });
+  int wrong = 0;
+  for (std::size_t i = 0; i < items.size(); i++) {
+    wrong += items[i].text != expected[i] ? 1 : 0;
+  }
+  CHECK(wrong == 0);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("parallel merge test") {
+  // 和 std::merge 的结果完全一致，包括相等元素的先后(稳定)
+  using Item = std::pair<int, int>;  // (key, 来源和下标)
+  auto byKey = [](const Item& a, const Item& b) { return a.first < b.first; };
+  std::mt19937 rng(3);
+  for (auto mode : test_util::kModes) {
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 4);
+    for (auto parallel : kParallelModes) {
+      for (auto [n1, n2] : {std::pair<int, int>{0, 0}, {0, 1000}, {1000, 0}, {5000, 37},
+                            {100000, 100000}, {250000, 3}}) {
+        std::vector<Item> a(n1);
+        std::vector<Item> b(n2);
+        for (int i = 0; i < n1; i++) {
+          a[i] = {static_cast<int>(rng() % 500), i};
+        }
+        for (int i = 0; i < n2; i++) {
+          b[i] = {static_cast<int>(rng() % 500), -i - 1};
+        }
+        std::stable_sort(a.begin(), a.end(), byKey);
+        std::stable_sort(b.begin(), b.end(), byKey);
+        std::vector<Item> expected(n1 + n2);
+        std::merge(a.begin(), a.end(), b.begin(), b.end(), expected.begin(), byKey);
+        std::vector<Item> output(n1 + n2);
+        auto end = threadpool::parallel_merge(pool, a.begin(), a.end(), b.begin(), b.end(),
+                                              output.begin(), byKey, 1000, parallel);
+        CHECK(end == output.end());
+        CHECK(output == expected);
+        // 自动分块
+        std::fill(output.begin(), output.end(), Item{});
+        threadpool::parallel_merge(pool, a.begin(), a.end(), b.begin(), b.end(), output.begin(),
+                                   byKey, 0, parallel);
+        CHECK(output == expected);
+      }
+    }
+  }
+}
+
+namespace {
+// 和 std::sort、std::sort(std::execution::par) 对比
+void sortBench(std::size_t count, int iterations) {
+  std::mt19937_64 rng(count);
+  std::vector<std::uint64_t> source(count);
+  for (auto& v : source) {
+    v = rng();
+  }
+  std::vector<std::uint64_t> values;
+  ankerl::nanobench::Bench bench;
+  bench.minEpochIterations(iterations).relative(true);
+  std::string suffix = " " + std::to_string(count) + " elements";
+  bench.run("[sort] std::sort" + suffix, [&]() {
+    values = source;
+    std::sort(values.begin(), values.end());
+  });
+#ifdef THREADPOOL_HAS_TBB
+  bench.run("[sort] std::sort(std::execution::par)" + suffix, [&]() {
+    values = source;
+    std::sort(std::execution::par, values.begin(), values.end());
+  });
+#endif
+  for (auto mode : {threadpool::PoolMode::MODE_FIXED, threadpool::PoolMode::MODE_STEALING}) {
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, std::max(1U, std::thread::hardware_concurrency()));
+    bench.run(std::string(mode == threadpool::PoolMode::MODE_STEALING
+                              ? "[sort] STEALING mode parallel_sort"
+                              : "[sort] FIXED mode parallel_sort") +
+                  suffix,
+              [&]() {
+                values = source;
+                threadpool::parallel_sort(pool, values.begin(), values.end());
+              });
+    CHECK(std::is_sorted(values.begin(), values.end()));
+  }
+}
+}  // namespace
+
+// NOLINTNEXTLINE
+TEST_CASE("parallel sort bench") {
+  sortBench(1000000, 5);
+  sortBench(10000000, 1);
+}
+
+// 需要约2GB内存，使用 --no-skip 运行
+// NOLINTNEXTLINE
+TEST_CASE("parallel sort bench" * doctest::skip()) {
+  sortBench(100000000, 1);
+}
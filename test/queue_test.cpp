@@ -4,14 +4,21 @@
 #include <doctest.h>
 #include <nanobench.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
 #include <functional>
 #include <future>
 #include <iostream>
+#include <memory>
 #include <thread>
+#include <vector>
 
 #include "function/function.h"
 #include "minilog/minilog.h"
 #include "queue/lockfree_queue.h"
+#include "queue/unbounded_queue.h"
 #include "queue/wait_strategy.h"
 
 // a simple threadpool to test
@@ -152,4 +159,572 @@ TEST_CASE("lock-free queue test") {
     }
     // minilog::log_warn("epoch {}", iter++);
   });
-}
\ No newline at end of file
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("lock-free queue bulk test") {
+  BoundedQueue<int> queue;
+  REQUIRE(queue.Init(10, new wait_strategy::YieldWaitStrategy()));
+  int items[16];
+  for (int i = 0; i < 16; i++) {
+    items[i] = i;
+  }
+  // 空间不足时只入队前缀
+  CHECK(queue.enqueue_bulk(items, 8) == 8);
+  CHECK(queue.enqueue_bulk(items + 8, 8) == 2);
+  CHECK(queue.enqueue_bulk(items + 10, 6) == 0);
+  CHECK(queue.size() == 10);
+
+  int out[16];
+  CHECK(queue.dequeue_bulk(out, 4) == 4);
+  CHECK(queue.dequeue_bulk(out + 4, 16) == 6);
+  CHECK(queue.dequeue_bulk(out, 16) == 0);
+  for (int i = 0; i < 10; i++) {
+    CHECK(out[i] == i);
+  }
+  CHECK(queue.empty());
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("lock-free queue bulk test") {
+  // 多生产者批量入队，多消费者混合单个和批量出队，校验元素不重不漏
+  constexpr int kProducers = 4;
+  constexpr int kPerProducer = 20000;
+  BoundedQueue<int> queue;
+  REQUIRE(queue.Init(64, new wait_strategy::YieldWaitStrategy()));
+  std::atomic<long long> sum = 0;
+  std::atomic<int> consumed = 0;
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p < kProducers; p++) {
+    threads.emplace_back([&, p]() {
+      int batch[7];
+      for (int i = 0; i < kPerProducer;) {
+        int n = std::min(7, kPerProducer - i);
+        for (int j = 0; j < n; j++) {
+          batch[j] = p * kPerProducer + i + j + 1;
+        }
+        int done = 0;
+        while (done < n) {
+          done += static_cast<int>(queue.enqueue_bulk(batch + done, n - done));
+          std::this_thread::yield();
+        }
+        i += n;
+      }
+    });
+  }
+  for (int c = 0; c < 2; c++) {
+    threads.emplace_back([&, c]() {
+      int batch[5];
+      while (consumed < kProducers * kPerProducer) {
+        std::uint64_t n = 0;
+        if (c == 0) {
+          n = queue.dequeue_bulk(batch, 5);
+        } else if (queue.dequeue(batch)) {
+          n = 1;
+        }
+        for (std::uint64_t j = 0; j < n; j++) {
+          sum += batch[j];
+        }
+        consumed += static_cast<int>(n);
+        if (n == 0) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  long long total = static_cast<long long>(kProducers) * kPerProducer;
+  CHECK(consumed == total);
+  CHECK(sum == total * (total + 1) / 2);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("lock-free queue bulk test") {
+  // 单个入队出队和批量入队出队的对比
+  BoundedQueue<Function<void()>> queue;
+  REQUIRE(queue.Init(1024, new wait_strategy::YieldWaitStrategy()));
+  int counter = 0;
+  ankerl::nanobench::Bench().minEpochIterations(100).run("enqueue/dequeue 1000 one by one", [&]() {
+    std::vector<Function<void()>> tasks(1000, [&counter]() { counter++; });
+    Function<void()> task;
+    for (auto &t : tasks) {
+      queue.enqueue(std::move(t));
+    }
+    while (queue.dequeue(&task)) {
+      task();
+    }
+  });
+  ankerl::nanobench::Bench().minEpochIterations(100).run("enqueue/dequeue 1000 in bulk", [&]() {
+    std::vector<Function<void()>> tasks(1000, [&counter]() { counter++; });
+    Function<void()> out[16];
+    queue.enqueue_bulk(tasks.data(), tasks.size());
+    while (std::uint64_t n = queue.dequeue_bulk(out, 16)) {
+      for (std::uint64_t i = 0; i < n; i++) {
+        out[i]();
+      }
+    }
+  });
+  ankerl::nanobench::doNotOptimizeAway(counter);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("lock-free queue index test") {
+  BoundedQueue<int> exact;
+  BoundedQueue<int> rounded;
+  REQUIRE(exact.Init(1000, new wait_strategy::YieldWaitStrategy()));
+  REQUIRE(rounded.Init(1000, new wait_strategy::YieldWaitStrategy(), true));
+  CHECK(exact.capacity() == 1000);
+  CHECK(rounded.capacity() == 1024);
+
+  // 掩码下标和取模下标的结果一致，绕圈之后元素顺序不变
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < 1024; i++) {
+      CHECK(rounded.enqueue(round * 1024 + i));
+    }
+    CHECK_FALSE(rounded.enqueue(-1));
+    for (int i = 0; i < 1024; i++) {
+      int value = -1;
+      CHECK(rounded.dequeue(&value));
+      CHECK(value == round * 1024 + i);
+    }
+  }
+
+  // 单线程入队出队，每次操作的耗时，取模下标(之前) vs 掩码下标(之后)
+  int value = 0;
+  ankerl::nanobench::Bench bench;
+  bench.minEpochIterations(200).batch(2000).unit("op");
+  bench.run("enqueue/dequeue with modulo index", [&]() {
+    for (int i = 0; i < 1000; i++) {
+      exact.enqueue(i);
+    }
+    while (exact.dequeue(&value)) {
+    }
+  });
+  bench.run("enqueue/dequeue with mask index", [&]() {
+    for (int i = 0; i < 1000; i++) {
+      rounded.enqueue(i);
+    }
+    while (rounded.dequeue(&value)) {
+    }
+  });
+  ankerl::nanobench::doNotOptimizeAway(value);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("lock-free queue capacity test") {
+  // 容量为1时第二次入队失败，不会覆盖还没取走的元素；多线程交替入队出队不会丢失元素
+  for (bool power_of_two : {false, true}) {
+    BoundedQueue<int> queue;
+    REQUIRE(queue.Init(1, new wait_strategy::YieldWaitStrategy(), power_of_two));
+    CHECK(queue.capacity() == 1);
+    for (int round = 0; round < 3; round++) {
+      CHECK(queue.enqueue(round));
+      CHECK_FALSE(queue.enqueue(-1));
+      int items[2] = {round, round};
+      CHECK(queue.enqueue_bulk(items, 2) == 0);
+      CHECK(queue.size() == 1);
+      int value = -1;
+      CHECK(queue.dequeue(&value));
+      CHECK(value == round);
+      CHECK_FALSE(queue.dequeue(&value));
+    }
+    int items[2] = {7, 8};
+    CHECK(queue.enqueue_bulk(items, 2) == 1);
+    int value = -1;
+    CHECK(queue.dequeue_bulk(&value, 2) == 1);
+    CHECK(value == 7);
+
+    constexpr int kCount = 100000;
+    std::thread producer([&queue]() {
+      for (int i = 0; i < kCount; i++) {
+        queue.wait_enqueue(i);
+      }
+    });
+    long long sum = 0;
+    for (int i = 0; i < kCount; i++) {
+      REQUIRE(queue.wait_dequeue(&value));
+      CHECK(value == i);
+      sum += value;
+    }
+    producer.join();
+    CHECK(sum == static_cast<long long>(kCount) * (kCount - 1) / 2);
+  }
+}
+
+// 统计存活对象和拷贝次数，没有默认构造函数
+struct Tracked {
+  static inline int alive = 0;
+  static inline int copies = 0;
+
+  Tracked(int v, int w)
+      : value(v + w) {
+    alive++;
+  }
+  Tracked(const Tracked &other)
+      : value(other.value) {
+    alive++;
+    copies++;
+  }
+  Tracked(Tracked &&other) noexcept
+      : value(other.value) {
+    alive++;
+  }
+  Tracked &operator=(const Tracked &other) {
+    value = other.value;
+    copies++;
+    return *this;
+  }
+  Tracked &operator=(Tracked &&other) noexcept {
+    value = other.value;
+    return *this;
+  }
+  ~Tracked() { alive--; }
+
+  int value;
+};
+
+// NOLINTNEXTLINE
+TEST_CASE("lock-free queue move test") {
+  {
+    BoundedQueue<Tracked> queue;
+    REQUIRE(queue.Init(8, new wait_strategy::YieldWaitStrategy(), true));
+    CHECK(Tracked::alive == 0);  // 空槽位中没有对象
+
+    CHECK(queue.emplace(1, 2));
+    CHECK(queue.enqueue(Tracked(3, 4)));
+    Tracked lvalue(5, 6);
+    CHECK(queue.enqueue(lvalue));
+    CHECK(Tracked::alive == 4);
+    CHECK(Tracked::copies == 1);
+
+    // 出队后槽位中的对象立即析构
+    Tracked out(0, 0);
+    CHECK(queue.dequeue(&out));
+    CHECK(out.value == 3);
+    CHECK(Tracked::alive == 4);
+    CHECK(queue.dequeue(&out));
+    CHECK(out.value == 7);
+    CHECK(Tracked::alive == 3);
+    CHECK(Tracked::copies == 1);
+    // 剩下的一个元素由队列析构
+  }
+  CHECK(Tracked::alive == 0);
+
+  // 出队之后任务捕获的资源立即释放，不会等到槽位被覆盖
+  BoundedQueue<Function<void()>> queue;
+  REQUIRE(queue.Init(8, new wait_strategy::YieldWaitStrategy(), true));
+  auto resource = std::make_shared<int>(42);
+  CHECK(queue.enqueue([resource]() {}));
+  CHECK(resource.use_count() == 2);
+  {
+    Function<void()> task;
+    CHECK(queue.dequeue(&task));
+    CHECK(resource.use_count() == 2);
+  }
+  CHECK(resource.use_count() == 1);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("unbounded queue test") {
+  {
+    UnboundedQueue<Tracked, 4> queue;
+    REQUIRE(queue.Init(new wait_strategy::YieldWaitStrategy()));
+    Tracked out(0, 0);
+    CHECK_FALSE(queue.dequeue(&out));
+    // 跨越多个段，顺序不变
+    for (int i = 0; i < 100; i++) {
+      CHECK(queue.emplace(i, 0));
+    }
+    CHECK(queue.size() == 100);
+    CHECK(queue.segment_count() == 26);  // 写满一段时会提前挂上下一段
+    for (int i = 0; i < 90; i++) {
+      CHECK(queue.dequeue(&out));
+      CHECK(out.value == i);
+    }
+    // 取完的段立即归还
+    CHECK(queue.size() == 10);
+    CHECK(queue.segment_count() <= 4);
+    CHECK(Tracked::alive == 11);
+    // 剩下的元素由队列析构
+  }
+  CHECK(Tracked::alive == 0);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("unbounded queue test") {
+  // 多生产者多消费者，校验元素不重不漏，积压消化之后只剩少量的段
+  constexpr int kProducers = 4;
+  constexpr int kPerProducer = 20000;
+  UnboundedQueue<int, 8> queue;
+  REQUIRE(queue.Init(new wait_strategy::YieldWaitStrategy()));
+  std::atomic<long long> sum = 0;
+  std::atomic<int> consumed = 0;
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p < kProducers; p++) {
+    threads.emplace_back([&, p]() {
+      for (int i = 0; i < kPerProducer; i++) {
+        queue.enqueue(p * kPerProducer + i + 1);
+      }
+    });
+  }
+  for (int c = 0; c < 2; c++) {
+    threads.emplace_back([&, c]() {
+      int batch[5];
+      while (consumed < kProducers * kPerProducer) {
+        std::uint64_t n = 0;
+        if (c == 0) {
+          n = queue.dequeue_bulk(batch, 5);
+        } else if (queue.dequeue(batch)) {
+          n = 1;
+        }
+        for (std::uint64_t j = 0; j < n; j++) {
+          sum += batch[j];
+        }
+        consumed += static_cast<int>(n);
+        if (n == 0) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  long long total = static_cast<long long>(kProducers) * kPerProducer;
+  CHECK(consumed == total);
+  CHECK(sum == total * (total + 1) / 2);
+  CHECK(queue.empty());
+  CHECK(queue.segment_count() <= 2);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("hybrid wait strategy test") {
+  // 消费者空闲时挂起，不再占用cpu；之后的入队能唤醒它
+  BoundedQueue<int> queue;
+  REQUIRE(queue.Init(64, new wait_strategy::HybridWaitStrategy()));
+  std::atomic<int> received = 0;
+  std::thread consumer([&]() {
+    int value = 0;
+    while (queue.wait_dequeue(&value)) {
+      received += value;
+    }
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  std::clock_t begin = std::clock();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  std::clock_t idle = std::clock() - begin;
+  CHECK(idle < CLOCKS_PER_SEC / 50);  // 空闲的100ms内cpu时间不超过20ms
+  for (int i = 1; i <= 100; i++) {
+    CHECK(queue.enqueue(i));
+    if (i % 10 == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  while (received != 5050) {
+    std::this_thread::yield();
+  }
+  queue.BreakAllWait();
+  consumer.join();
+  CHECK(received == 5050);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("hybrid wait strategy test") {
+  // 多生产者多消费者，唤醒不丢失
+  constexpr int kProducers = 2;
+  constexpr int kConsumers = 3;
+  constexpr int kPerProducer = 20000;
+  BoundedQueue<int> queue;
+  REQUIRE(queue.Init(16, new wait_strategy::HybridWaitStrategy(8, 2)));
+  std::atomic<long long> sum = 0;
+  std::atomic<int> consumed = 0;
+  std::vector<std::thread> threads;
+  for (int c = 0; c < kConsumers; c++) {
+    threads.emplace_back([&]() {
+      int value = 0;
+      while (queue.wait_dequeue(&value)) {
+        sum += value;
+        consumed++;
+      }
+    });
+  }
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; p++) {
+    producers.emplace_back([&, p]() {
+      for (int i = 0; i < kPerProducer; i++) {
+        while (!queue.enqueue(p * kPerProducer + i + 1)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (auto &producer : producers) {
+    producer.join();
+  }
+  while (consumed != kProducers * kPerProducer) {
+    std::this_thread::yield();
+  }
+  queue.BreakAllWait();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  long long total = static_cast<long long>(kProducers) * kPerProducer;
+  CHECK(sum == total * (total + 1) / 2);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("hybrid wait strategy test") {
+  // 单生产者单消费者的乒乓延迟
+  auto pingpong = [](wait_strategy::WaitStrategy *ping_strategy,
+                     wait_strategy::WaitStrategy *pong_strategy, const char *name) {
+    BoundedQueue<int> ping;
+    BoundedQueue<int> pong;
+    REQUIRE(ping.Init(8, ping_strategy));
+    REQUIRE(pong.Init(8, pong_strategy));
+    std::thread echo([&]() {
+      int value = 0;
+      while (ping.wait_dequeue(&value)) {
+        pong.enqueue(value);
+      }
+    });
+    ankerl::nanobench::Bench().minEpochIterations(2000).run(name, [&]() {
+      int value = 0;
+      ping.enqueue(1);
+      pong.wait_dequeue(&value);
+    });
+    ping.BreakAllWait();
+    echo.join();
+  };
+  pingpong(new wait_strategy::YieldWaitStrategy(), new wait_strategy::YieldWaitStrategy(),
+           "YieldWaitStrategy ping-pong");
+  pingpong(new wait_strategy::BlockWaitStrategy(), new wait_strategy::BlockWaitStrategy(),
+           "BlockWaitStrategy ping-pong");
+  pingpong(new wait_strategy::HybridWaitStrategy(), new wait_strategy::HybridWaitStrategy(),
+           "HybridWaitStrategy ping-pong");
+}
+
+// 统计唤醒次数的等待策略
+class CountingWaitStrategy : public wait_strategy::BlockWaitStrategy {
+  public:
+  explicit CountingWaitStrategy(std::atomic<int> *notifies)
+      : notifies_(notifies) {}
+
+  void NotifyOne() override {
+    notifies_->fetch_add(1);
+    BlockWaitStrategy::NotifyOne();
+  }
+
+  private:
+  std::atomic<int> *notifies_;
+};
+
+// NOLINTNEXTLINE
+TEST_CASE("event count test") {
+  // 没有等待者时不调用等待策略
+  std::atomic<int> notifies = 0;
+  BoundedQueue<int> queue;
+  REQUIRE(queue.Init(64, new CountingWaitStrategy(&notifies)));
+  int out[8];
+  for (int round = 0; round < 100; round++) {
+    for (int i = 0; i < 10; i++) {
+      CHECK(queue.enqueue(i));
+    }
+    CHECK(queue.dequeue_bulk(out, 8) == 8);
+    CHECK(queue.dequeue(out));
+    CHECK(queue.dequeue(out));
+  }
+  CHECK(notifies == 0);
+  CHECK(queue.notified_wakeups() == 0);
+  CHECK(queue.avoided_wakeups() == 2000);
+
+  UnboundedQueue<int, 8> unbounded;
+  REQUIRE(unbounded.Init(new CountingWaitStrategy(&notifies)));
+  for (int i = 0; i < 100; i++) {
+    unbounded.enqueue(i);
+  }
+  CHECK(notifies == 0);
+  CHECK(unbounded.avoided_wakeups() == 100);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("event count test") {
+  // 消费者阻塞之后，入队一定会唤醒它
+  std::atomic<int> notifies = 0;
+  BoundedQueue<int> queue;
+  REQUIRE(queue.Init(64, new CountingWaitStrategy(&notifies)));
+  std::atomic<int> received = 0;
+  std::thread consumer([&]() {
+    int value = 0;
+    while (queue.wait_dequeue(&value)) {
+      received += value;
+    }
+  });
+  for (int i = 1; i <= 10; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    CHECK(queue.enqueue(i));
+    while (received != i * (i + 1) / 2) {
+      std::this_thread::yield();
+    }
+  }
+  CHECK(notifies >= 1);
+  CHECK(queue.notified_wakeups() == static_cast<std::uint64_t>(notifies.load()));
+  queue.BreakAllWait();
+  consumer.join();
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("event count test") {
+  // 生产者和等待型消费者并发，统计实际唤醒和省掉的唤醒
+  constexpr int kItems = 100000;
+  BoundedQueue<int> queue;
+  REQUIRE(queue.Init(1024, new wait_strategy::TimeoutBlockStrategy(), true));
+  ankerl::nanobench::Bench().minEpochIterations(5).run(
+      "producer/consumer 100000 with TimeoutBlockStrategy", [&]() {
+        long long sum = 0;
+        std::thread consumer([&]() {
+          int value = 0;
+          // 超时返回false时重试
+          for (int i = 0; i < kItems;) {
+            if (queue.wait_dequeue(&value)) {
+              sum += value;
+              i++;
+            }
+          }
+        });
+        for (int i = 0; i < kItems;) {
+          if (queue.wait_enqueue(i)) {
+            i++;
+          }
+        }
+        consumer.join();
+        CHECK(sum == static_cast<long long>(kItems) * (kItems - 1) / 2);
+      });
+  std::uint64_t notified = queue.notified_wakeups();
+
+  // 单线程入队出队，每次操作都通知等待策略(之前) vs 只在有等待者时通知(之后)
+  wait_strategy::TimeoutBlockStrategy strategy;
+  int value = 0;
+  ankerl::nanobench::Bench bench;
+  bench.minEpochIterations(200).batch(2000).unit("op");
+  bench.run("enqueue/dequeue notify every op", [&]() {
+    for (int i = 0; i < 1000; i++) {
+      queue.enqueue(i);
+      strategy.NotifyOne();
+      queue.dequeue(&value);
+      strategy.NotifyOne();
+    }
+  });
+  bench.run("enqueue/dequeue notify only waiters", [&]() {
+    for (int i = 0; i < 1000; i++) {
+      queue.enqueue(i);
+      queue.dequeue(&value);
+    }
+  });
+  // 没有等待者时单线程入队出队不会通知等待策略
+  CHECK(queue.notified_wakeups() == notified);
+  ankerl::nanobench::doNotOptimizeAway(value);
+}
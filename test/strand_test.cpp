@@ -0,0 +1,231 @@
+#define ANKERL_NANOBENCH_IMPLEMENT
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <doctest.h>
+#include <nanobench.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "alloc_counter.h"
+#include "queue/mpsc_queue.h"
+#include "thread/strand.h"
+#include "thread/threadpool.h"
+#include "test_util.h"
+
+namespace {
+struct Item : MpscNode {
+  int producer = 0;
+  int seq = 0;
+};
+}  // namespace
+
+// NOLINTNEXTLINE
+TEST_CASE("mpsc queue test") {
+  // 多个生产者，单个消费者：不重不漏，每个生产者内部保持顺序
+  constexpr int kProducers = 4;
+  constexpr int kPerProducer = 50000;
+  MpscQueue queue;
+  CHECK(queue.pop() == nullptr);
+  CHECK(queue.empty());
+  std::vector<Item> items(kProducers * kPerProducer);
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; p++) {
+    producers.emplace_back([&items, &queue, p]() {
+      for (int i = 0; i < kPerProducer; i++) {
+        Item& item = items[p * kPerProducer + i];
+        item.producer = p;
+        item.seq = i;
+        queue.push(&item);
+      }
+    });
+  }
+  std::vector<int> next(kProducers, 0);
+  int received = 0;
+  int wrong = 0;
+  while (received < kProducers * kPerProducer) {
+    MpscNode* node = queue.pop();
+    if (node == nullptr) {
+      std::this_thread::yield();
+      continue;
+    }
+    auto* item = static_cast<Item*>(node);
+    wrong += item->seq != next[item->producer]++ ? 1 : 0;
+    received++;
+  }
+  for (auto& t : producers) {
+    t.join();
+  }
+  CHECK(wrong == 0);
+  CHECK(queue.pop() == nullptr);
+  CHECK(queue.empty());
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("strand test") {
+  // 同一个 strand 上的任务互斥执行，同一个提交者的任务按顺序执行
+  constexpr int kStrands = 64;
+  constexpr int kProducers = 3;
+  constexpr int kPerProducer = 2000;
+  for (auto mode : test_util::kModes) {
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 4, 1024);
+    struct State {
+      std::atomic<bool> running = false;
+      int overlaps = 0;
+      int disorder = 0;
+      int last[kProducers] = {};
+      int count = 0;
+    };
+    std::vector<std::unique_ptr<threadpool::Strand>> strands;
+    std::vector<State> states(kStrands);
+    for (int i = 0; i < kStrands; i++) {
+      strands.push_back(std::make_unique<threadpool::Strand>(pool));
+    }
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; p++) {
+      producers.emplace_back([&, p]() {
+        for (int i = 1; i <= kPerProducer; i++) {
+          int index = (i * 7 + p) % kStrands;
+          State* state = &states[index];
+          strands[index]->post([state, p, i]() {
+            if (state->running.exchange(true)) {
+              state->overlaps++;
+            }
+            state->disorder += state->last[p] >= i ? 1 : 0;
+            state->last[p] = i;
+            state->count++;
+            state->running = false;
+          });
+        }
+      });
+    }
+    for (auto& t : producers) {
+      t.join();
+    }
+    // 析构时等待所有任务完成
+    strands.clear();
+    int overlaps = 0;
+    int disorder = 0;
+    int count = 0;
+    for (auto& state : states) {
+      overlaps += state.overlaps;
+      disorder += state.disorder;
+      count += state.count;
+    }
+    CHECK(overlaps == 0);
+    CHECK(disorder == 0);
+    CHECK(count == kProducers * kPerProducer);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("strand test") {
+  // submit 返回 future，异常不影响后面的任务，running_in_this_thread
+  threadpool::ThreadPool pool;
+  test_util::startPool(pool, threadpool::PoolMode::MODE_STEALING, 2);
+  threadpool::Strand strand(pool);
+  threadpool::Strand other(pool);
+  CHECK_FALSE(strand.running_in_this_thread());
+  auto inside = strand.submit([&]() {
+    return strand.running_in_this_thread() && !other.running_in_this_thread();
+  });
+  CHECK(inside.get());
+  strand.post([]() { throw std::runtime_error("ignored"); });
+  auto failed = strand.submit([]() -> int { throw std::logic_error("strand"); });
+  auto after = strand.submit([](int x) { return x * 2; }, 21);
+  CHECK_THROWS_AS(failed.get(), std::logic_error);
+  CHECK(after.get() == 42);
+
+  // 任务中继续向同一个 strand 提交，按顺序在之后执行
+  std::vector<int> order;
+  std::atomic<bool> done = false;
+  strand.post([&]() {
+    order.push_back(1);
+    strand.post([&]() {
+      order.push_back(3);
+      done = true;
+    });
+    order.push_back(2);
+  });
+  while (!done) {
+    std::this_thread::yield();
+  }
+  CHECK(order == std::vector<int>{1, 2, 3});
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("strand test") {
+  // 节点从线程池的slab中分配，slab增长之后提交不再走堆分配
+  for (auto mode : test_util::kModes) {
+    if (mode == threadpool::PoolMode::MODE_DEADLINE) {
+      // DEADLINE 模式把任务再包装一层 DeadlineTask，放不进内部缓冲区，调度 strand 本身就会分配
+      continue;
+    }
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 2);
+    threadpool::Strand strand(pool);
+    int count = 0;
+    auto round = [&]() {
+      for (int i = 0; i < 1000; i++) {
+        strand.post([&count]() { count++; });
+      }
+      while (strand.pending() != 0) {
+        std::this_thread::yield();
+      }
+    };
+    round();
+    std::uint64_t before = alloc_counter::allocations.load();
+    round();
+    CHECK(alloc_counter::allocations.load() - before == 0);
+    CHECK(count == 2000);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("strand bench") {
+  // 1000 个 key 上的有序执行：每个 key 一把锁，和每个 key 一个 strand
+  constexpr int kKeys = 1000;
+  constexpr int kTasks = 100000;
+  threadpool::ThreadPool pool(threadpool::QueueMode::QUEUE_UNBOUNDED);
+  test_util::startPool(pool, threadpool::PoolMode::MODE_STEALING, 4);
+  std::vector<std::unique_ptr<threadpool::Strand>> strands;
+  std::vector<std::mutex> locks(kKeys);
+  std::vector<long long> counters(kKeys, 0);
+  for (int i = 0; i < kKeys; i++) {
+    strands.push_back(std::make_unique<threadpool::Strand>(pool));
+  }
+  ankerl::nanobench::Bench bench;
+  bench.relative(true).minEpochIterations(20);
+  bench.run("pool.post + mutex per key", [&]() {
+    std::atomic<int> remaining = kTasks;
+    for (int i = 0; i < kTasks; i++) {
+      pool.post([&, key = i % kKeys]() {
+        std::lock_guard<std::mutex> lock(locks[key]);
+        counters[key]++;
+        remaining--;
+      });
+    }
+    while (remaining != 0) {
+      pool.run_pending_task();
+    }
+  });
+  bench.run("strand per key", [&]() {
+    std::atomic<int> remaining = kTasks;
+    for (int i = 0; i < kTasks; i++) {
+      int key = i % kKeys;
+      strands[key]->post([&, key]() {
+        counters[key]++;
+        remaining--;
+      });
+    }
+    while (remaining != 0) {
+      pool.run_pending_task();
+    }
+  });
+}
@@ -0,0 +1,185 @@
+#define ANKERL_NANOBENCH_IMPLEMENT
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <doctest.h>
+#include <nanobench.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "alloc_counter.h"
+#include "thread/parallel.h"
+#include "thread/task_graph.h"
+#include "thread/threadpool.h"
+#include "test_util.h"
+
+namespace {
+// 随机 DAG：每个节点依赖至多 maxDeps 个编号更小的节点
+std::vector<std::vector<std::size_t>> randomDag(std::size_t nodes, int maxDeps, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::vector<std::vector<std::size_t>> deps(nodes);
+  for (std::size_t i = 1; i < nodes; i++) {
+    int count = static_cast<int>(rng() % (maxDeps + 1));
+    for (int k = 0; k < count; k++) {
+      // 偏向最近的节点，图的深度和宽度都比较大
+      std::size_t back = 1 + rng() % std::min<std::size_t>(i, 64);
+      deps[i].push_back(rng() % 4 == 0 ? rng() % i : i - back);
+    }
+  }
+  return deps;
+}
+}  // namespace
+
+// NOLINTNEXTLINE
+TEST_CASE("task graph test") {
+  // 每个任务在所有前驱完成之后才执行，每次执行每个任务恰好一次，可以重复执行
+  constexpr std::size_t kNodes = 5000;
+  auto deps = randomDag(kNodes, 3, 42);
+  for (auto mode : test_util::kModes) {
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 4, 1024);
+    threadpool::TaskGraph graph(pool);
+    std::atomic<std::uint64_t> clock = 0;
+    std::vector<std::uint64_t> finished(kNodes, 0);
+    std::vector<int> runs(kNodes, 0);
+    std::vector<int> early(kNodes, 0);
+    for (std::size_t i = 0; i < kNodes; i++) {
+      graph.add([&, i]() {
+        for (std::size_t d : deps[i]) {
+          early[i] += finished[d] == 0 ? 1 : 0;
+        }
+        runs[i]++;
+        finished[i] = ++clock;
+      });
+    }
+    for (std::size_t i = 0; i < kNodes; i++) {
+      for (std::size_t d : deps[i]) {
+        graph.add_dependency(i, d);
+      }
+    }
+    CHECK(graph.size() == kNodes);
+    for (int round = 1; round <= 3; round++) {
+      std::fill(finished.begin(), finished.end(), 0);
+      graph.run(round == 2 ? threadpool::ParallelMode::PARALLEL_CALLER_WAITS
+                           : threadpool::ParallelMode::PARALLEL_CALLER_RUNS);
+      int wrongRuns = 0;
+      int wrongOrder = 0;
+      for (std::size_t i = 0; i < kNodes; i++) {
+        wrongRuns += runs[i] != round ? 1 : 0;
+        wrongOrder += early[i];
+      }
+      CHECK(wrongRuns == 0);
+      CHECK(wrongOrder == 0);
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("task graph test") {
+  // 异常、环、非法的编号
+  threadpool::ThreadPool pool;
+  test_util::startPool(pool, threadpool::PoolMode::MODE_STEALING, 2);
+  threadpool::TaskGraph graph(pool);
+  std::atomic<int> after = 0;
+  bool fail = true;
+  auto a = graph.add([&]() {
+    if (fail) {
+      throw std::runtime_error("graph");
+    }
+  });
+  auto b = graph.add([&]() { after++; }, {a});
+  graph.add([&]() { after++; }, {a, b});
+  CHECK_THROWS_AS(graph.run(), std::runtime_error);
+  CHECK(after == 0);
+  fail = false;
+  graph.run();
+  CHECK(after == 2);
+
+  CHECK_THROWS_AS(graph.add_dependency(a, 10), std::out_of_range);
+  CHECK_THROWS_AS(graph.add([]() {}, {10}), std::out_of_range);
+  graph.add_dependency(a, b);
+  CHECK_THROWS_AS(graph.run(), std::logic_error);
+
+  threadpool::TaskGraph empty(pool);
+  empty.run();
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("task graph test") {
+  // 编译之后重复执行不再分配：上下文和就绪队列都被复用，LOCKFREE 和 STEALING 模式的提交不分配内存
+  constexpr std::size_t kNodes = 10000;
+  auto deps = randomDag(kNodes, 3, 7);
+  for (auto mode : {threadpool::PoolMode::MODE_LOCKFREE, threadpool::PoolMode::MODE_STEALING}) {
+    CAPTURE(static_cast<int>(mode));
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 4);
+    threadpool::TaskGraph graph(pool);
+    std::atomic<long long> sum = 0;
+    for (std::size_t i = 0; i < kNodes; i++) {
+      graph.add([&sum, i]() { sum += static_cast<long long>(i); });
+      for (std::size_t d : deps[i]) {
+        graph.add_dependency(i, d);
+      }
+    }
+    // 第一次执行编译图，slab 和本地队列也在这时增长到稳定的大小
+    graph.run();
+    graph.run();
+    constexpr int kRuns = 20;
+    std::uint64_t before = alloc_counter::allocations.load();
+    for (int i = 0; i < kRuns; i++) {
+      graph.run();
+    }
+    CHECK(alloc_counter::allocations.load() - before == 0);
+    CHECK(sum == static_cast<long long>(kNodes * (kNodes - 1) / 2) * (kRuns + 2));
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("task graph bench") {
+  // 100k 个节点的随机 DAG：按层 parallel_for(每层之间有一次同步)，和按依赖计数调度的 TaskGraph
+  constexpr std::size_t kNodes = 100000;
+  auto deps = randomDag(kNodes, 4, 2024);
+  std::vector<std::size_t> level(kNodes, 0);
+  std::size_t levels = 0;
+  for (std::size_t i = 0; i < kNodes; i++) {
+    for (std::size_t d : deps[i]) {
+      level[i] = std::max(level[i], level[d] + 1);
+    }
+    levels = std::max(levels, level[i] + 1);
+  }
+  std::vector<std::vector<std::size_t>> byLevel(levels);
+  for (std::size_t i = 0; i < kNodes; i++) {
+    byLevel[level[i]].push_back(i);
+  }
+  threadpool::ThreadPool pool;
+  test_util::startPool(pool, threadpool::PoolMode::MODE_STEALING, 4);
+  std::vector<std::uint64_t> value(kNodes, 0);
+  auto work = [&](std::size_t i) {
+    std::uint64_t v = i;
+    for (std::size_t d : deps[i]) {
+      v += value[d];
+    }
+    value[i] = v * 2654435761U;
+  };
+  threadpool::TaskGraph graph(pool);
+  for (std::size_t i = 0; i < kNodes; i++) {
+    graph.add([&work, i]() { work(i); });
+    for (std::size_t d : deps[i]) {
+      graph.add_dependency(i, d);
+    }
+  }
+  ankerl::nanobench::Bench bench;
+  bench.relative(true).minEpochIterations(5);
+  bench.run("parallel_for per level", [&]() {
+    for (auto& nodes : byLevel) {
+      threadpool::parallel_for(pool, nodes, 0, work);
+    }
+  });
+  bench.run("task graph", [&]() { graph.run(); });
+  bench.run("task graph, caller waits", [&]() { graph.run(threadpool::ParallelMode::PARALLEL_CALLER_WAITS); });
+  ankerl::nanobench::doNotOptimizeAway(value);
+}
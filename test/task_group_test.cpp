@@ -0,0 +1,153 @@
+#define ANKERL_NANOBENCH_IMPLEMENT
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <doctest.h>
+#include <nanobench.h>
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "future/task_future.h"
+#include "thread/task_group.h"
+#include "thread/threadpool.h"
+#include "test_util.h"
+
+namespace {
+// 递归的 fork-join，每一层在工作线程中创建任务组并等待
+std::uint64_t fib(threadpool::ThreadPool& pool, int n) {
+  if (n < 2) {
+    return n;
+  }
+  if (n < 12) {
+    return fib(pool, n - 1) + fib(pool, n - 2);
+  }
+  std::uint64_t x = 0;
+  std::uint64_t y = 0;
+  threadpool::TaskGroup group(pool);
+  group.run([&pool, &x, n]() { x = fib(pool, n - 1); });
+  group.run_and_wait([&pool, &y, n]() { y = fib(pool, n - 2); });
+  return x + y;
+}
+
+std::uint64_t fibSerial(int n) { return n < 2 ? n : fibSerial(n - 1) + fibSerial(n - 2); }
+}  // namespace
+
+// NOLINTNEXTLINE
+TEST_CASE("task group test") {
+  // 每个任务恰好执行一次，wait 返回时全部完成；任务组可以重复使用
+  for (auto mode : test_util::kModes) {
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 4);
+    threadpool::TaskGroup group(pool);
+    for (int round = 0; round < 3; round++) {
+      std::vector<int> done(1000, 0);
+      for (int i = 0; i < 1000; i++) {
+        group.run([&done](int index) { done[index]++; }, i);
+      }
+      group.wait();
+      int wrong = 0;
+      for (int d : done) {
+        wrong += d != 1 ? 1 : 0;
+      }
+      CHECK(wrong == 0);
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("task group test") {
+  // 递归等待不会死锁：线程数远小于同时在等待的任务组数
+  for (auto mode : test_util::kModes) {
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 2);
+    CHECK(fib(pool, 22) == fibSerial(22));
+    // 在工作线程中等待
+    auto future = pool.submit([&pool]() { return fib(pool, 20); });
+    CHECK(future.get() == fibSerial(20));
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("task group test") {
+  // 队列满时工作线程中的 run() 直接执行任务，不等待空位，否则所有工作线程都在等待时没有人取走任务
+  for (auto mode : {threadpool::PoolMode::MODE_FIXED, threadpool::PoolMode::MODE_LOCKFREE,
+                    threadpool::PoolMode::MODE_DEADLINE}) {
+    for (int threshold : {0, 4}) {
+      threadpool::ThreadPool pool;
+      test_util::startPool(pool, mode, 4, threshold);
+      CHECK(fib(pool, 24) == fibSerial(24));
+      auto future = pool.submit([&pool]() { return fib(pool, 24); });
+      CHECK(future.get() == fibSerial(24));
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("task group test") {
+  // 第一个异常在 wait 中抛出，之后没有开始的任务被跳过，任务组还能继续使用
+  for (auto mode : test_util::kModes) {
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 2);
+    threadpool::TaskGroup group(pool);
+    std::atomic<int> executed = 0;
+    for (int i = 0; i < 1000; i++) {
+      group.run([&executed, i]() {
+        executed++;
+        if (i % 100 == 0) {
+          throw std::runtime_error("task group");
+        }
+      });
+    }
+    CHECK_THROWS_AS(group.wait(), std::runtime_error);
+    CHECK(executed <= 1000);
+    CHECK(group.is_canceling() == false);
+
+    std::atomic<int> after = 0;
+    for (int i = 0; i < 100; i++) {
+      group.run([&after]() { after++; });
+    }
+    CHECK_NOTHROW(group.wait());
+    CHECK(after == 100);
+
+    // run_and_wait 中当前线程上的异常同样在 wait 中抛出
+    CHECK_THROWS_AS(group.run_and_wait([]() { throw std::logic_error("caller"); }),
+                    std::logic_error);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("task group bench") {
+  // 等待一批任务：逐个 future.get() 和任务组的一次 wait
+  constexpr int kTasks = 1024;
+  for (auto mode : {threadpool::PoolMode::MODE_FIXED, threadpool::PoolMode::MODE_STEALING}) {
+    threadpool::ThreadPool pool;
+    test_util::startPool(pool, mode, 4);
+    const char* name = mode == threadpool::PoolMode::MODE_FIXED ? "FIXED" : "STEALING";
+    std::vector<std::uint64_t> values(kTasks);
+    ankerl::nanobench::Bench bench;
+    bench.title(name).relative(true).minEpochIterations(20);
+    bench.run("futures get() for 1024 tasks", [&]() {
+      std::vector<threadpool::TaskFuture<void>> futures;
+      futures.reserve(kTasks);
+      for (int i = 0; i < kTasks; i++) {
+        futures.push_back(pool.submit([&values, i]() { values[i] = fibSerial(10); }));
+      }
+      for (auto& future : futures) {
+        future.get();
+      }
+    });
+    bench.run("task group wait() for 1024 tasks", [&]() {
+      threadpool::TaskGroup group(pool);
+      for (int i = 0; i < kTasks; i++) {
+        group.run([&values, i]() { values[i] = fibSerial(10); });
+      }
+      group.wait();
+    });
+    ankerl::nanobench::Bench().title(name).minEpochIterations(20).run(
+        "recursive fork-join fib(24)", [&]() {
+          ankerl::nanobench::doNotOptimizeAway(fib(pool, 24));
+        });
+  }
+}
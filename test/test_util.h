@@ -0,0 +1,34 @@
+#pragma once
+
+#include "minilog/minilog.h"
+#include "thread/threadpool.h"
+
+namespace test_util {
+
+// 需要在每种调度模式下都验证一遍的测试
+inline constexpr threadpool::PoolMode kModes[] = {
+    threadpool::PoolMode::MODE_FIXED,    threadpool::PoolMode::MODE_CACHED,
+    threadpool::PoolMode::MODE_STEALING, threadpool::PoolMode::MODE_LOCKFREE,
+    threadpool::PoolMode::MODE_DEADLINE,
+};
+
+/**
+ * @brief 按指定的模式配置并启动线程池，只输出警告以上的日志
+ *
+ * @param taskThreshold 任务队列上限，0表示使用默认值
+ * @param threadThreshold CACHED 模式的线程数上限，0表示使用默认值
+ */
+inline void startPool(threadpool::ThreadPool& pool, threadpool::PoolMode mode, int threads,
+                      int taskThreshold = 0, int threadThreshold = 0) {
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(mode);
+  if (taskThreshold > 0) {
+    pool.setTaskThreshold(taskThreshold);
+  }
+  if (threadThreshold > 0) {
+    pool.setThreadThreshold(threadThreshold);
+  }
+  pool.start(threads);
+}
+
+}  // namespace test_util
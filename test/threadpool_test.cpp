@@ -9,6 +9,14 @@
 #include <boost/asio.hpp>
 #include <boost/asio/thread_pool.hpp>
 #include <boost/system/detail/error_code.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <stdexcept>
+#include <stop_token>
+#include <vector>
 
 #include "minilog/minilog.h"
 #include "queue/wait_strategy.h"
@@ -25,7 +33,7 @@
 //   int iter = 0;
 //   ankerl::nanobench::Bench().minEpochIterations(5000).run(
 //       "thread-pool mode cached performance test", [&]() {
-//         std::vector<std::future<int>> results;
+//         std::vector<threadpool::TaskFuture<int>> results;
 
 //         for (int i = 0; i < 10000; i++) {
 //           results.emplace_back(pool.submit([i]() { return
@@ -149,6 +157,61 @@ TEST_CASE("thread-pool test1") {
       });
 }
 
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool test1") {
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_STEALING);
+  pool.start();
+  ankerl::nanobench::Bench().minEpochIterations(100).run(
+      "[test1] thread-pool STEALING mode speed test", [&]() {
+        for (int i = 0; i < 10000; i++) {
+          pool.submit([i]() {
+            std::ostringstream ss;
+            ss << "hello world" << i;
+            return ss.str();
+          });
+        }
+      });
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool test1") {
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_LOCKFREE);
+  pool.start();
+  ankerl::nanobench::Bench().minEpochIterations(100).run(
+      "[test1] thread-pool LOCKFREE mode speed test", [&]() {
+        for (int i = 0; i < 10000; i++) {
+          pool.submit([i]() {
+            std::ostringstream ss;
+            ss << "hello world" << i;
+            return ss.str();
+          });
+        }
+      });
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool test1") {
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_LOCKFREE);
+  pool.setQueueWaitStrategy(new wait_strategy::YieldWaitStrategy());
+  pool.start();
+  ankerl::nanobench::Bench().minEpochIterations(100).run(
+      "[test1] thread-pool LOCKFREE mode YieldWaitStrategy speed test", [&]() {
+        for (int i = 0; i < 10000; i++) {
+          pool.submit([i]() {
+            std::ostringstream ss;
+            ss << "hello world" << i;
+            return ss.str();
+          });
+        }
+      });
+}
+
 /**
  * @brief test2
  *
@@ -163,7 +226,7 @@ TEST_CASE("thread-pool test2") {
   int iter = 0;
   ankerl::nanobench::Bench().minEpochIterations(50).run(
       "[test2] thread-pool FIXED mode performance test", [&]() {
-        std::vector<std::future<int>> results;
+        std::vector<threadpool::TaskFuture<int>> results;
 
         for (int i = 0; i < 10000; i++) {
           results.emplace_back(pool.submit([i]() { return 2 * i + 1; }));
@@ -189,7 +252,7 @@ TEST_CASE("thread-pool test2") {
       "[test2] thread-pool FIXED mode YieldWaitStrategy "
       "performance test",
       [&]() {
-        std::vector<std::future<int>> results;
+        std::vector<threadpool::TaskFuture<int>> results;
 
         for (int i = 0; i < 10000; i++) {
           results.emplace_back(pool.submit([i]() { return 2 * i + 1; }));
@@ -215,7 +278,7 @@ TEST_CASE("thread-pool test2") {
       "[test2] thread-pool FIXED mode BlockWaitStrategy "
       "performance test",
       [&]() {
-        std::vector<std::future<int>> results;
+        std::vector<threadpool::TaskFuture<int>> results;
 
         for (int i = 0; i < 10000; i++) {
           results.emplace_back(pool.submit([i]() { return 2 * i + 1; }));
@@ -238,7 +301,7 @@ TEST_CASE("thread-pool test2") {
   int iter = 0;
   ankerl::nanobench::Bench().minEpochIterations(50).run(
       "[test2] thread-pool CACHED mode performance test", [&]() {
-        std::vector<std::future<int>> results;
+        std::vector<threadpool::TaskFuture<int>> results;
 
         for (int i = 0; i < 10000; i++) {
           results.emplace_back(pool.submit([i]() { return 2 * i + 1; }));
@@ -264,7 +327,7 @@ TEST_CASE("thread-pool test2") {
       "[test2] thread-pool CACHED mode YieldWaitStrategy "
       "performance test",
       [&]() {
-        std::vector<std::future<int>> results;
+        std::vector<threadpool::TaskFuture<int>> results;
 
         for (int i = 0; i < 10000; i++) {
           results.emplace_back(pool.submit([i]() { return 2 * i + 1; }));
@@ -290,7 +353,7 @@ TEST_CASE("thread-pool test2") {
       "[test2] thread-pool CACHED mode BlockWaitStrategy "
       "performance test",
       [&]() {
-        std::vector<std::future<int>> results;
+        std::vector<threadpool::TaskFuture<int>> results;
 
         for (int i = 0; i < 10000; i++) {
           results.emplace_back(pool.submit([i]() { return 2 * i + 1; }));
@@ -304,6 +367,865 @@ TEST_CASE("thread-pool test2") {
       });
 }
 
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool test2") {
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_STEALING);
+  pool.start();
+  ankerl::nanobench::Bench().minEpochIterations(50).run(
+      "[test2] thread-pool STEALING mode performance test", [&]() {
+        std::vector<threadpool::TaskFuture<int>> results;
+
+        for (int i = 0; i < 10000; i++) {
+          results.emplace_back(pool.submit([i]() { return 2 * i + 1; }));
+        }
+
+        for (int i = 0; i < 10000; i++) {
+          int res = results[i].get();
+          CHECK(res == 2 * i + 1);
+        }
+      });
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool test2") {
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_STEALING);
+  pool.start();
+  ankerl::nanobench::Bench().minEpochIterations(50).run(
+      "[test2] thread-pool STEALING mode nested submit test", [&]() {
+        std::atomic<int> count = 0;
+        std::vector<threadpool::TaskFuture<void>> results;
+
+        // 工作线程内提交的任务进入本地队列，空闲线程窃取执行
+        for (int i = 0; i < 100; i++) {
+          results.emplace_back(pool.submit([&]() {
+            for (int j = 0; j < 100; j++) {
+              pool.submit([&]() { count++; });
+            }
+          }));
+        }
+
+        for (auto&& result : results) {
+          result.get();
+        }
+        while (count < 10000) {
+          std::this_thread::yield();
+        }
+        CHECK(count == 10000);
+      });
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool test2") {
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_LOCKFREE);
+  pool.start();
+  ankerl::nanobench::Bench().minEpochIterations(50).run(
+      "[test2] thread-pool LOCKFREE mode performance test", [&]() {
+        std::vector<threadpool::TaskFuture<int>> results;
+
+        for (int i = 0; i < 10000; i++) {
+          results.emplace_back(pool.submit([i]() { return 2 * i + 1; }));
+        }
+
+        for (int i = 0; i < 10000; i++) {
+          int res = results[i].get();
+          CHECK(res == 2 * i + 1);
+        }
+      });
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool test2") {
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_LOCKFREE);
+  pool.setQueueWaitStrategy(new wait_strategy::YieldWaitStrategy());
+  pool.start();
+  ankerl::nanobench::Bench().minEpochIterations(50).run(
+      "[test2] thread-pool LOCKFREE mode YieldWaitStrategy performance test", [&]() {
+        std::vector<threadpool::TaskFuture<int>> results;
+
+        for (int i = 0; i < 10000; i++) {
+          results.emplace_back(pool.submit([i]() { return 2 * i + 1; }));
+        }
+
+        for (int i = 0; i < 10000; i++) {
+          int res = results[i].get();
+          CHECK(res == 2 * i + 1);
+        }
+      });
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool test2") {
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_LOCKFREE);
+  pool.setQueueWaitStrategy(new wait_strategy::BlockWaitStrategy());
+  pool.start();
+  ankerl::nanobench::Bench().minEpochIterations(50).run(
+      "[test2] thread-pool LOCKFREE mode BlockWaitStrategy performance test", [&]() {
+        std::vector<threadpool::TaskFuture<int>> results;
+
+        for (int i = 0; i < 10000; i++) {
+          results.emplace_back(pool.submit([i]() { return 2 * i + 1; }));
+        }
+
+        for (int i = 0; i < 10000; i++) {
+          int res = results[i].get();
+          CHECK(res == 2 * i + 1);
+        }
+      });
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool test2") {
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_FIXED);
+  pool.setQueueWaitStrategy(new wait_strategy::HybridWaitStrategy());
+  pool.start();
+  ankerl::nanobench::Bench().minEpochIterations(50).run(
+      "[test2] thread-pool FIXED mode HybridWaitStrategy performance test", [&]() {
+        std::vector<threadpool::TaskFuture<int>> results;
+
+        for (int i = 0; i < 10000; i++) {
+          results.emplace_back(pool.submit([i]() { return 2 * i + 1; }));
+        }
+
+        for (int i = 0; i < 10000; i++) {
+          int res = results[i].get();
+          CHECK(res == 2 * i + 1);
+        }
+      });
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool test2") {
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_LOCKFREE);
+  pool.setQueueWaitStrategy(new wait_strategy::HybridWaitStrategy());
+  pool.start();
+  ankerl::nanobench::Bench().minEpochIterations(50).run(
+      "[test2] thread-pool LOCKFREE mode HybridWaitStrategy performance test", [&]() {
+        std::vector<threadpool::TaskFuture<int>> results;
+
+        for (int i = 0; i < 10000; i++) {
+          results.emplace_back(pool.submit([i]() { return 2 * i + 1; }));
+        }
+
+        for (int i = 0; i < 10000; i++) {
+          int res = results[i].get();
+          CHECK(res == 2 * i + 1);
+        }
+      });
+  // 空闲时工作线程挂起，再次提交的任务仍然能被唤醒执行
+  for (int round = 0; round < 5; round++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(pool.submit([round]() { return round; }).get() == round);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool test2") {
+  // 默认的 TimeoutBlockStrategy 不能丢失进入等待前的通知，否则空闲线程要等满1秒超时才取到任务
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_LOCKFREE);
+  pool.start(2);
+  for (int round = 0; round < 50; round++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    auto begin = std::chrono::steady_clock::now();
+    CHECK(pool.submit([round]() { return round; }).get() == round);
+    CHECK(std::chrono::steady_clock::now() - begin < std::chrono::milliseconds(200));
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool bulk") {
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_FIXED);
+  pool.start();
+  ankerl::nanobench::Bench().minEpochIterations(50).run(
+      "[bulk] thread-pool FIXED mode submit_n performance test", [&]() {
+        auto results = pool.submit_n(10000, [](std::size_t i) { return 2 * static_cast<int>(i) + 1; });
+        CHECK(results.size() == 10000);
+        for (int i = 0; i < 10000; i++) {
+          int res = results[i].get();
+          CHECK(res == 2 * i + 1);
+        }
+      });
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool bulk") {
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_CACHED);
+  pool.start();
+  ankerl::nanobench::Bench().minEpochIterations(50).run(
+      "[bulk] thread-pool CACHED mode submit_n performance test", [&]() {
+        auto results = pool.submit_n(10000, [](std::size_t i) { return 2 * static_cast<int>(i) + 1; });
+        CHECK(results.size() == 10000);
+        for (int i = 0; i < 10000; i++) {
+          int res = results[i].get();
+          CHECK(res == 2 * i + 1);
+        }
+      });
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool bulk") {
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_STEALING);
+  pool.start();
+  ankerl::nanobench::Bench().minEpochIterations(50).run(
+      "[bulk] thread-pool STEALING mode submit_n performance test", [&]() {
+        auto results = pool.submit_n(10000, [](std::size_t i) { return 2 * static_cast<int>(i) + 1; });
+        CHECK(results.size() == 10000);
+        for (int i = 0; i < 10000; i++) {
+          int res = results[i].get();
+          CHECK(res == 2 * i + 1);
+        }
+      });
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool bulk") {
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_LOCKFREE);
+  pool.start();
+  ankerl::nanobench::Bench().minEpochIterations(50).run(
+      "[bulk] thread-pool LOCKFREE mode submit_n performance test", [&]() {
+        auto results = pool.submit_n(10000, [](std::size_t i) { return 2 * static_cast<int>(i) + 1; });
+        CHECK(results.size() == 10000);
+        for (int i = 0; i < 10000; i++) {
+          int res = results[i].get();
+          CHECK(res == 2 * i + 1);
+        }
+      });
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool bulk") {
+  for (auto mode : {threadpool::PoolMode::MODE_FIXED, threadpool::PoolMode::MODE_CACHED,
+                    threadpool::PoolMode::MODE_STEALING, threadpool::PoolMode::MODE_LOCKFREE}) {
+    threadpool::ThreadPool pool;
+    minilog::set_log_level(minilog::log_level::warn);
+    pool.setMode(mode);
+    pool.start(2);
+
+    // 左值区间拷贝，右值区间移走
+    std::vector<std::function<int()>> funcs;
+    for (int i = 0; i < 100; i++) {
+      funcs.emplace_back([i]() { return i * i; });
+    }
+    auto copied = pool.submit_bulk(funcs);
+    CHECK(funcs[0] != nullptr);
+    auto moved = pool.submit_bulk(std::move(funcs));
+    for (int i = 0; i < 100; i++) {
+      CHECK(copied[i].get() == i * i);
+      CHECK(moved[i].get() == i * i);
+    }
+
+    // 工作线程内部批量提交，异常通过 future 传递
+    auto nested = pool.submit([&pool]() {
+      auto inner = pool.submit_n(100, [](std::size_t i) {
+        if (i == 42) throw std::runtime_error("bulk error");
+      });
+      int errors = 0;
+      for (auto& future : inner) {
+        try {
+          future.get();
+        } catch (const std::runtime_error&) {
+          errors++;
+        }
+      }
+      return errors;
+    });
+    CHECK(nested.get() == 1);
+    CHECK(pool.submit_n(0, [](std::size_t) {}).empty());
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool unbounded") {
+  // 唯一的工作线程被占住时提交大量任务，无界队列不会让提交方阻塞
+  for (auto mode : {threadpool::PoolMode::MODE_FIXED, threadpool::PoolMode::MODE_CACHED,
+                    threadpool::PoolMode::MODE_STEALING, threadpool::PoolMode::MODE_LOCKFREE}) {
+    threadpool::ThreadPool pool(threadpool::QueueMode::QUEUE_UNBOUNDED);
+    minilog::set_log_level(minilog::log_level::warn);
+    pool.setMode(mode);
+    pool.setThreadThreshold(1);
+    pool.start(1);
+    std::atomic<bool> release = false;
+    auto blocker = pool.submit([&release]() {
+      while (!release) {
+        std::this_thread::yield();
+      }
+    });
+    std::vector<threadpool::TaskFuture<int>> results;
+    for (int i = 0; i < 10000; i++) {
+      results.emplace_back(pool.submit([i]() { return 2 * i + 1; }));
+    }
+    release = true;
+    blocker.get();
+    for (int i = 0; i < 10000; i++) {
+      CHECK(results[i].get() == 2 * i + 1);
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool unbounded") {
+  threadpool::ThreadPool pool(threadpool::QueueMode::QUEUE_UNBOUNDED);
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_FIXED);
+  pool.start();
+  ankerl::nanobench::Bench().minEpochIterations(50).run(
+      "[unbounded] thread-pool FIXED mode performance test", [&]() {
+        std::vector<threadpool::TaskFuture<int>> results;
+
+        for (int i = 0; i < 10000; i++) {
+          results.emplace_back(pool.submit([i]() { return 2 * i + 1; }));
+        }
+
+        for (int i = 0; i < 10000; i++) {
+          int res = results[i].get();
+          CHECK(res == 2 * i + 1);
+        }
+      });
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool unbounded") {
+  threadpool::ThreadPool pool(threadpool::QueueMode::QUEUE_UNBOUNDED);
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_LOCKFREE);
+  pool.start();
+  ankerl::nanobench::Bench().minEpochIterations(50).run(
+      "[unbounded] thread-pool LOCKFREE mode performance test", [&]() {
+        std::vector<threadpool::TaskFuture<int>> results;
+
+        for (int i = 0; i < 10000; i++) {
+          results.emplace_back(pool.submit([i]() { return 2 * i + 1; }));
+        }
+
+        for (int i = 0; i < 10000; i++) {
+          int res = results[i].get();
+          CHECK(res == 2 * i + 1);
+        }
+      });
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool priority") {
+  // 唯一的工作线程被占住时提交各个优先级的任务，严格优先级下按优先级顺序执行
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_FIXED);
+  pool.setPriorityPolicy(threadpool::PriorityPolicy::POLICY_STRICT);
+  pool.setPriorityAging(0);
+  pool.start(1);
+  std::atomic<bool> release = false;
+  auto blocker = pool.submit([&release]() {
+    while (!release) {
+      std::this_thread::yield();
+    }
+  });
+  std::vector<int> order;
+  std::vector<threadpool::TaskFuture<void>> results;
+  for (auto priority : {threadpool::Priority::PRIORITY_LOW, threadpool::Priority::PRIORITY_NORMAL,
+                        threadpool::Priority::PRIORITY_HIGH}) {
+    for (int i = 0; i < 10; i++) {
+      results.emplace_back(pool.submit(
+          priority, [&order](int p) { order.push_back(p); }, static_cast<int>(priority)));
+    }
+  }
+  release = true;
+  blocker.get();
+  for (auto &result : results) {
+    result.get();
+  }
+  REQUIRE(order.size() == 30);
+  for (int i = 0; i < 30; i++) {
+    CHECK(order[i] == i / 10);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool priority") {
+  // 老化：高优先级任务源源不断时，低优先级任务也能被执行
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_FIXED);
+  pool.setPriorityAging(2);
+  pool.start(1);
+  std::atomic<bool> release = false;
+  auto blocker = pool.submit([&release]() {
+    while (!release) {
+      std::this_thread::yield();
+    }
+  });
+  int executed = 0;
+  int low_position = -1;
+  std::vector<threadpool::TaskFuture<void>> results;
+  results.emplace_back(pool.submit(threadpool::Priority::PRIORITY_LOW,
+                                   [&]() { low_position = executed++; }));
+  for (int i = 0; i < 40; i++) {
+    results.emplace_back(pool.submit(threadpool::Priority::PRIORITY_HIGH, [&]() { executed++; }));
+  }
+  release = true;
+  blocker.get();
+  for (auto &result : results) {
+    result.get();
+  }
+  CHECK(executed == 41);
+  CHECK(low_position >= 0);
+  CHECK(low_position < 40);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool priority") {
+  // 加权轮转：高优先级取得更多的批次，但低优先级不必等到高优先级全部执行完
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_FIXED);
+  pool.setPriorityPolicy(threadpool::PriorityPolicy::POLICY_WEIGHTED);
+  pool.setPriorityWeight(threadpool::Priority::PRIORITY_HIGH, 2);
+  pool.setPriorityWeight(threadpool::Priority::PRIORITY_NORMAL, 1);
+  pool.setPriorityWeight(threadpool::Priority::PRIORITY_LOW, 1);
+  pool.setPriorityAging(0);
+  pool.start(1);
+  std::atomic<bool> release = false;
+  auto blocker = pool.submit([&release]() {
+    while (!release) {
+      std::this_thread::yield();
+    }
+  });
+  std::vector<int> order;
+  std::vector<threadpool::TaskFuture<void>> results;
+  // 占住工作线程的任务也会消耗一次额度，高优先级的任务要多于一轮的量
+  for (auto priority : {threadpool::Priority::PRIORITY_LOW, threadpool::Priority::PRIORITY_NORMAL,
+                        threadpool::Priority::PRIORITY_HIGH}) {
+    int count = priority == threadpool::Priority::PRIORITY_HIGH ? 40 : 24;
+    for (int i = 0; i < count; i++) {
+      results.emplace_back(pool.submit(
+          priority, [&order](int p) { order.push_back(p); }, static_cast<int>(priority)));
+    }
+  }
+  release = true;
+  blocker.get();
+  for (auto &result : results) {
+    result.get();
+  }
+  REQUIRE(order.size() == 88);
+  auto first = [&](int p) { return std::find(order.begin(), order.end(), p) - order.begin(); };
+  auto last = [&](int p) { return order.rend() - std::find(order.rbegin(), order.rend(), p) - 1; };
+  CHECK(order[0] == 0);
+  CHECK(first(2) < last(0));
+  CHECK(first(1) < last(0));
+  // 前半段中高优先级的任务最多
+  CHECK(std::count(order.begin(), order.begin() + 44, 0) >
+        std::count(order.begin(), order.begin() + 44, 2));
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool priority") {
+  // 其他模式忽略优先级
+  for (auto mode : {threadpool::PoolMode::MODE_CACHED, threadpool::PoolMode::MODE_STEALING,
+                    threadpool::PoolMode::MODE_LOCKFREE}) {
+    threadpool::ThreadPool pool;
+    minilog::set_log_level(minilog::log_level::warn);
+    pool.setMode(mode);
+    pool.start(2);
+    std::vector<threadpool::TaskFuture<int>> results;
+    for (int i = 0; i < 300; i++) {
+      results.emplace_back(
+          pool.submit(static_cast<threadpool::Priority>(i % 3), [i]() { return 2 * i + 1; }));
+    }
+    for (int i = 0; i < 300; i++) {
+      CHECK(results[i].get() == 2 * i + 1);
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool priority") {
+  // 后台任务持续占满队列时，前台任务的延迟：不区分优先级(之前) vs 高优先级(之后)
+  auto busy = []() {
+    auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(20);
+    while (std::chrono::steady_clock::now() < end) {
+    }
+  };
+  for (auto priority : {threadpool::Priority::PRIORITY_NORMAL, threadpool::Priority::PRIORITY_HIGH}) {
+    threadpool::ThreadPool pool;
+    minilog::set_log_level(minilog::log_level::warn);
+    pool.setMode(threadpool::PoolMode::MODE_FIXED);
+    pool.start(1);
+    std::atomic<bool> stop = false;
+    std::thread background([&]() {
+      auto background_priority = priority == threadpool::Priority::PRIORITY_HIGH
+                                     ? threadpool::Priority::PRIORITY_LOW
+                                     : threadpool::Priority::PRIORITY_NORMAL;
+      while (!stop) {
+        pool.submit(background_priority, busy);
+      }
+    });
+    ankerl::nanobench::Bench().minEpochIterations(200).run(
+        priority == threadpool::Priority::PRIORITY_HIGH
+            ? "[priority] FIXED mode HIGH task latency under LOW load"
+            : "[priority] FIXED mode NORMAL task latency under NORMAL load",
+        [&]() { CHECK(pool.submit(priority, []() { return 1; }).get() == 1); });
+    stop = true;
+    background.join();
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool deadline") {
+  // 唯一的工作线程被占住时倒序提交，按截止时间从早到晚执行
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_DEADLINE);
+  pool.start(1);
+  std::atomic<bool> started = false;
+  std::atomic<bool> release = false;
+  auto blocker = pool.submit([&started, &release]() {
+    started = true;
+    while (!release) {
+      std::this_thread::yield();
+    }
+  });
+  while (!started) {
+    std::this_thread::yield();
+  }
+  auto now = threadpool::ThreadPool::Clock::now();
+  std::vector<int> order;
+  std::vector<threadpool::TaskFuture<int>> results;
+  // 没有截止时间的任务最后执行
+  auto last = pool.submit([&order]() { order.push_back(-1); });
+  for (int i = 0; i < 20; i++) {
+    results.emplace_back(pool.submit_with_deadline(now + std::chrono::seconds(100 - i),
+                                                   [&order, i]() {
+                                                     order.push_back(i);
+                                                     return i;
+                                                   }));
+  }
+  release = true;
+  blocker.get();
+  for (int i = 0; i < 20; i++) {
+    CHECK(results[i].get() == i);
+  }
+  last.get();
+  REQUIRE(order.size() == 21);
+  for (int i = 0; i < 20; i++) {
+    CHECK(order[i] == 19 - i);
+  }
+  CHECK(order[20] == -1);
+  CHECK(pool.expiredTaskCount() == 0);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool deadline") {
+  // 轮到执行时已经过期的任务不会运行，future 得到 TaskExpiredError
+  for (auto mode : {threadpool::PoolMode::MODE_DEADLINE, threadpool::PoolMode::MODE_FIXED,
+                    threadpool::PoolMode::MODE_CACHED, threadpool::PoolMode::MODE_STEALING,
+                    threadpool::PoolMode::MODE_LOCKFREE}) {
+    threadpool::ThreadPool pool;
+    minilog::set_log_level(minilog::log_level::warn);
+    pool.setMode(mode);
+    pool.setThreadThreshold(1);
+    pool.start(1);
+    // 没有截止时间的任务排在最后，等它开始执行之后再提交
+    std::atomic<bool> started = false;
+    std::atomic<bool> release = false;
+    auto blocker = pool.submit([&started, &release]() {
+      started = true;
+      while (!release) {
+        std::this_thread::yield();
+      }
+    });
+    while (!started) {
+      std::this_thread::yield();
+    }
+    auto now = threadpool::ThreadPool::Clock::now();
+    std::atomic<int> executed = 0;
+    std::vector<threadpool::TaskFuture<int>> stale;
+    std::vector<threadpool::TaskFuture<int>> fresh;
+    for (int i = 0; i < 10; i++) {
+      stale.emplace_back(pool.submit_with_deadline(now + std::chrono::milliseconds(5), [&]() {
+        executed++;
+        return 0;
+      }));
+      fresh.emplace_back(pool.submit_with_deadline(
+          now + std::chrono::seconds(100), [&executed](int v) { return executed++, v; }, i));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    release = true;
+    blocker.get();
+    for (int i = 0; i < 10; i++) {
+      CHECK_THROWS_AS(stale[i].get(), threadpool::TaskExpiredError);
+      CHECK(fresh[i].get() == i);
+    }
+    CHECK(executed == 10);
+    CHECK(pool.expiredTaskCount() == 10);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool deadline") {
+  // 过载时丢弃过期任务：每个任务50us，截止时间2ms，消化1000个任务的耗时
+  auto work = []() {
+    auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(50);
+    while (std::chrono::steady_clock::now() < end) {
+    }
+    return 1;
+  };
+  for (auto mode : {threadpool::PoolMode::MODE_FIXED, threadpool::PoolMode::MODE_DEADLINE}) {
+    threadpool::ThreadPool pool;
+    minilog::set_log_level(minilog::log_level::warn);
+    pool.setMode(mode);
+    pool.start(1);
+    ankerl::nanobench::Bench().minEpochIterations(5).run(
+        mode == threadpool::PoolMode::MODE_DEADLINE
+            ? "[deadline] thread-pool DEADLINE mode overload test"
+            : "[deadline] thread-pool FIXED mode overload test",
+        [&]() {
+          std::vector<threadpool::TaskFuture<int>> results;
+          for (int i = 0; i < 1000; i++) {
+            if (mode == threadpool::PoolMode::MODE_DEADLINE) {
+              auto deadline = threadpool::ThreadPool::Clock::now() + std::chrono::milliseconds(2);
+              results.emplace_back(pool.submit_with_deadline(deadline, work));
+            } else {
+              results.emplace_back(pool.submit(work));
+            }
+          }
+          int done = 0;
+          for (auto &result : results) {
+            try {
+              done += result.get();
+            } catch (const threadpool::TaskExpiredError &) {
+            }
+          }
+          CHECK(done > 0);
+        });
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool timer") {
+  // 各个模式下定时任务到期后交给线程池执行，不会提前
+  for (auto mode : {threadpool::PoolMode::MODE_FIXED, threadpool::PoolMode::MODE_CACHED,
+                    threadpool::PoolMode::MODE_STEALING, threadpool::PoolMode::MODE_LOCKFREE,
+                    threadpool::PoolMode::MODE_DEADLINE}) {
+    threadpool::ThreadPool pool;
+    minilog::set_log_level(minilog::log_level::warn);
+    pool.setMode(mode);
+    pool.start(2);
+    auto begin = threadpool::ThreadPool::Clock::now();
+    std::vector<threadpool::ThreadPool::Scheduled<int>> results;
+    for (int i = 0; i < 10; i++) {
+      results.emplace_back(pool.schedule_after(
+          std::chrono::milliseconds(5 * (10 - i)),
+          [begin](int v) {
+            return threadpool::ThreadPool::Clock::now() - begin >=
+                           std::chrono::milliseconds(5 * (10 - v))
+                       ? v
+                       : -1;
+          },
+          i));
+    }
+    auto at = pool.schedule_at(begin + std::chrono::milliseconds(10), []() { return 42; });
+    for (int i = 0; i < 10; i++) {
+      CHECK(results[i].future.get() == i);
+    }
+    CHECK(at.future.get() == 42);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool timer") {
+  // 到期前取消的任务不会执行，future 得到 broken_promise
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_FIXED);
+  pool.start(1);
+  std::atomic<int> executed = 0;
+  auto cancelled = pool.schedule_after(std::chrono::milliseconds(20), [&executed]() { executed++; });
+  auto kept = pool.schedule_after(std::chrono::milliseconds(20), [&executed]() { executed++; });
+  CHECK(pool.cancel_timer(cancelled.id));
+  CHECK_FALSE(pool.cancel_timer(cancelled.id));
+  kept.future.get();
+  CHECK(executed == 1);
+  try {
+    cancelled.future.get();
+    CHECK(false);
+  } catch (const std::future_error &e) {
+    CHECK(e.code() == std::future_errc::broken_promise);
+  }
+  CHECK_FALSE(pool.cancel_timer(kept.id));
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool timer") {
+  // 周期任务重复执行，抛出异常不影响下一次，取消后停止
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::error);
+  pool.setMode(threadpool::PoolMode::MODE_FIXED);
+  pool.start(2);
+  std::atomic<int> count = 0;
+  auto id = pool.schedule_every(std::chrono::milliseconds(2), [&count]() {
+    if (++count % 2 == 0) {
+      throw std::runtime_error("periodic task error");
+    }
+  });
+  while (count < 6) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  CHECK(pool.cancel_timer(id));
+  // 取消时可能还有一次已经提交
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  int snapshot = count;
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  CHECK(count == snapshot);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool timer") {
+  // 等待期间不占用工作线程：唯一的工作线程在定时任务等待时仍然可以执行普通任务
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_FIXED);
+  pool.start(1);
+  std::vector<threadpool::ThreadPool::Scheduled<void>> timers;
+  for (int i = 0; i < 1000; i++) {
+    timers.emplace_back(pool.schedule_after(std::chrono::milliseconds(50), []() {}));
+  }
+  auto begin = std::chrono::steady_clock::now();
+  pool.submit([]() {}).get();
+  CHECK(std::chrono::steady_clock::now() - begin < std::chrono::milliseconds(50));
+  for (auto &timer : timers) {
+    timer.future.get();
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool cancel") {
+  // 排队期间被取消的任务不会执行，future 得到 TaskCancelledError
+  for (auto mode : {threadpool::PoolMode::MODE_FIXED, threadpool::PoolMode::MODE_CACHED,
+                    threadpool::PoolMode::MODE_STEALING, threadpool::PoolMode::MODE_LOCKFREE,
+                    threadpool::PoolMode::MODE_DEADLINE}) {
+    threadpool::ThreadPool pool;
+    minilog::set_log_level(minilog::log_level::warn);
+    pool.setMode(mode);
+    pool.setThreadThreshold(1);
+    pool.start(1);
+    std::atomic<bool> started = false;
+    std::atomic<bool> release = false;
+    auto blocker = pool.submit([&started, &release]() {
+      started = true;
+      while (!release) {
+        std::this_thread::yield();
+      }
+    });
+    while (!started) {
+      std::this_thread::yield();
+    }
+    std::stop_source source;
+    std::atomic<int> executed = 0;
+    std::vector<threadpool::TaskFuture<int>> cancelled;
+    std::vector<threadpool::TaskFuture<int>> kept;
+    for (int i = 0; i < 10; i++) {
+      cancelled.emplace_back(pool.submit(source.get_token(), [&executed]() { return ++executed; }));
+      // 默认构造的令牌不会被取消
+      kept.emplace_back(pool.submit(std::stop_token(), [&executed](int v) { return executed++, v; },
+                                    i));
+    }
+    CHECK(source.request_stop());
+    release = true;
+    blocker.get();
+    for (int i = 0; i < 10; i++) {
+      CHECK_THROWS_AS(cancelled[i].get(), threadpool::TaskCancelledError);
+      CHECK(kept[i].get() == i);
+    }
+    CHECK(executed == 10);
+    CHECK(pool.cancelledTaskCount() == 10);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool cancel") {
+  // 第一个参数是 std::stop_token 的任务可以在执行中轮询，提前结束
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_FIXED);
+  pool.start(1);
+  std::stop_source source;
+  std::atomic<bool> started = false;
+  auto result = pool.submit(
+      threadpool::Priority::PRIORITY_HIGH, source.get_token(),
+      [&started](std::stop_token token, int step) {
+        started = true;
+        int count = 0;
+        while (!token.stop_requested()) {
+          count += step;
+          std::this_thread::yield();
+        }
+        return count;
+      },
+      1);
+  while (!started) {
+    std::this_thread::yield();
+  }
+  source.request_stop();
+  CHECK(result.get() > 0);
+  // 已经开始执行的任务不算作取消
+  CHECK(pool.cancelledTaskCount() == 0);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool cancel") {
+  // 客户端断开时丢弃积压的任务：1000个50us的任务在提交后立即取消，丢弃的开销远小于执行
+  auto work = []() {
+    auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(50);
+    while (std::chrono::steady_clock::now() < end) {
+    }
+    return 1;
+  };
+  // 无界队列，提交时不会因为队列满而等待任务执行
+  threadpool::ThreadPool pool(threadpool::QueueMode::QUEUE_UNBOUNDED);
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_FIXED);
+  pool.start(1);
+  ankerl::nanobench::Bench().minEpochIterations(50).run(
+      "[cancel] thread-pool FIXED mode shed 1000 tasks", [&]() {
+        std::stop_source source;
+        std::vector<threadpool::TaskFuture<int>> results;
+        for (int i = 0; i < 1000; i++) {
+          results.emplace_back(pool.submit(source.get_token(), work));
+        }
+        source.request_stop();
+        int done = 0;
+        for (auto &result : results) {
+          try {
+            done += result.get();
+          } catch (const threadpool::TaskCancelledError &) {
+          }
+        }
+        CHECK(done < 1000);
+      });
+}
+
 /**
  * @brief test3s
  *
@@ -364,6 +1286,16 @@ TEST_CASE("thread-pool test3") {
       [&]() { pool.submit(test, func_swap); });
 }
 
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool test3") {
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_STEALING);
+  pool.start();
+  ankerl::nanobench::Bench().minEpochIterations(1000).run(
+      "[test3] thread-pool STEALING mode performance test", [&]() { pool.submit(test, func_swap); });
+}
+
 // NOLINTNEXTLINE
 TEST_CASE("thread-pool test3") {
   threadpool::ThreadPool pool;
@@ -402,3 +1334,13 @@ TEST_CASE("thread-pool test3") {
       "performance test",
       [&]() { pool.submit(test, func_swap); });
 }
+
+// NOLINTNEXTLINE
+TEST_CASE("thread-pool test3") {
+  threadpool::ThreadPool pool;
+  minilog::set_log_level(minilog::log_level::warn);
+  pool.setMode(threadpool::PoolMode::MODE_LOCKFREE);
+  pool.start();
+  ankerl::nanobench::Bench().minEpochIterations(1000).run(
+      "[test3] thread-pool LOCKFREE mode performance test", [&]() { pool.submit(test, func_swap); });
+}
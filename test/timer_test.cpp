@@ -0,0 +1,157 @@
+#define ANKERL_NANOBENCH_IMPLEMENT
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <doctest.h>
+#include <nanobench.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "timer/timer_wheel.h"
+
+using threadpool::TimerWheel;
+using Clock = TimerWheel::Clock;
+
+namespace {
+// 等待条件成立，超时返回false
+template <class Pred>
+bool waitFor(Pred pred, std::chrono::milliseconds timeout = std::chrono::seconds(5)) {
+  auto deadline = Clock::now() + timeout;
+  while (!pred()) {
+    if (Clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+  return true;
+}
+}  // namespace
+
+// NOLINTNEXTLINE
+TEST_CASE("timer wheel test") {
+  // 到期时间跨越多层，降级之后仍然按时间顺序触发，且不会提前
+  TimerWheel wheel(std::chrono::microseconds(10));
+  wheel.start();
+  std::mutex mtx;
+  std::vector<int> order;
+  std::atomic<int> early = 0;
+  auto now = Clock::now();
+  // 10us的tick下，1ms、5ms、20ms 分别落在第0、1、2层
+  std::vector<int> delays = {20000, 1000, 5000, 300, 2600, 12000};
+  for (int delay : delays) {
+    auto when = now + std::chrono::microseconds(delay);
+    wheel.add(when, Clock::duration::zero(), [&, delay, when]() {
+      if (Clock::now() < when) {
+        early++;
+      }
+      std::lock_guard<std::mutex> lock(mtx);
+      order.push_back(delay);
+    });
+  }
+  CHECK(wheel.size() == delays.size());
+  REQUIRE(waitFor([&]() { return wheel.size() == 0; }));
+  std::sort(delays.begin(), delays.end());
+  CHECK(order == delays);
+  CHECK(early == 0);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("timer wheel test") {
+  // 取消之后不会触发，id 在节点复用之后失效
+  TimerWheel wheel;
+  wheel.start();
+  std::atomic<int> fired = 0;
+  auto id = wheel.add(Clock::now() + std::chrono::milliseconds(20), Clock::duration::zero(),
+                      [&fired]() { fired++; });
+  CHECK(id != TimerWheel::kInvalidTimer);
+  CHECK(wheel.cancel(id));
+  CHECK_FALSE(wheel.cancel(id));
+  CHECK_FALSE(wheel.cancel(TimerWheel::kInvalidTimer));
+  // 复用同一个节点，旧的id不能取消新的定时器
+  auto reused = wheel.add(Clock::now() + std::chrono::milliseconds(5), Clock::duration::zero(),
+                          [&fired]() { fired++; });
+  CHECK(reused != id);
+  CHECK_FALSE(wheel.cancel(id));
+  REQUIRE(waitFor([&]() { return fired == 1; }));
+  std::this_thread::sleep_for(std::chrono::milliseconds(30));
+  CHECK(fired == 1);
+  CHECK_FALSE(wheel.cancel(reused));
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("timer wheel test") {
+  // 周期定时器重复触发，取消后停止
+  TimerWheel wheel;
+  wheel.start();
+  std::atomic<int> fired = 0;
+  auto id = wheel.add(Clock::now() + std::chrono::milliseconds(2), std::chrono::milliseconds(2),
+                      [&fired]() { fired++; });
+  REQUIRE(waitFor([&]() { return fired >= 5; }));
+  CHECK(wheel.size() == 1);
+  CHECK(wheel.cancel(id));
+  CHECK(wheel.size() == 0);
+  int snapshot = fired;
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  // 取消时可能正好有一次在执行
+  CHECK(fired <= snapshot + 1);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("timer wheel test") {
+  // 大量定时器：取消一半，剩下的全部触发一次；停止时没到期的回调被释放
+  // 全部插入和取消之后才启动线程，取消时一定还没有到期
+  TimerWheel wheel;
+  constexpr int kTimers = 200000;
+  std::atomic<int> fired = 0;
+  std::vector<TimerWheel::TimerId> ids;
+  ids.reserve(kTimers);
+  auto now = Clock::now();
+  for (int i = 0; i < kTimers; i++) {
+    ids.push_back(wheel.add(now + std::chrono::milliseconds(i % 200),
+                            Clock::duration::zero(), [&fired]() { fired++; }));
+  }
+  int cancelled = 0;
+  for (int i = 0; i < kTimers; i += 2) {
+    cancelled += wheel.cancel(ids[i]) ? 1 : 0;
+  }
+  CHECK(cancelled == kTimers / 2);
+  wheel.start();
+  REQUIRE(waitFor([&]() { return wheel.size() == 0; }));
+  CHECK(fired == kTimers / 2);
+
+  auto holder = std::make_shared<int>(0);
+  for (int i = 0; i < 100; i++) {
+    wheel.add(Clock::now() + std::chrono::hours(1), Clock::duration::zero(),
+              [holder]() { (*holder)++; });
+  }
+  CHECK(holder.use_count() == 101);
+  wheel.stop();
+  CHECK(holder.use_count() == 1);
+}
+
+// NOLINTNEXTLINE
+TEST_CASE("timer wheel test") {
+  // 插入和取消的开销和已有的定时器数量无关
+  TimerWheel wheel;
+  wheel.start();
+  auto now = Clock::now();
+  std::vector<TimerWheel::TimerId> background;
+  for (int i = 0; i < 100000; i++) {
+    background.push_back(wheel.add(now + std::chrono::seconds(10 + i % 1000),
+                                   Clock::duration::zero(), []() {}));
+  }
+  std::uint64_t i = 0;
+  ankerl::nanobench::Bench().minEpochIterations(100000).run(
+      "timer wheel add + cancel with 100k pending timers", [&]() {
+        auto id = wheel.add(now + std::chrono::milliseconds(100 + (i++ % 100000)),
+                            Clock::duration::zero(), []() {});
+        wheel.cancel(id);
+      });
+  CHECK(wheel.size() == background.size());
+}